@@ -18,6 +18,44 @@
 #include <chrono>       // For time operations
 #include <thread>       // For thread operations
 #include <sstream>      // For string stream operations
+#include <map>          // For keyed quota counters
+#include <ctime>        // For calendar boundaries
+#include <cstdio>       // For atomic file replacement
+#include <algorithm>    // For sorting and searching
+#include <cstdint>      // For fixed-width integers
+#include <cstring>      // For raw memory operations
+#include <sys/mman.h>   // For memory-mapped stores
+#include <sys/stat.h>   // For file sizes
+#include <fcntl.h>      // For opening store files
+#include <unistd.h>     // For POSIX file operations
+#include <cerrno>       // For system error codes
+#include <memory>       // For optional components
+#include <atomic>       // For lock-free shared state
+#include <mutex>        // For background queues
+#include <condition_variable>  // For waking background threads
+#include <functional>   // For request handlers
+#include <deque>        // For background queues
+#include <unordered_set>    // For the concurrent set benchmark baseline
+#include <sys/socket.h> // For the webhook receiver
+#include <netinet/in.h> // For socket addresses
+#include <arpa/inet.h>  // For address parsing
+#include <poll.h>       // For multiplexing connections
+#include <cmath>        // For latency models and percentiles
+#include <random>       // For simulation models
+#include <sys/resource.h>  // For benchmark resource usage
+#include <sys/wait.h>   // For the soak test's mock server process
+#include <csignal>      // For stopping child processes
+#include <linux/perf_event.h>   // For hardware performance counters
+#include <sys/syscall.h>        // For perf_event_open
+#include <sys/ioctl.h>          // For enabling counter groups
+#include <zstd.h>               // For result archive compression
+#include <climits>              // For query filter sentinels
+#include <sched.h>              // For CPU sets
+#include <pthread.h>            // For pinning threads to CPUs
+#ifdef __SSE2__
+#include <emmintrin.h>          // For vectorized archive scans and token encoding
+#endif
+#include "sms_sender.h"         // For the library interface
 
 // Using the JSON library with an alias
 using json = nlohmann::json;
@@ -37,6 +75,34 @@ namespace Color {
     const std::string BOLD    = "\033[1m";     // Bold text
 }
 
+/*
+ * Structure to hold a long-horizon send quota
+ * A limit of 0 means the scope is not capped for that period
+ */
+struct QuotaLimits {
+    long daily = 0;             // Maximum messages per calendar day
+    long monthly = 0;           // Maximum messages per calendar month
+};
+
+/*
+ * Structure to hold a sender number and its carrier-imposed caps
+ */
+struct SenderConfig {
+    std::string number;         // Sender phone number
+    QuotaLimits quota;          // Daily/monthly caps (e.g. 10DLC or toll-free tier)
+    double mps = 1.0;           // Message segments per second the sender may submit
+    std::vector<std::string> countries;  // Eligible country code prefixes (empty = any)
+};
+
+/*
+ * Structure to hold a daily local-time window in which sending is allowed
+ * A window whose end is before its start wraps past midnight
+ */
+struct SendWindow {
+    int start_minute = 0;       // Minutes after midnight the window opens
+    int end_minute = 24 * 60;   // Minutes after midnight the window closes
+};
+
 /*
  * Structure to hold Twilio configuration data
  * Contains the essential credentials needed for Twilio API authentication
@@ -45,8 +111,649 @@ struct TwilioConfig {
     std::string account_sid;    // Twilio account SID
     std::string auth_token;     // Twilio authentication token
     std::string phone_number;   // Sender phone number
+    std::vector<SenderConfig> senders;      // Sender pool (defaults to phone_number)
+    QuotaLimits account_quota;              // Caps shared by every sender
+    std::string campaign_id = "default";    // Campaign the quota counters belong to
+    QuotaLimits campaign_quota;             // Caps for this campaign only
+    std::string quota_file = "quota_state.txt";  // Persistent quota counters
+    int quota_headroom = 5;     // Percent of a cap at which dispatch spills to other senders
+    SendWindow send_window;     // Local hours in which messages may be sent
+    std::string api_base_url = "https://api.twilio.com";  // Default API host
+    std::vector<std::string> api_edges;     // Regional edges to probe (empty = default host only)
+    std::string api_region = "us1";         // Region used when an edge is given without one
+    int edge_reprobe_seconds = 600;         // Interval between latency probes (0 = never)
+    int frequency_cap = 0;      // Max messages per recipient within the window (0 = off)
+    int frequency_window_days = 7;          // Length of the frequency capping window
+    std::string frequency_file = "frequency.db";  // Persistent per-recipient send history
+    bool lookup_enabled = false;            // Query line type before dispatch
+    std::string lookup_url = "https://lookups.twilio.com/v2/PhoneNumbers";  // Lookup endpoint
+    std::string lookup_cache_file = "lookup.db";  // Persistent lookup results
+    int lookup_ttl_days = 30;               // Days a cached lookup stays valid
+    int lookup_concurrency = 32;            // Lookup requests kept in flight
+    std::string suppression_file = "suppression.txt";  // Opted-out numbers, one per line
+    int inbound_port = 0;       // Port of the inbound-message webhook (0 = disabled)
+    std::string inbound_bind = "127.0.0.1";  // Address the webhook listens on
+    std::string inbound_url;    // Public URL Twilio calls, used to verify X-Twilio-Signature
+    std::string sent_journal = "sent_journal.log";  // Append-only log of successful sends
+    bool ramp_enabled = true;   // Slow-start the send rate and stop on error spikes
+    int ramp_start_percent = 25;            // Initial rate as a percentage of each sender's mps
+    int ramp_window = 10;       // Sends per rolling health window
+    double ramp_pause_ratio = 0.3;          // Systemic failure ratio that pauses sending
+    double ramp_abort_ratio = 0.6;          // Systemic failure ratio that aborts the campaign
+    int ramp_pause_seconds = 30;            // Cool-down after a pause
+    int ramp_max_pauses = 3;    // Consecutive pauses before aborting
+    int retry_attempts = 4;     // Attempts per message for retryable failures
+    int retry_backoff_ms = 500; // First retry delay, doubled on every attempt
+    int http_timeout_seconds = 30;          // Limit for one API request
+    std::string log_format = "auto";        // text, json, logfmt, or auto (text on a terminal, json otherwise)
+    std::string log_level = "info";         // debug, info, warn or error
+    std::string log_file;       // Structured log destination (standard output if empty)
+    bool log_valid_numbers = true;          // Echo every valid number while loading the list
+    std::string rejects_file;   // Optional file listing every rejected line with its reason
+    int engine_workers = 8;     // Sending threads of an embedded engine (library use)
+    int keepalive_seconds = 20; // Idle time after which an engine connection is refreshed (0 = never)
+    std::string queue_file;     // Durable engine job queue (empty = in memory only)
+    std::string archive_file;   // Columnar archive of every result (empty = off)
+    std::string token_key;      // 128-bit hex key for {{token}} tracking tokens
+    std::string token_index = "tokens.idx";     // Sidecar mapping tokens back to recipients
+    std::string status_file;    // Live progress for `sms_sender status` (empty = off)
+    std::string thread_placement = "none";  // none, nodes (pin to NUMA node) or cores (pin to one CPU)
+};
+
+/*
+ * Logger class
+ * Leveled, structured logging for per-message output. On a terminal, events
+ * are printed as the familiar colored lines. Otherwise they are written as
+ * JSON or logfmt records by a background thread: each logging thread appends
+ * to its own lock-free single-producer ring, and the flusher drains every ring
+ * into one write() per round, so log I/O never stalls the send loop with a
+ * flush per line.
+ */
+class Logger {
+public:
+    enum class Level { DEBUG, INFO, WARN, ERROR };
+    enum class Format { TEXT, JSON, LOGFMT };
+
+    /*
+     * Structure to hold one key/value pair of an event
+     */
+    struct Field {
+        const char* key;
+        std::string value;
+    };
+
+private:
+    /*
+     * Per-thread ring buffer, written by its thread and drained by the flusher
+     */
+    struct Ring {
+        static const size_t SIZE = 1 << 18;
+        char data[SIZE];
+        std::atomic<size_t> head{0};        // Bytes written (producer)
+        std::atomic<size_t> tail{0};        // Bytes drained (consumer)
+        std::atomic<bool> released{false};  // Owning thread has exited
+    };
+
+    /*
+     * Releases the thread's ring when the thread exits so it can be reused
+     */
+    struct RingHandle {
+        Ring* ring = nullptr;
+        ~RingHandle() {
+            if (ring) ring->released = true;
+        }
+    };
+
+    Format format = Format::TEXT;
+    Level threshold = Level::INFO;
+    int fd = STDOUT_FILENO;
+    std::mutex registry_lock;               // Guards rings and ring assignment
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::vector<Ring*> free_rings;
+    std::mutex drain_lock;                  // One consumer at a time
+    std::string pending;                    // Drained bytes awaiting write()
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    std::atomic<bool> running{false};
+    std::thread flusher;
+    std::mutex console_lock;                // One TEXT line at a time
+
+    static const char* levelName(Level level) {
+        switch (level) {
+            case Level::DEBUG: return "debug";
+            case Level::INFO: return "info";
+            case Level::WARN: return "warn";
+            default: return "error";
+        }
+    }
+
+    static void appendJsonString(std::string& out, const std::string& value) {
+        out += '"';
+        for (unsigned char c : value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += (char)c;
+            } else if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += (char)c;
+            }
+        }
+        out += '"';
+    }
+
+    static void appendLogfmtValue(std::string& out, const std::string& value) {
+        bool quote = value.empty() || value.find_first_of(" =\"") != std::string::npos;
+        if (!quote) {
+            out += value;
+        } else {
+            appendJsonString(out, value);
+        }
+    }
+
+    Ring* threadRing() {
+        thread_local RingHandle handle;
+        if (!handle.ring) {
+            std::lock_guard<std::mutex> lock(registry_lock);
+            if (!free_rings.empty()) {
+                handle.ring = free_rings.back();
+                free_rings.pop_back();
+                handle.ring->released = false;
+            } else {
+                rings.emplace_back(new Ring());
+                handle.ring = rings.back().get();
+            }
+        }
+        return handle.ring;
+    }
+
+    void writeAll(const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t written = ::write(fd, data, length);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            data += written;
+            length -= written;
+        }
+    }
+
+    /*
+     * @brief Moves everything buffered in the rings to the output
+     */
+    void drain() {
+        std::lock_guard<std::mutex> lock(drain_lock);
+        {
+            std::lock_guard<std::mutex> registry(registry_lock);
+            for (auto& ring : rings) {
+                bool released = ring->released.load(std::memory_order_acquire);
+                size_t tail = ring->tail.load(std::memory_order_relaxed);
+                size_t head = ring->head.load(std::memory_order_acquire);
+                for (size_t i = tail; i < head; ) {
+                    size_t offset = i % Ring::SIZE;
+                    size_t chunk = std::min(head - i, Ring::SIZE - offset);
+                    pending.append(ring->data + offset, chunk);
+                    i += chunk;
+                }
+                ring->tail.store(head, std::memory_order_release);
+                if (released && head == ring->head.load(std::memory_order_acquire) &&
+                    std::find(free_rings.begin(), free_rings.end(), ring.get()) == free_rings.end()) {
+                    free_rings.push_back(ring.get());
+                }
+            }
+        }
+        if (!pending.empty()) {
+            writeAll(pending.data(), pending.size());
+            pending.clear();
+        }
+    }
+
+    void flushLoop() {
+        while (running) {
+            {
+                std::unique_lock<std::mutex> lock(wake_lock);
+                wake.wait_for(lock, std::chrono::milliseconds(50));
+            }
+            drain();
+        }
+        drain();
+    }
+
+    void enqueue(const std::string& record) {
+        if (record.size() >= Ring::SIZE / 2 || !running.load(std::memory_order_acquire)) {
+            // Oversized records, and every record once the flusher has stopped (e.g. logging
+            // from a destructor at exit), bypass the ring, after whatever is already queued
+            drain();
+            std::lock_guard<std::mutex> lock(drain_lock);
+            writeAll(record.data(), record.size());
+            return;
+        }
+        Ring* ring = threadRing();
+        size_t head = ring->head.load(std::memory_order_relaxed);
+        while (head + record.size() - ring->tail.load(std::memory_order_acquire) > Ring::SIZE) {
+            if (!running.load(std::memory_order_acquire)) {
+                drain();    // The flusher stopped while this ring was full: nobody else will empty it
+                continue;
+            }
+            wake.notify_one();
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < record.size(); ) {
+            size_t offset = (head + i) % Ring::SIZE;
+            size_t chunk = std::min(record.size() - i, Ring::SIZE - offset);
+            std::memcpy(ring->data + offset, record.data() + i, chunk);
+            i += chunk;
+        }
+        ring->head.store(head + record.size(), std::memory_order_release);
+        if (head + record.size() - ring->tail.load(std::memory_order_relaxed) > Ring::SIZE / 2) {
+            wake.notify_one();
+        }
+    }
+
+public:
+    ~Logger() { stop(); }
+
+    /*
+     * @brief Applies the LOG_* settings and starts the flusher for structured output
+     * @throws std::runtime_error for unknown settings or an unwritable log file
+     */
+    void configure(const TwilioConfig& config) {
+        stop();
+        if (config.log_level == "debug") threshold = Level::DEBUG;
+        else if (config.log_level == "info") threshold = Level::INFO;
+        else if (config.log_level == "warn") threshold = Level::WARN;
+        else if (config.log_level == "error") threshold = Level::ERROR;
+        else throw std::runtime_error("Error: unknown LOG_LEVEL " + config.log_level);
+
+        if (fd != STDOUT_FILENO) ::close(fd);
+        fd = STDOUT_FILENO;
+        if (!config.log_file.empty()) {
+            fd = ::open(config.log_file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                fd = STDOUT_FILENO;
+                throw std::runtime_error("Error: cannot open log file " + config.log_file);
+            }
+        }
+
+        if (config.log_format == "text") format = Format::TEXT;
+        else if (config.log_format == "json") format = Format::JSON;
+        else if (config.log_format == "logfmt") format = Format::LOGFMT;
+        else if (config.log_format == "auto") {
+            format = config.log_file.empty() && isatty(STDOUT_FILENO) ? Format::TEXT : Format::JSON;
+        } else {
+            throw std::runtime_error("Error: unknown LOG_FORMAT " + config.log_format);
+        }
+
+        if (format != Format::TEXT) {
+            std::cout << std::flush;    // Console text written so far goes before the first record
+            running = true;
+            flusher = std::thread(&Logger::flushLoop, this);
+        }
+    }
+
+    /*
+     * @brief Stops the flusher after writing everything buffered
+     */
+    void stop() {
+        if (!running) return;
+        running = false;
+        wake.notify_one();
+        if (flusher.joinable()) flusher.join();
+    }
+
+    /*
+     * @brief Writes everything logged so far, e.g. before printing a report
+     */
+    void flush() {
+        std::cout << std::flush;
+        if (format != Format::TEXT) drain();
+    }
+
+    // True when events are shown as human-readable console lines
+    bool interactive() const { return format == Format::TEXT; }
+
+    bool enabled(Level level) const { return level >= threshold; }
+
+    /*
+     * @brief Logs an event
+     * @param level Severity
+     * @param event Short machine-readable event name
+     * @param fields Event attributes
+     * @param text Human-readable line for terminal output (built from the fields if empty)
+     */
+    void log(Level level, const char* event, std::initializer_list<Field> fields, const std::string& text = "") {
+        if (!enabled(level)) return;
+        if (format == Format::TEXT) {
+            // Engine callbacks log from many threads: build the line, then write it in one call
+            thread_local std::string line;
+            if (!text.empty()) {
+                line = text;
+            } else {
+                line = event;
+                for (const auto& field : fields) {
+                    line += ' ';
+                    line += field.key;
+                    line += '=';
+                    line += field.value;
+                }
+            }
+            line += '\n';
+            std::lock_guard<std::mutex> lock(console_lock);
+            std::cout.write(line.data(), line.size());
+            return;
+        }
+
+        thread_local std::string record;
+        record.clear();
+
+        // The date and time only change once a second; just the milliseconds are formatted per record
+        thread_local std::time_t cached_second = -1;
+        thread_local char timestamp[32];
+        auto now = std::chrono::system_clock::now();
+        long long millis_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now.time_since_epoch()).count();
+        std::time_t seconds = (std::time_t)(millis_since_epoch / 1000);
+        if (seconds != cached_second) {
+            std::tm utc{};
+            gmtime_r(&seconds, &utc);
+            std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S.000Z", &utc);
+            cached_second = seconds;
+        }
+        int millis = (int)(millis_since_epoch % 1000);
+        timestamp[20] = (char)('0' + millis / 100);
+        timestamp[21] = (char)('0' + millis / 10 % 10);
+        timestamp[22] = (char)('0' + millis % 10);
+
+        if (format == Format::JSON) {
+            record += "{\"ts\":\"";
+            record += timestamp;
+            record += "\",\"level\":\"";
+            record += levelName(level);
+            record += "\",\"event\":";
+            appendJsonString(record, event);
+            for (const auto& field : fields) {
+                record += ',';
+                appendJsonString(record, field.key);
+                record += ':';
+                appendJsonString(record, field.value);
+            }
+            record += "}\n";
+        } else {
+            record += "ts=";
+            record += timestamp;
+            record += " level=";
+            record += levelName(level);
+            record += " event=";
+            appendLogfmtValue(record, event);
+            for (const auto& field : fields) {
+                record += ' ';
+                record += field.key;
+                record += '=';
+                appendLogfmtValue(record, field.value);
+            }
+            record += '\n';
+        }
+        enqueue(record);
+    }
+
+    void debug(const char* event, std::initializer_list<Field> fields, const std::string& text = "") {
+        log(Level::DEBUG, event, fields, text);
+    }
+    void info(const char* event, std::initializer_list<Field> fields, const std::string& text = "") {
+        log(Level::INFO, event, fields, text);
+    }
+    void warn(const char* event, std::initializer_list<Field> fields, const std::string& text = "") {
+        log(Level::WARN, event, fields, text);
+    }
+    void error(const char* event, std::initializer_list<Field> fields, const std::string& text = "") {
+        log(Level::ERROR, event, fields, text);
+    }
+};
+
+/*
+ * @brief Returns the process-wide logger
+ */
+Logger& logger() {
+    static Logger instance;
+    return instance;
+}
+
+/*
+ * Stage profiler class
+ * Optional per-stage hardware counters (--profile). Each pipeline stage is
+ * bracketed by a Scope that reads a perf_event_open counter group (cycles,
+ * instructions, cache misses, branch misses; user space only) and the
+ * monotonic clock, and the deltas are accumulated per stage. Counters cover
+ * the thread that enabled profiling, which is the one running the campaign.
+ * Where the kernel or hypervisor offers no PMU, only times are reported.
+ */
+class StageProfiler {
+public:
+    enum Stage { LOAD, NORMALIZE, VALIDATE, RENDER, ENCODE, SUBMIT, PARSE, REPORT, STAGE_COUNT };
+    enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTER_COUNT };
+
+    /*
+     * Times and counter deltas of one stage
+     */
+    struct Totals {
+        uint64_t calls = 0;
+        uint64_t nanoseconds = 0;
+        uint64_t counters[COUNTER_COUNT] = {0, 0, 0, 0};
+    };
+
+    /*
+     * Brackets one execution of a stage; does nothing without an active profiler
+     */
+    class Scope {
+    private:
+        StageProfiler* owner;
+        Stage stage;
+        uint64_t start_ns = 0;
+        uint64_t start[COUNTER_COUNT];
+
+    public:
+        Scope(StageProfiler* profiler, Stage which) : owner(profiler), stage(which) {
+            if (owner) owner->sample(start_ns, start);
+        }
+        ~Scope() {
+            if (!owner) return;
+            uint64_t end_ns;
+            uint64_t end[COUNTER_COUNT];
+            owner->sample(end_ns, end);
+            Totals& totals = owner->totals[stage];
+            totals.calls++;
+            totals.nanoseconds += end_ns - start_ns;
+            for (int c = 0; c < COUNTER_COUNT; ++c) totals.counters[c] += end[c] - start[c];
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+private:
+    int leader = -1;
+    int fds[COUNTER_COUNT] = {-1, -1, -1, -1};
+    int slot[COUNTER_COUNT] = {-1, -1, -1, -1};     // Position of each counter in a group read
+    int opened = 0;
+    Totals totals[STAGE_COUNT];
+
+    static int openCounter(uint64_t config, int group) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = group < 0 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+    }
+
+    void sample(uint64_t& ns, uint64_t* values) const {
+        struct {
+            uint64_t count;
+            uint64_t values[COUNTER_COUNT];
+        } group{};
+        if (leader >= 0 && ::read(leader, &group, sizeof(group)) < (ssize_t)sizeof(uint64_t)) group.count = 0;
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            values[c] = slot[c] >= 0 && (uint64_t)slot[c] < group.count ? group.values[slot[c]] : 0;
+        }
+        ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    // Constructor: opens the counter group for the calling thread
+    StageProfiler() {
+        const uint64_t events[COUNTER_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            fds[c] = openCounter(events[c], leader);
+            if (fds[c] < 0) continue;
+            if (leader < 0) leader = fds[c];
+            slot[c] = opened++;
+        }
+        if (leader >= 0) ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    ~StageProfiler() {
+        for (int fd : fds) {
+            if (fd >= 0) ::close(fd);
+        }
+    }
+
+    StageProfiler(const StageProfiler&) = delete;
+    StageProfiler& operator=(const StageProfiler&) = delete;
+
+    bool available(Counter counter) const { return slot[counter] >= 0; }
+    bool hasCounters() const { return opened > 0; }
+    const Totals& stage(Stage which) const { return totals[which]; }
+
+    static const char* stageName(Stage which) {
+        static const char* names[STAGE_COUNT] = {"load", "normalize", "validate", "render", "encode", "submit",
+                                                 "parse", "report"};
+        return names[which];
+    }
+
+    /*
+     * @brief Prints per-call averages for every stage that ran
+     */
+    void print() const {
+        std::cout << Color::CYAN << "\n=== Stage Profile (per message) ===" << Color::RESET << "\n";
+        if (!hasCounters()) {
+            std::cout << Color::YELLOW << "Hardware counters unavailable (perf_event_open failed: check "
+                      << "/proc/sys/kernel/perf_event_paranoid or PMU support); showing times only\n"
+                      << Color::RESET;
+        }
+        std::cout << std::left << std::setw(11) << "stage" << std::setw(10) << "messages" << std::setw(11) << "time us"
+                  << std::setw(10) << "cycles" << std::setw(10) << "instr" << std::setw(7) << "IPC"
+                  << std::setw(13) << "cache miss" << "branch miss" << std::right << "\n";
+        auto counter = [&](const Totals& totals, Counter which, int width) {
+            std::ostringstream text;
+            if (available(which)) text << std::fixed << std::setprecision(which >= CACHE_MISSES ? 2 : 0)
+                                       << (double)totals.counters[which] / totals.calls;
+            else text << "-";
+            std::cout << std::left << std::setw(width) << text.str() << std::right;
+        };
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            const Totals& totals = this->totals[s];
+            if (totals.calls == 0) continue;
+            std::cout << std::left << std::setw(11) << stageName((Stage)s) << std::setw(10) << totals.calls
+                      << std::fixed << std::setprecision(2) << std::setw(11)
+                      << totals.nanoseconds / 1000.0 / totals.calls << std::right;
+            counter(totals, CYCLES, 10);
+            counter(totals, INSTRUCTIONS, 10);
+            std::ostringstream ipc;
+            if (available(CYCLES) && available(INSTRUCTIONS) && totals.counters[CYCLES] > 0) {
+                ipc << std::fixed << std::setprecision(2)
+                    << (double)totals.counters[INSTRUCTIONS] / totals.counters[CYCLES];
+            } else {
+                ipc << "-";
+            }
+            std::cout << std::left << std::setw(7) << ipc.str() << std::right;
+            counter(totals, CACHE_MISSES, 13);
+            counter(totals, BRANCH_MISSES, 11);
+            std::cout << "\n";
+        }
+        std::cout << "Low IPC with many cache misses per message points to a memory-bound stage; high IPC to a "
+                     "compute-bound one. Submit time is mostly network wait.\n";
+    }
+};
+
+/*
+ * @brief Returns the active stage profiler, or null when profiling is off
+ */
+StageProfiler*& profiler() {
+    static StageProfiler* active = nullptr;
+    return active;
+}
+
+/*
+ * Clock interface
+ * Source of time for everything that paces, schedules or timestamps sends, so
+ * the dispatch code can run against wall-clock time or a virtual clock.
+ */
+class Clock {
+public:
+    virtual ~Clock() = default;
+
+    /*
+     * @brief Current time in seconds since the Unix epoch
+     */
+    virtual double now() const = 0;
+
+    /*
+     * @brief Waits (or, for a virtual clock, advances) the given number of seconds
+     */
+    virtual void sleepFor(double seconds) = 0;
+
+    std::time_t wallTime() const { return (std::time_t)now(); }
+};
+
+/*
+ * System clock class
+ * Real time, real sleeps
+ */
+class SystemClock : public Clock {
+public:
+    double now() const override {
+        return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void sleepFor(double seconds) override {
+        if (seconds > 0) std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    }
+};
+
+/*
+ * Virtual clock class
+ * Time only moves when someone sleeps, so simulated hours pass instantly
+ */
+class VirtualClock : public Clock {
+private:
+    double current;
+
+public:
+    // Constructor
+    VirtualClock(double start) : current(start) {}
+
+    double now() const override { return current; }
+
+    void sleepFor(double seconds) override {
+        if (seconds > 0) current += seconds;
+    }
 };
 
+/*
+ * @brief Returns the process-wide system clock
+ */
+Clock& systemClock() {
+    static SystemClock clock;
+    return clock;
+}
+
 /*
  * @brief Displays the application banner in the console
  * Creates a visually appealing header using ASCII characters and colors
@@ -79,19 +786,128 @@ void displayProgress(int current, int total) {
     std::cout.flush();
 }
 
+/*
+ * @brief Parses a SENDER= configuration value
+ * @param spec Value in the form number[,daily=N][,monthly=N][,mps=N][,countries=55;1]
+ * @return SenderConfig structure for the sender
+ * @throws std::runtime_error if an option is not recognised
+ */
+SenderConfig parseSenderSpec(const std::string& spec) {
+    SenderConfig sender;
+    std::stringstream stream(spec);
+    std::string field;
+
+    std::getline(stream, sender.number, ',');
+    while (std::getline(stream, field, ',')) {
+        size_t eq = field.find('=');
+        std::string key = field.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : field.substr(eq + 1);
+
+        if (key == "daily") {
+            sender.quota.daily = std::stol(value);
+        } else if (key == "monthly") {
+            sender.quota.monthly = std::stol(value);
+        } else if (key == "mps") {
+            sender.mps = std::stod(value);
+            if (sender.mps <= 0) {
+                throw std::runtime_error(Color::RED + "Sender mps must be positive" + Color::RESET);
+            }
+        } else if (key == "countries") {
+            std::stringstream prefixes(value);
+            std::string prefix;
+            while (std::getline(prefixes, prefix, ';')) {
+                if (!prefix.empty()) sender.countries.push_back(prefix);
+            }
+        } else {
+            throw std::runtime_error(Color::RED + "Unknown sender option: " + key + Color::RESET);
+        }
+    }
+    return sender;
+}
+
+/*
+ * @brief Parses a SEND_WINDOW= configuration value
+ * @param spec Value in the form HH:MM-HH:MM (local time)
+ * @return SendWindow structure for the window
+ * @throws std::runtime_error if the value is malformed
+ */
+SendWindow parseSendWindow(const std::string& spec) {
+    int start_h, start_m, end_h, end_m;
+    if (std::sscanf(spec.c_str(), "%d:%d-%d:%d", &start_h, &start_m, &end_h, &end_m) != 4 ||
+        start_h < 0 || start_h > 23 || end_h < 0 || end_h > 24 ||
+        start_m < 0 || start_m > 59 || end_m < 0 || end_m > 59 || (end_h == 24 && end_m != 0)) {
+        throw std::runtime_error(Color::RED + "Invalid SEND_WINDOW (expected HH:MM-HH:MM, end at most 24:00): " +
+                                 spec + Color::RESET);
+    }
+    int start = start_h * 60 + start_m;
+    int end = end_h * 60 + end_m;
+    // Equal ends could mean an empty window or a whole day; 00:00-24:00 says the latter
+    if (start == end) {
+        throw std::runtime_error(Color::RED + "Invalid SEND_WINDOW (start and end are the same time): " +
+                                 spec + Color::RESET);
+    }
+    return {start, end};
+}
+
+/*
+ * @brief Returns true if only blanks or a trailing # comment follow a parsed value
+ */
+bool onlyCommentAfter(const char* rest) {
+    while (*rest == ' ' || *rest == '\t' || *rest == '\r') ++rest;
+    return *rest == '\0' || *rest == '#';
+}
+
+/*
+ * @brief Parses a whole-number config value
+ * @param key Config key, named in the error
+ * @param value Text after the '='
+ * @param min Smallest accepted value
+ * @param max Largest accepted value
+ * @throws std::runtime_error if the value is not a whole number in [min, max]
+ */
+long configInteger(const std::string& key, const std::string& value, long min, long max) {
+    errno = 0;
+    char* end = nullptr;
+    long parsed = std::strtol(value.c_str(), &end, 10);
+    if (end == value.c_str() || errno == ERANGE || !onlyCommentAfter(end) || parsed < min || parsed > max) {
+        throw std::runtime_error("Error: " + key + " must be a whole number " +
+                                 (max == LONG_MAX ? "of at least " + std::to_string(min)
+                                                  : "from " + std::to_string(min) + " to " + std::to_string(max)) +
+                                 ", not \"" + value + "\"");
+    }
+    return parsed;
+}
+
+/*
+ * @brief Parses a decimal config value
+ * @throws std::runtime_error if the value is not a number in [min, max]
+ */
+double configReal(const std::string& key, const std::string& value, double min, double max) {
+    char* end = nullptr;
+    double parsed = std::strtod(value.c_str(), &end);
+    if (end == value.c_str() || !onlyCommentAfter(end) || !(parsed >= min && parsed <= max)) {
+        std::ostringstream message;
+        message << "Error: " << key << " must be a number from " << min << " to " << max << ", not \"" << value
+                << "\"";
+        throw std::runtime_error(message.str());
+    }
+    return parsed;
+}
+
 /*
  * @brief Reads Twilio configuration from a file
+ * @param path Configuration file
  * @return TwilioConfig structure containing the configuration
  * @throws std::runtime_error if configuration file is missing or invalid
  */
-TwilioConfig readConfig() {
+TwilioConfig readConfig(const std::string& path = "twilio_config.txt") {
     TwilioConfig config;
-    std::ifstream config_file("twilio_config.txt");
+    std::ifstream config_file(path);
     
     if (!config_file.is_open()) {
         throw std::runtime_error(
-            "Error: twilio_config.txt not found!\n"
-            "Please create twilio_config.txt with the following format:\n"
+            "Error: " + path + " not found!\n"
+            "Please create " + path + " with the following format:\n"
             "ACCOUNT_SID=your_account_sid\n"
             "AUTH_TOKEN=your_auth_token\n"
             "PHONE_NUMBER=your_phone_number"
@@ -107,6 +923,109 @@ TwilioConfig readConfig() {
             config.auth_token = line.substr(11);
         } else if (line.find("PHONE_NUMBER=") == 0) {
             config.phone_number = line.substr(12);
+        } else if (line.find("SENDER=") == 0) {
+            config.senders.push_back(parseSenderSpec(line.substr(7)));
+        } else if (line.find("ACCOUNT_DAILY_LIMIT=") == 0) {
+            config.account_quota.daily = configInteger("ACCOUNT_DAILY_LIMIT", line.substr(20), 0, LONG_MAX);
+        } else if (line.find("ACCOUNT_MONTHLY_LIMIT=") == 0) {
+            config.account_quota.monthly = configInteger("ACCOUNT_MONTHLY_LIMIT", line.substr(22), 0, LONG_MAX);
+        } else if (line.find("CAMPAIGN_ID=") == 0) {
+            config.campaign_id = line.substr(12);
+        } else if (line.find("CAMPAIGN_DAILY_LIMIT=") == 0) {
+            config.campaign_quota.daily = configInteger("CAMPAIGN_DAILY_LIMIT", line.substr(21), 0, LONG_MAX);
+        } else if (line.find("CAMPAIGN_MONTHLY_LIMIT=") == 0) {
+            config.campaign_quota.monthly = configInteger("CAMPAIGN_MONTHLY_LIMIT", line.substr(23), 0, LONG_MAX);
+        } else if (line.find("QUOTA_FILE=") == 0) {
+            config.quota_file = line.substr(11);
+        } else if (line.find("QUOTA_HEADROOM=") == 0) {
+            config.quota_headroom = (int)configInteger("QUOTA_HEADROOM", line.substr(15), 0, 100);
+        } else if (line.find("SEND_WINDOW=") == 0) {
+            config.send_window = parseSendWindow(line.substr(12));
+        } else if (line.find("API_BASE_URL=") == 0) {
+            config.api_base_url = line.substr(13);
+        } else if (line.find("API_EDGES=") == 0) {
+            std::stringstream edges(line.substr(10));
+            std::string edge;
+            while (std::getline(edges, edge, ',')) {
+                if (!edge.empty()) config.api_edges.push_back(edge);
+            }
+        } else if (line.find("API_REGION=") == 0) {
+            config.api_region = line.substr(11);
+        } else if (line.find("EDGE_REPROBE_SECONDS=") == 0) {
+            config.edge_reprobe_seconds = (int)configInteger("EDGE_REPROBE_SECONDS", line.substr(21), 0, INT_MAX);
+        } else if (line.find("FREQUENCY_CAP=") == 0) {
+            config.frequency_cap = (int)configInteger("FREQUENCY_CAP", line.substr(14), 0, INT_MAX);
+        } else if (line.find("FREQUENCY_WINDOW_DAYS=") == 0) {
+            config.frequency_window_days = (int)configInteger("FREQUENCY_WINDOW_DAYS", line.substr(22), 1, 3650);
+        } else if (line.find("FREQUENCY_FILE=") == 0) {
+            config.frequency_file = line.substr(15);
+        } else if (line.find("LOOKUP_ENABLED=") == 0) {
+            config.lookup_enabled = line.substr(15) == "1" || line.substr(15) == "true";
+        } else if (line.find("LOOKUP_URL=") == 0) {
+            config.lookup_url = line.substr(11);
+        } else if (line.find("LOOKUP_CACHE_FILE=") == 0) {
+            config.lookup_cache_file = line.substr(18);
+        } else if (line.find("LOOKUP_TTL_DAYS=") == 0) {
+            config.lookup_ttl_days = (int)configInteger("LOOKUP_TTL_DAYS", line.substr(16), 0, 3650);
+        } else if (line.find("LOOKUP_CONCURRENCY=") == 0) {
+            config.lookup_concurrency = (int)configInteger("LOOKUP_CONCURRENCY", line.substr(19), 1, 1024);
+        } else if (line.find("SUPPRESSION_FILE=") == 0) {
+            config.suppression_file = line.substr(17);
+        } else if (line.find("INBOUND_PORT=") == 0) {
+            config.inbound_port = (int)configInteger("INBOUND_PORT", line.substr(13), 0, 65535);
+        } else if (line.find("INBOUND_BIND=") == 0) {
+            config.inbound_bind = line.substr(13);
+        } else if (line.find("SENT_JOURNAL=") == 0) {
+            config.sent_journal = line.substr(13);
+        } else if (line.find("RAMP_ENABLED=") == 0) {
+            config.ramp_enabled = line.substr(13) == "1" || line.substr(13) == "true";
+        } else if (line.find("RAMP_START_PERCENT=") == 0) {
+            config.ramp_start_percent = (int)configInteger("RAMP_START_PERCENT", line.substr(19), 1, 100);
+        } else if (line.find("RAMP_WINDOW=") == 0) {
+            config.ramp_window = (int)configInteger("RAMP_WINDOW", line.substr(12), 1, INT_MAX);
+        } else if (line.find("RAMP_PAUSE_RATIO=") == 0) {
+            config.ramp_pause_ratio = configReal("RAMP_PAUSE_RATIO", line.substr(17), 0, 1);
+        } else if (line.find("RAMP_ABORT_RATIO=") == 0) {
+            config.ramp_abort_ratio = configReal("RAMP_ABORT_RATIO", line.substr(17), 0, 1);
+        } else if (line.find("RAMP_PAUSE_SECONDS=") == 0) {
+            config.ramp_pause_seconds = (int)configInteger("RAMP_PAUSE_SECONDS", line.substr(19), 0, 86400);
+        } else if (line.find("RAMP_MAX_PAUSES=") == 0) {
+            config.ramp_max_pauses = (int)configInteger("RAMP_MAX_PAUSES", line.substr(16), 0, INT_MAX);
+        } else if (line.find("RETRY_ATTEMPTS=") == 0) {
+            config.retry_attempts = (int)configInteger("RETRY_ATTEMPTS", line.substr(15), 1, 100);
+        } else if (line.find("RETRY_BACKOFF_MS=") == 0) {
+            config.retry_backoff_ms = (int)configInteger("RETRY_BACKOFF_MS", line.substr(17), 0, 60000);
+        } else if (line.find("LOG_FORMAT=") == 0) {
+            config.log_format = line.substr(11);
+        } else if (line.find("LOG_LEVEL=") == 0) {
+            config.log_level = line.substr(10);
+        } else if (line.find("LOG_FILE=") == 0) {
+            config.log_file = line.substr(9);
+        } else if (line.find("REJECTS_FILE=") == 0) {
+            config.rejects_file = line.substr(13);
+        } else if (line.find("ARCHIVE_FILE=") == 0) {
+            config.archive_file = line.substr(13);
+        } else if (line.find("STATUS_FILE=") == 0) {
+            config.status_file = line.substr(12);
+        } else if (line.find("TOKEN_KEY=") == 0) {
+            config.token_key = line.substr(10);
+        } else if (line.find("TOKEN_INDEX=") == 0) {
+            config.token_index = line.substr(12);
+        } else if (line.find("QUEUE_FILE=") == 0) {
+            config.queue_file = line.substr(11);
+        } else if (line.find("KEEPALIVE_SECONDS=") == 0) {
+            config.keepalive_seconds = (int)configInteger("KEEPALIVE_SECONDS", line.substr(18), 0, 86400);
+        } else if (line.find("THREAD_PLACEMENT=") == 0) {
+            config.thread_placement = line.substr(17);
+        } else if (line.find("ENGINE_WORKERS=") == 0) {
+            config.engine_workers = (int)configInteger("ENGINE_WORKERS", line.substr(15), 1, 1024);
+        } else if (line.find("LOG_VALID_NUMBERS=") == 0) {
+            config.log_valid_numbers = line.substr(18) != "0";
+        } else if (line.find("HTTP_TIMEOUT_SECONDS=") == 0) {
+            config.http_timeout_seconds = (int)configInteger("HTTP_TIMEOUT_SECONDS", line.substr(21), 1, 3600);
+        } else if (line.find("INBOUND_URL=") == 0) {
+            config.inbound_url = line.substr(12);
+            while (!config.inbound_url.empty() && config.inbound_url.back() == '/') config.inbound_url.pop_back();
         }
     }
     
@@ -114,234 +1033,7833 @@ TwilioConfig readConfig() {
     if (config.account_sid.empty() || config.auth_token.empty() || config.phone_number.empty()) {
         throw std::runtime_error(Color::RED + "Invalid configuration in twilio_config.txt" + Color::RESET);
     }
+
+    // Without SENDER= lines the configured phone number is the only sender
+    if (config.senders.empty()) {
+        SenderConfig primary;
+        primary.number = config.phone_number;
+        config.senders.push_back(primary);
+    }
     
     return config;
 }
 
 /*
- * Main SMS Sender class
- * Handles all SMS sending operations and phone number management
+ * @brief Packs a normalized phone number into a 64-bit integer
+ * E.164 numbers have at most 15 digits and never start with 0, so the digits
+ * read as a decimal integer identify the number uniquely.
+ * @param number Normalized phone number (+[country][number])
+ * @return Packed number, or 0 if the input holds no digits
+ */
+uint64_t packPhoneNumber(const std::string& number) {
+    uint64_t packed = 0;
+    for (char c : number) {
+        if (c >= '0' && c <= '9') packed = packed * 10 + (uint64_t)(c - '0');
+    }
+    return packed;
+}
+
+/*
+ * @brief Converts a packed number back to its normalized string form
  */
-class SMSSender {
+std::string unpackPhoneNumber(uint64_t packed) {
+    return "+" + std::to_string(packed);
+}
+
+/*
+ * @brief Checks whether a sender may deliver to a recipient's country
+ * @param sender Sender with its eligible country prefixes
+ * @param number Normalized recipient number (+[country][number])
+ */
+bool senderServes(const SenderConfig& sender, const std::string& number) {
+    if (sender.countries.empty()) return true;
+    for (const auto& prefix : sender.countries) {
+        if (number.compare(1, prefix.size(), prefix) == 0) return true;
+    }
+    return false;
+}
+
+/*
+ * @brief Flushes a file's directory entry, after it was created or renamed into place
+ * Without it a crash can bring back the directory as it was before the rename.
+ */
+void syncDirectory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+}
+
+/*
+ * Quota manager class
+ * Keeps persistent daily and monthly counters per sender, account and campaign.
+ * Counters reset on local calendar boundaries and survive restarts through the
+ * quota state file, so caps hold across separate runs of the tool.
+ */
+class QuotaManager {
 private:
-    TwilioConfig config;
-    
+    /*
+     * Structure to hold the usage of one scope in the current day and month
+     */
+    struct Counter {
+        std::string day;        // Day the daily count belongs to (YYYYMMDD)
+        long daily_count = 0;   // Messages sent on that day
+        std::string month;      // Month the monthly count belongs to (YYYYMM)
+        long monthly_count = 0; // Messages sent in that month
+    };
+
+    const TwilioConfig& config;
+    Clock& clock;
+    std::string path;           // Empty: counters are kept in memory only
+    std::map<std::string, Counter> counters;   // Keyed by "scope:name"
+    bool dirty = false;
+    double last_save;
+
+    /*
+     * @brief Formats the current local time with a strftime pattern
+     */
+    std::string calendarKey(const char* format) const {
+        std::time_t now = clock.wallTime();
+        std::tm local{};
+        localtime_r(&now, &local);
+        char buffer[16];
+        std::strftime(buffer, sizeof(buffer), format, &local);
+        return buffer;
+    }
+
+    /*
+     * @brief Returns the counter for a scope, rolled over to the current day and month
+     */
+    Counter& counter(const std::string& key) {
+        Counter& c = counters[key];
+        std::string today = calendarKey("%Y%m%d");
+        std::string this_month = calendarKey("%Y%m");
+        if (c.day != today) {
+            c.day = today;
+            c.daily_count = 0;
+        }
+        if (c.month != this_month) {
+            c.month = this_month;
+            c.monthly_count = 0;
+        }
+        return c;
+    }
+
+    /*
+     * @brief Returns how many more messages a scope may send (-1 if uncapped)
+     */
+    long remaining(const std::string& key, const QuotaLimits& limits) {
+        const Counter& c = counter(key);
+        long left = -1;
+        if (limits.daily > 0) left = std::max(0L, limits.daily - c.daily_count);
+        if (limits.monthly > 0) {
+            long month_left = std::max(0L, limits.monthly - c.monthly_count);
+            left = left < 0 ? month_left : std::min(left, month_left);
+        }
+        return left;
+    }
+
+    static long combine(long a, long b) {
+        if (a < 0) return b;
+        if (b < 0) return a;
+        return std::min(a, b);
+    }
+
+public:
+    // Constructor
+    QuotaManager(const TwilioConfig& cfg, Clock& time_source = systemClock())
+        : config(cfg), clock(time_source), path(cfg.quota_file) {
+        last_save = clock.now();
+    }
+
+    // Persist any pending counts when the manager goes away
+    ~QuotaManager() {
+        try { save(); } catch (...) {}
+    }
+
+    /*
+     * @brief Loads the persisted counters; a missing file means a fresh start
+     */
+    void load() {
+        if (path.empty()) return;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            std::string key;
+            Counter c;
+            if (fields >> key >> c.day >> c.daily_count >> c.month >> c.monthly_count) {
+                counters[key] = c;
+            }
+        }
+    }
+
+    /*
+     * @brief Writes the counters to disk, replacing the previous state atomically
+     * @throws std::runtime_error if the state file cannot be written
+     */
+    void save() {
+        if (!dirty || path.empty()) return;
+        std::string tmp = path + ".tmp";
+        std::ostringstream text;
+        text << "# scope:name day daily_count month monthly_count\n";
+        for (const auto& entry : counters) {
+            text << entry.first << " " << entry.second.day << " " << entry.second.daily_count
+                 << " " << entry.second.month << " " << entry.second.monthly_count << "\n";
+        }
+        std::string contents = text.str();
+
+        // Synced before the rename and the directory after it: a crash must never bring back an empty file,
+        // which load() would read as a fresh start with every cap unused
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Error: cannot write quota state to " + tmp + ": " + std::strerror(errno));
+        }
+        bool ok = ::write(fd, contents.data(), contents.size()) == (ssize_t)contents.size() && fsync(fd) == 0;
+        int error = errno;
+        ::close(fd);
+        if (!ok) throw std::runtime_error("Error: cannot write quota state to " + tmp + ": " + std::strerror(error));
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Error: cannot replace quota state file " + path);
+        }
+        syncDirectory(path);
+        dirty = false;
+        last_save = clock.now();
+    }
+
+    /*
+     * @brief Returns how many messages a sender may still send right now
+     * @return Remaining messages, or -1 if no cap applies
+     */
+    long remainingFor(const SenderConfig& sender) {
+        long left = remaining("sender:" + sender.number, sender.quota);
+        left = combine(left, remaining("account:" + config.account_sid, config.account_quota));
+        left = combine(left, remaining("campaign:" + config.campaign_id, config.campaign_quota));
+        return left;
+    }
+
+    /*
+     * @brief Checks whether a sender is within the spill headroom of its own cap
+     */
+    bool nearCap(const SenderConfig& sender) {
+        const Counter& c = counter("sender:" + sender.number);
+        auto near = [&](long limit, long used) {
+            return limit > 0 && (limit - used) * 100 <= limit * config.quota_headroom;
+        };
+        return near(sender.quota.daily, c.daily_count) || near(sender.quota.monthly, c.monthly_count);
+    }
+
+    /*
+     * @brief Picks the sender for the next message
+     * @param recipient Recipient number, to skip senders not eligible for its country
+     * @param preferred Index of the sender dispatch would normally use
+     * @return Index into config.senders, or -1 if every eligible sender is capped
+     */
+    int pickSender(const std::string& recipient, size_t preferred = 0) {
+        int fallback = -1;
+        size_t count = config.senders.size();
+        for (size_t k = 0; k < count; ++k) {
+            size_t i = (preferred + k) % count;
+            const SenderConfig& sender = config.senders[i];
+            if (!senderServes(sender, recipient) || remainingFor(sender) == 0) continue;
+            if (!nearCap(sender)) return (int)i;
+            if (fallback < 0) fallback = (int)i;
+        }
+        return fallback;
+    }
+
+    /*
+     * @brief Counts a sent message against every scope it belongs to
+     */
+    void record(const SenderConfig& sender) {
+        for (const std::string& key : {"sender:" + sender.number,
+                                       "account:" + config.account_sid,
+                                       "campaign:" + config.campaign_id}) {
+            Counter& c = counter(key);
+            c.daily_count++;
+            c.monthly_count++;
+        }
+        dirty = true;
+
+        // Flush at most once per second so counters survive a crash mid-campaign
+        if (clock.now() - last_save > 1.0) {
+            save();
+        }
+    }
+
+    /*
+     * @brief Gives back a message counted by record() that was never sent
+     * Callers sending concurrently count a message before sending it, so
+     * that no two of them can spend the same last unit of a cap.
+     */
+    void release(const SenderConfig& sender) {
+        for (const std::string& key : {"sender:" + sender.number,
+                                       "account:" + config.account_sid,
+                                       "campaign:" + config.campaign_id}) {
+            Counter& c = counter(key);
+            if (c.daily_count > 0) c.daily_count--;
+            if (c.monthly_count > 0) c.monthly_count--;
+        }
+        dirty = true;
+    }
+
+    /*
+     * @brief Total messages all senders may still send today (-1 if uncapped)
+     */
+    long capacityToday() {
+        long total = 0;
+        for (const auto& sender : config.senders) {
+            long left = remaining("sender:" + sender.number, sender.quota);
+            if (left < 0) {
+                total = -1;
+                break;
+            }
+            total += left;
+        }
+        total = combine(total, remaining("account:" + config.account_sid, config.account_quota));
+        return combine(total, remaining("campaign:" + config.campaign_id, config.campaign_quota));
+    }
+
+    /*
+     * @brief Seconds until the next local midnight, or the start of next month
+     */
+    long secondsUntilBoundary(bool monthly) const {
+        std::time_t now = clock.wallTime();
+        std::tm next{};
+        localtime_r(&now, &next);
+        if (monthly) {
+            next.tm_mon += 1;
+            next.tm_mday = 1;
+        } else {
+            next.tm_mday += 1;
+        }
+        next.tm_hour = 0;
+        next.tm_min = 0;
+        next.tm_sec = 0;
+        next.tm_isdst = -1;
+        return std::max(1L, (long)(std::mktime(&next) - now));
+    }
+
+    /*
+     * @brief Seconds until a recipient can be sent to again after every sender was capped
+     * A sender becomes usable when the last of its exhausted scopes resets: at
+     * midnight for a daily cap, at the start of next month for a monthly one.
+     * @param recipient Recipient number, to consider only senders eligible for it
+     * @return Seconds until the earliest eligible sender is usable (at least 1)
+     */
+    long secondsUntilReset(const std::string& recipient) {
+        auto blocked_for = [&](const std::string& key, const QuotaLimits& limits) {
+            const Counter& c = counter(key);
+            if (limits.monthly > 0 && c.monthly_count >= limits.monthly) return secondsUntilBoundary(true);
+            if (limits.daily > 0 && c.daily_count >= limits.daily) return secondsUntilBoundary(false);
+            return 0L;
+        };
+        long account = blocked_for("account:" + config.account_sid, config.account_quota);
+        long campaign = blocked_for("campaign:" + config.campaign_id, config.campaign_quota);
+        long wait = -1;
+        for (const auto& sender : config.senders) {
+            if (!senderServes(sender, recipient)) continue;
+            long usable = std::max({blocked_for("sender:" + sender.number, sender.quota), account, campaign});
+            wait = wait < 0 ? usable : std::min(wait, usable);
+        }
+        return wait > 0 ? wait : secondsUntilBoundary(false);
+    }
+};
+
+/*
+ * @brief Counts the SMS segments a message body will be split into
+ * Bodies using only the GSM-7 alphabet fit 160 characters (153 per part when
+ * concatenated); anything else is sent as UCS-2 with 70 (67) characters.
+ * @param message UTF-8 message body
+ * @return Number of segments billed and rate-limited by the carrier
+ */
+int countSegments(const std::string& message) {
+    static const std::string gsm_extended = "^{}\\[~]|";
+    bool gsm = true;
+    size_t gsm_units = 0;
+    size_t ucs2_units = 0;
+
+    for (size_t i = 0; i < message.size();) {
+        unsigned char c = message[i];
+        size_t length = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        if (c < 0x80) {
+            if (c == '`' || (c < 0x20 && c != '\n' && c != '\r')) gsm = false;
+            gsm_units += gsm_extended.find((char)c) != std::string::npos ? 2 : 1;
+        } else if (message.compare(i, length, "€") == 0) {
+            gsm_units += 2;
+        } else {
+            gsm = false;
+        }
+        ucs2_units += length == 4 ? 2 : 1;  // Astral characters need a surrogate pair
+        i += length;
+    }
+
+    if (gsm) return gsm_units <= 160 ? 1 : (int)((gsm_units + 152) / 153);
+    return ucs2_units <= 70 ? 1 : (int)((ucs2_units + 66) / 67);
+}
+
+/*
+ * TrackingTokens class
+ * Fills {{token}} slots in a message with a per-recipient token: SipHash-2-4
+ * of the packed number under a key derived from TOKEN_KEY and the campaign
+ * ID, written as 11 base62 characters. Tokens are fixed width, so the message
+ * is laid out once and each recipient only overwrites the slots in place.
+ * A sidecar index maps tokens back to recipients for click attribution.
+ */
+class TrackingTokens {
+public:
+    static const size_t WIDTH = 11;         // 62^11 > 2^64
+    static constexpr const char* SLOT = "{{token}}";
+
+private:
+    static constexpr const char* ALPHABET = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    static const char INDEX_MAGIC[8];
+
+    /*
+     * Structure of one index entry; the index is sorted by token
+     */
+    struct IndexEntry {
+        uint64_t token;
+        uint64_t number;        // Packed recipient
+    };
+
+    uint64_t k0 = 0, k1 = 0;   // Campaign key
+    std::string rendered;       // Message with the slots of the last recipient filled in
+    std::vector<size_t> slots;  // Offsets of the slots in rendered
+
+    static uint64_t rotl(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+    static void sipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+        v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+        v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+        v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+        v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+    }
+
+    /*
+     * @brief SipHash-2-4 of a byte string
+     */
+    static uint64_t sipHash(uint64_t key0, uint64_t key1, const std::string& data) {
+        uint64_t v0 = key0 ^ 0x736f6d6570736575ULL, v1 = key1 ^ 0x646f72616e646f6dULL;
+        uint64_t v2 = key0 ^ 0x6c7967656e657261ULL, v3 = key1 ^ 0x7465646279746573ULL;
+        size_t full = data.size() / 8 * 8;
+        for (size_t i = 0; i <= full; i += 8) {
+            uint64_t m = 0;
+            if (i < full) {
+                std::memcpy(&m, data.data() + i, 8);
+            } else {
+                // Last block: remaining bytes plus the length in the top byte
+                std::memcpy(&m, data.data() + i, data.size() - full);
+                m |= (uint64_t)data.size() << 56;
+            }
+            v3 ^= m;
+            sipRound(v0, v1, v2, v3);
+            sipRound(v0, v1, v2, v3);
+            v0 ^= m;
+        }
+        v2 ^= 0xff;
+        for (int i = 0; i < 4; ++i) sipRound(v0, v1, v2, v3);
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+public:
+    // Constructor: lays out the message and derives the campaign key
+    TrackingTokens(const std::string& message, const TwilioConfig& config) {
+        if (config.token_key.size() != 32 ||
+            config.token_key.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            throw std::runtime_error("Error: " + std::string(SLOT) +
+                                     " needs TOKEN_KEY=<32 hex digits> in twilio_config.txt");
+        }
+        uint64_t key0 = std::stoull(config.token_key.substr(0, 16), nullptr, 16);
+        uint64_t key1 = std::stoull(config.token_key.substr(16), nullptr, 16);
+        k0 = sipHash(key0, key1, config.campaign_id + '\0');
+        k1 = sipHash(key0, key1, config.campaign_id + '\1');
+
+        for (size_t at = 0;;) {
+            size_t slot = message.find(SLOT, at);
+            rendered += message.substr(at, slot == std::string::npos ? std::string::npos : slot - at);
+            if (slot == std::string::npos) break;
+            slots.push_back(rendered.size());
+            rendered.append(WIDTH, '0');
+            at = slot + std::strlen(SLOT);
+        }
+    }
+
+    static bool uses(const std::string& message) { return message.find(SLOT) != std::string::npos; }
+
+    /*
+     * @brief Computes a recipient's token
+     * SipHash-2-4 of one 8-byte block, unrolled: two compression rounds for
+     * the number and two for the length block, then finalization.
+     */
+    uint64_t token(uint64_t packed) const {
+        uint64_t v0 = k0 ^ 0x736f6d6570736575ULL, v1 = k1 ^ 0x646f72616e646f6dULL;
+        uint64_t v2 = k0 ^ 0x6c7967656e657261ULL, v3 = k1 ^ 0x7465646279746573ULL;
+        v3 ^= packed;
+        sipRound(v0, v1, v2, v3);
+        sipRound(v0, v1, v2, v3);
+        v0 ^= packed;
+        const uint64_t last = 8ULL << 56;
+        v3 ^= last;
+        sipRound(v0, v1, v2, v3);
+        sipRound(v0, v1, v2, v3);
+        v0 ^= last;
+        v2 ^= 0xff;
+        for (int i = 0; i < 4; ++i) sipRound(v0, v1, v2, v3);
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+    /*
+     * @brief Writes a token as WIDTH base62 characters, most significant first
+     * The value is split as hi * 62^10 + mid * 62^5 + lo so the 10 low digits
+     * come from two 32-bit chains; with SSE2 the two chains run side by side in
+     * one register, dividing by 62 with a multiply and a shift, and the digits
+     * are mapped to characters without lookups or branches.
+     */
+    static void encode(uint64_t value, char* out) {
+        const uint64_t POW5 = 916132832ULL;             // 62^5
+        uint32_t lo = (uint32_t)(value % POW5);
+        value /= POW5;
+        uint32_t mid = (uint32_t)(value % POW5);
+        out[0] = ALPHABET[value / POW5];
+#ifdef __SSE2__
+        // One 64-bit lane per chain; x / 62 == (x * 2216757315) >> 37 for x < 62^5
+        __m128i x = _mm_set_epi64x(lo, mid);
+        const __m128i magic = _mm_set1_epi64x(2216757315LL);
+        const __m128i base = _mm_set1_epi64x(62);
+        __m128i chars = _mm_setzero_si128();
+        for (int d = 4; d >= 0; --d) {
+            __m128i quotient = _mm_srli_epi64(_mm_mul_epu32(x, magic), 37);
+            __m128i digit = _mm_sub_epi64(x, _mm_mul_epu32(quotient, base));
+            // '0' + digit, skipping the gaps before 'A' (7) and 'a' (6)
+            __m128i c = _mm_add_epi32(digit, _mm_set1_epi64x('0'));
+            c = _mm_add_epi32(c, _mm_and_si128(_mm_cmpgt_epi32(digit, _mm_set1_epi64x(9)), _mm_set1_epi64x(7)));
+            c = _mm_add_epi32(c, _mm_and_si128(_mm_cmpgt_epi32(digit, _mm_set1_epi64x(35)), _mm_set1_epi64x(6)));
+            chars = _mm_or_si128(chars, _mm_sll_epi64(c, _mm_cvtsi32_si128(8 * d)));
+            x = quotient;
+        }
+        alignas(16) char text[16];
+        _mm_store_si128((__m128i*)text, chars);
+        std::memcpy(out + 1, text, 5);
+        std::memcpy(out + 6, text + 8, 5);
+#else
+        for (int d = 5; d >= 1; --d) {
+            out[d] = ALPHABET[mid % 62];
+            mid /= 62;
+        }
+        for (int d = 10; d >= 6; --d) {
+            out[d] = ALPHABET[lo % 62];
+            lo /= 62;
+        }
+#endif
+    }
+
+    /*
+     * @brief Parses a token written by encode
+     * @return false if the text is not a token
+     */
+    static bool decode(const std::string& text, uint64_t& value) {
+        if (text.size() != WIDTH) return false;
+        unsigned __int128 total = 0;
+        for (char c : text) {
+            const char* digit = std::strchr(ALPHABET, c);
+            if (!c || !digit) return false;
+            total = total * 62 + (unsigned)(digit - ALPHABET);
+        }
+        if (total > UINT64_MAX) return false;
+        value = (uint64_t)total;
+        return true;
+    }
+
+    /*
+     * @brief Fills the slots for one recipient
+     * @param packed Packed recipient number
+     * @return The rendered message, valid until the next call
+     */
+    const std::string& render(uint64_t packed) {
+        char text[WIDTH];
+        encode(token(packed), text);
+        for (size_t slot : slots) std::memcpy(&rendered[slot], text, WIDTH);
+        return rendered;
+    }
+
+    /*
+     * @brief Returns the message as every recipient gets it, up to the token text
+     * Segment counts of the preview hold for every recipient: the base62
+     * alphabet is plain GSM-7 and tokens are fixed width.
+     */
+    const std::string& preview() const { return rendered; }
+
+    /*
+     * @brief Adds the tokens of a recipient list to the sidecar index
+     * Written before the first send, so a click on any message that went out
+     * can be attributed even if the campaign is interrupted. Entries of earlier
+     * campaigns are kept: only the new entries are sorted, then streamed
+     * together with the mapped old index into a file that replaces it
+     * atomically, so memory stays proportional to this campaign.
+     * @param numbers Normalized recipients
+     * @param path Index file
+     * @throws std::runtime_error if the index cannot be read or written
+     */
+    void writeIndex(const std::vector<std::string>& numbers, const std::string& path) const {
+        auto before = [](const IndexEntry& a, const IndexEntry& b) {
+            return a.token != b.token ? a.token < b.token : a.number < b.number;
+        };
+        std::vector<IndexEntry> added;
+        added.reserve(numbers.size());
+        for (const auto& number : numbers) {
+            uint64_t packed = packPhoneNumber(number);
+            added.push_back({token(packed), packed});
+        }
+        std::sort(added.begin(), added.end(), before);
+
+        // The old index is merged, never rebuilt: anything but a valid one would lose its campaigns
+        const IndexEntry* old = nullptr;
+        size_t old_count = 0;
+        void* data = MAP_FAILED;
+        size_t size = 0;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0 && errno != ENOENT) {
+            throw std::runtime_error("Error: cannot open token index " + path + ": " + std::strerror(errno));
+        }
+        if (fd >= 0) {
+            struct stat info{};
+            fstat(fd, &info);
+            size = (size_t)info.st_size;
+            if (size > 0) {
+                data = size >= sizeof(INDEX_MAGIC) && (size - sizeof(INDEX_MAGIC)) % sizeof(IndexEntry) == 0
+                    ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+                if (data == MAP_FAILED || std::memcmp(data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+                    if (data != MAP_FAILED) munmap(data, size);
+                    ::close(fd);
+                    throw std::runtime_error("Error: " + path + " is not a token index; move it aside or set "
+                                             "another TOKEN_INDEX");
+                }
+                old = (const IndexEntry*)((const char*)data + sizeof(INDEX_MAGIC));
+                old_count = (size - sizeof(INDEX_MAGIC)) / sizeof(IndexEntry);
+                madvise(data, size, MADV_SEQUENTIAL);
+            }
+            ::close(fd);
+        }
+
+        std::string tmp = path + ".tmp";
+        bool ok;
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+            IndexEntry last{};
+            bool any = false;
+            auto emit = [&](const IndexEntry& entry) {
+                if (any && entry.token == last.token && entry.number == last.number) return;
+                out.write((const char*)&entry, sizeof(entry));
+                last = entry;
+                any = true;
+            };
+            size_t i = 0, j = 0;
+            while (i < old_count || j < added.size()) {
+                if (j == added.size() || (i < old_count && !before(added[j], old[i]))) emit(old[i++]);
+                else emit(added[j++]);
+            }
+            ok = (bool)out;
+        }
+        if (data != MAP_FAILED) munmap(data, size);
+        if (!ok) throw std::runtime_error("Error: cannot write token index " + tmp);
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Error: cannot replace token index " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    /*
+     * @brief Finds the recipients of tokens in an index
+     * @param path Index file
+     * @param tokens Tokens as they appeared in the messages
+     * @return For each token, the recipients it was issued to (empty if unknown)
+     * @throws std::runtime_error if the index cannot be read
+     */
+    static std::vector<std::vector<std::string>> lookup(const std::string& path, const std::vector<std::string>& tokens) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Error: cannot open token index " + path + ": " + std::strerror(errno));
+        struct stat info{};
+        fstat(fd, &info);
+        size_t size = (size_t)info.st_size;
+        void* data = size >= sizeof(INDEX_MAGIC) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (data == MAP_FAILED || std::memcmp(data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+            if (data != MAP_FAILED) munmap(data, size);
+            throw std::runtime_error("Error: " + path + " is not a token index");
+        }
+        const IndexEntry* begin = (const IndexEntry*)((const char*)data + sizeof(INDEX_MAGIC));
+        const IndexEntry* end = begin + (size - sizeof(INDEX_MAGIC)) / sizeof(IndexEntry);
+
+        std::vector<std::vector<std::string>> found(tokens.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            uint64_t value;
+            if (!decode(tokens[i], value)) continue;
+            const IndexEntry* at = std::lower_bound(begin, end, value, [](const IndexEntry& e, uint64_t t) {
+                return e.token < t;
+            });
+            for (; at != end && at->token == value; ++at) found[i].push_back(unpackPhoneNumber(at->number));
+        }
+        munmap(data, size);
+        return found;
+    }
+};
+
+const char TrackingTokens::INDEX_MAGIC[8] = {'S', 'M', 'S', 'T', 'O', 'K', '0', '1'};
+
+/*
+ * @brief Returns the earliest local time at or after a given time inside the send window
+ */
+std::time_t nextWindowOpening(std::time_t when, const SendWindow& window) {
+    if (window.start_minute == 0 && window.end_minute >= 24 * 60) return when;
+
+    std::tm local{};
+    localtime_r(&when, &local);
+    int minute = local.tm_hour * 60 + local.tm_min;
+    bool wraps = window.end_minute < window.start_minute;
+    bool inside = wraps ? (minute >= window.start_minute || minute < window.end_minute)
+                        : (minute >= window.start_minute && minute < window.end_minute);
+    if (inside) return when;
+
+    // Jump to the window start today, or tomorrow if it has already passed
+    if (minute >= window.start_minute) local.tm_mday += 1;
+    local.tm_hour = window.start_minute / 60;
+    local.tm_min = window.start_minute % 60;
+    local.tm_sec = 0;
+    local.tm_isdst = -1;
+    return std::mktime(&local);
+}
+
+/*
+ * @brief Adds sending time to a start time, counting only time inside the send window
+ * @param start Local time sending starts
+ * @param seconds Seconds of sending required
+ * @param window Daily send window
+ * @return Predicted local completion time
+ */
+std::time_t windowedCompletion(std::time_t start, double seconds, const SendWindow& window) {
+    std::time_t now = nextWindowOpening(start, window);
+    if (window.start_minute == 0 && window.end_minute >= 24 * 60) return now + (std::time_t)seconds;
+
+    while (seconds > 0) {
+        std::tm local{};
+        localtime_r(&now, &local);
+        int minute = local.tm_hour * 60 + local.tm_min;
+        int open_minutes = window.end_minute - minute;
+        if (open_minutes <= 0) open_minutes += 24 * 60;
+        double open = open_minutes * 60.0 - local.tm_sec;
+        if (seconds <= open) return now + (std::time_t)seconds;
+        seconds -= open;
+        now = nextWindowOpening(now + (std::time_t)open, window);
+    }
+    return now;
+}
+
+/*
+ * ThreadPlacement class
+ * Spreads worker threads over the NUMA nodes of the machine and pins them
+ * there. The nodes and their CPUs come from sysfs, restricted to the CPUs
+ * this process may run on; without NUMA information the machine is one node.
+ * Workers are assigned to nodes in contiguous blocks, the same way callers
+ * partition their arrays, so worker i of n works on node-local data when
+ * slice i was first touched by worker i. A pinned thread allocates on its own
+ * node under the kernel's default first-touch policy.
+ */
+class ThreadPlacement {
+public:
+    enum class Mode { NONE, NODES, CORES };
+
+private:
+    Mode mode = Mode::NONE;
+    std::vector<std::vector<int>> nodes;    // Usable CPUs of each node that has any
+
+    static std::vector<int> parseCpuList(const std::string& text) {
+        std::vector<int> cpus;
+        std::stringstream list(text);
+        std::string range;
+        while (std::getline(list, range, ',')) {
+            if (range.empty() || !std::isdigit((unsigned char)range[0])) continue;
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    // First worker of a node when workers are spread evenly over the nodes
+    size_t firstWorker(size_t node, size_t workers) const {
+        return (node * workers + nodes.size() - 1) / nodes.size();
+    }
+
+public:
+    // Constructor: reads the topology; throws std::runtime_error for an unknown setting
+    explicit ThreadPlacement(const std::string& setting) {
+        if (setting == "none" || setting.empty()) mode = Mode::NONE;
+        else if (setting == "nodes") mode = Mode::NODES;
+        else if (setting == "cores") mode = Mode::CORES;
+        else throw std::runtime_error("Error: unknown THREAD_PLACEMENT " + setting + " (none, nodes or cores)");
+
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) CPU_SET(cpu, &allowed);
+        }
+        for (int node = 0;; ++node) {
+            std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!list) break;
+            std::string text;
+            std::getline(list, text);
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(text)) {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+            }
+            if (!cpus.empty()) nodes.push_back(cpus);
+        }
+        if (nodes.empty()) {
+            nodes.emplace_back();
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &allowed)) nodes.back().push_back(cpu);
+            }
+        }
+    }
+
+    Mode placement() const { return mode; }
+    size_t nodeCount() const { return nodes.size(); }
+
+    size_t cpuCount() const {
+        size_t count = 0;
+        for (const auto& cpus : nodes) count += cpus.size();
+        return count;
+    }
+
+    /*
+     * @brief Node of worker i when n workers are spread evenly over the nodes
+     */
+    size_t nodeOf(size_t worker, size_t workers) const {
+        return worker * nodes.size() / std::max<size_t>(1, workers);
+    }
+
+    /*
+     * @brief Pins the calling thread as worker i of n (no-op when placement is off)
+     * @return The worker's node
+     */
+    size_t pin(size_t worker, size_t workers) const {
+        size_t node = nodeOf(worker, workers);
+        if (mode == Mode::NONE) return node;
+        const std::vector<int>& cpus = nodes[node];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (mode == Mode::NODES) {
+            for (int cpu : cpus) CPU_SET(cpu, &set);
+        } else {
+            CPU_SET(cpus[(worker - firstWorker(node, workers)) % cpus.size()], &set);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        return node;
+    }
+};
+
+/*
+ * LSD radix sort over 64-bit keys
+ * Sorts by digits from the lowest up, each pass a stable counting sort:
+ * threads histogram their own slice of the array, a prefix sum over
+ * (digit, thread) gives every thread its own output ranges, and the threads
+ * then scatter their slices in parallel. Only the bits that differ between
+ * keys are sorted on (packed numbers span about 47 of the 64), split into as
+ * few passes of at most 12 bits as they need. An optional payload array is
+ * permuted along with the keys; equal keys keep their input order.
+ */
+namespace RadixSort {
+
+const int MAX_DIGIT_BITS = 12;              // 4096 counters per thread stay in L1
+const size_t MIN_PER_THREAD = 1 << 16;      // Smaller slices are not worth a thread
+const size_t SMALL = 256;                   // Below this, insertion sort wins
+
+/*
+ * @brief Runs body(thread) on every thread index and waits for all of them
+ */
+inline void parallel(unsigned threads, const std::function<void(unsigned)>& body) {
+    if (threads == 1) {
+        body(0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) workers.emplace_back(body, t);
+    body(0);
+    for (auto& worker : workers) worker.join();
+}
+
+/*
+ * @brief Sorts keys ascending, permuting payload the same way
+ * @param keys Keys to sort in place
+ * @param payload Values moved with their keys (may be null)
+ * @param n Number of keys
+ * @param threads Threads to use (0 = one per hardware thread)
+ */
+template <typename Payload>
+void sort(uint64_t* keys, Payload* payload, size_t n, unsigned threads = 0) {
+    if (n < SMALL) {
+        // Insertion sort: stable, and fast for the few keys this handles
+        for (size_t i = 1; i < n; ++i) {
+            uint64_t key = keys[i];
+            Payload value{};
+            if (payload) value = payload[i];
+            size_t j = i;
+            for (; j > 0 && keys[j - 1] > key; --j) {
+                keys[j] = keys[j - 1];
+                if (payload) payload[j] = payload[j - 1];
+            }
+            keys[j] = key;
+            if (payload) payload[j] = value;
+        }
+        return;
+    }
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = (unsigned)std::max<size_t>(1, std::min<size_t>(threads, n / MIN_PER_THREAD));
+    auto begin = [&](unsigned t) { return n * t / threads; };
+
+    // Bits in which some key differs from the first one; the rest need no pass
+    std::vector<uint64_t> differing(threads, 0);
+    parallel(threads, [&](unsigned t) {
+        uint64_t first = keys[0], bits = 0;
+        for (size_t i = begin(t); i < begin(t + 1); ++i) bits |= keys[i] ^ first;
+        differing[t] = bits;
+    });
+    uint64_t varying = 0;
+    for (uint64_t bits : differing) varying |= bits;
+    if (varying == 0) return;
+    int low = __builtin_ctzll(varying);
+    int width = 64 - __builtin_clzll(varying) - low;
+    int passes = (width + MAX_DIGIT_BITS - 1) / MAX_DIGIT_BITS;
+    int digit_bits = (width + passes - 1) / passes;
+    size_t buckets = (size_t)1 << digit_bits;
+
+    std::vector<uint64_t> key_buffer(n);
+    std::vector<Payload> payload_buffer(payload ? n : 0);
+    uint64_t* from_keys = keys;
+    uint64_t* to_keys = key_buffer.data();
+    Payload* from_payload = payload;
+    Payload* to_payload = payload ? payload_buffer.data() : nullptr;
+    std::vector<size_t> counts((size_t)threads * buckets);
+
+    for (int pass = 0; pass < passes; ++pass) {
+        int shift = low + pass * digit_bits;
+        uint64_t mask = buckets - 1;
+
+        parallel(threads, [&](unsigned t) {
+            size_t* local = &counts[(size_t)t * buckets];
+            std::fill(local, local + buckets, 0);
+            for (size_t i = begin(t); i < begin(t + 1); ++i) local[(from_keys[i] >> shift) & mask]++;
+        });
+
+        // Thread t writes digit b after every smaller digit and after threads < t with digit b
+        size_t position = 0;
+        for (size_t b = 0; b < buckets; ++b) {
+            for (unsigned t = 0; t < threads; ++t) {
+                size_t count = counts[(size_t)t * buckets + b];
+                counts[(size_t)t * buckets + b] = position;
+                position += count;
+            }
+        }
+
+        parallel(threads, [&](unsigned t) {
+            size_t* next = &counts[(size_t)t * buckets];
+            for (size_t i = begin(t); i < begin(t + 1); ++i) {
+                size_t at = next[(from_keys[i] >> shift) & mask]++;
+                to_keys[at] = from_keys[i];
+                if (from_payload) to_payload[at] = from_payload[i];
+            }
+        });
+        std::swap(from_keys, to_keys);
+        std::swap(from_payload, to_payload);
+    }
+
+    if (from_keys != keys) {
+        std::memcpy(keys, from_keys, n * sizeof(uint64_t));
+        if (payload) std::copy(from_payload, from_payload + n, payload);
+    }
+}
+
+inline void sort(uint64_t* keys, size_t n, unsigned threads = 0) {
+    sort<uint8_t>(keys, nullptr, n, threads);
+}
+
+/*
+ * @brief Maps a non-negative double to a key with the same order
+ */
+inline uint64_t orderedKey(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+}  // namespace RadixSort
+
+/*
+ * Structure to hold the dispatch plan for a campaign
+ * Entries are ordered by their planned start offset. Offsets and the makespan
+ * follow the campaign runner, which sends one message at a time in this order;
+ * the plan balances the senders' pacing but cannot make requests overlap, so
+ * when the round trip is longer than a sender's pacing interval the senders
+ * idle between requests whatever the assignment.
+ */
+struct CampaignPlan {
+    struct Entry {
+        size_t recipient;       // Index into the recipient list
+        int sender;             // Index into config.senders
+        double offset;          // Planned start, in sending seconds after launch
+    };
+
+    std::vector<Entry> entries;         // Dispatch order
+    std::vector<size_t> per_sender;     // Recipients assigned to each sender
+    std::vector<size_t> unservable;     // Recipients no sender is eligible for
+    double makespan = 0;                // Sending seconds until the last reply
+    double pacing_makespan = 0;         // Seconds the senders' pacing alone would need
+    size_t deferred = 0;                // Recipients beyond today's quota
+};
+
+/*
+ * @brief Partitions recipients across senders to minimise campaign makespan
+ * Every message costs the same on a given sender, so greedy earliest-finish
+ * assignment (round-robin weighted by rate) is all it takes: the most
+ * constrained recipients (fewest eligible senders) are placed first, each on
+ * the eligible sender that will finish it earliest given its rate, the
+ * message segment count and the quota it has left today. Recipients beyond
+ * every sender's quota are still planned, and are sent after the daily reset.
+ * The timing is then replayed the way the runner dispatches: one request at a
+ * time, each starting once the previous reply is in and its sender's pacing
+ * allows. The assignment only predicts that dispatch; it does not make it
+ * concurrent, so pacing_makespan is reported alongside to show what the
+ * senders could do with overlapping requests (as the send engine does).
+ * @param numbers Recipient list
+ * @param config Configuration with the sender pool
+ * @param quotas Quota manager for today's remaining capacity
+ * @param segments Segments per message
+ * @param send_seconds Expected duration of one API request
+ * @return CampaignPlan with an assignment and dispatch order
+ */
+CampaignPlan planCampaign(const std::vector<std::string>& numbers, const TwilioConfig& config,
+                          QuotaManager& quotas, int segments, double send_seconds) {
+    CampaignPlan plan;
+    size_t sender_count = config.senders.size();
+    plan.per_sender.assign(sender_count, 0);
+
+    std::vector<double> cost(sender_count);
+    std::vector<long> capacity(sender_count);
+    for (size_t s = 0; s < sender_count; ++s) {
+        cost[s] = segments / config.senders[s].mps;
+        capacity[s] = quotas.remainingFor(config.senders[s]);
+    }
+
+    // Collect the eligible senders of each recipient; most constrained first.
+    // Keys are (eligible sender count, recipient), so sorting them groups recipients by constraint.
+    std::vector<uint64_t> order;
+    order.reserve(numbers.size());
+    for (size_t r = 0; r < numbers.size(); ++r) {
+        uint64_t eligible = 0;
+        for (const auto& sender : config.senders) eligible += senderServes(sender, numbers[r]);
+        if (eligible == 0) {
+            plan.unservable.push_back(r);
+        } else {
+            order.push_back(eligible << 40 | r);
+        }
+    }
+    RadixSort::sort(order.data(), order.size());
+
+    std::vector<double> finish(sender_count, 0.0);
+    plan.entries.reserve(order.size());
+    for (uint64_t item : order) {
+        size_t r = (size_t)(item & ((1ULL << 40) - 1));
+        int best = -1;
+        bool best_in_quota = false;
+        for (size_t s = 0; s < sender_count; ++s) {
+            if (!senderServes(config.senders[s], numbers[r])) continue;
+            bool in_quota = capacity[s] != 0;
+            // Prefer senders with quota left today, then the earliest finish
+            if (best < 0 || (in_quota && !best_in_quota) ||
+                (in_quota == best_in_quota && finish[s] + cost[s] < finish[best] + cost[best])) {
+                best = (int)s;
+                best_in_quota = in_quota;
+            }
+        }
+        if (!best_in_quota) plan.deferred++;
+        if (capacity[best] > 0) capacity[best]--;
+
+        plan.entries.push_back({r, best, finish[best]});
+        finish[best] += cost[best];
+        plan.per_sender[best]++;
+    }
+
+    // Dispatch order: by planned start, ties in assignment order (the sort is stable)
+    std::vector<uint64_t> starts(plan.entries.size());
+    std::vector<uint32_t> index(plan.entries.size());
+    for (size_t i = 0; i < plan.entries.size(); ++i) {
+        starts[i] = RadixSort::orderedKey(plan.entries[i].offset);
+        index[i] = (uint32_t)i;
+    }
+    RadixSort::sort(starts.data(), index.data(), index.size());
+    std::vector<CampaignPlan::Entry> ordered(plan.entries.size());
+    for (size_t i = 0; i < index.size(); ++i) ordered[i] = plan.entries[index[i]];
+    plan.entries.swap(ordered);
+
+    // Sequential dispatch: senders pace independently, but requests never overlap
+    std::vector<double> next_free(sender_count, 0.0);
+    double reply = 0;
+    for (auto& entry : plan.entries) {
+        entry.offset = std::max(reply, next_free[entry.sender]);
+        next_free[entry.sender] = entry.offset + cost[entry.sender];
+        reply = entry.offset + send_seconds;
+    }
+    plan.makespan = reply;
+    plan.pacing_makespan = *std::max_element(finish.begin(), finish.end());
+    return plan;
+}
+
+/*
+ * Edge selector class
+ * Probes the configured Twilio regional edges and keeps the fastest one.
+ * Edges are given as "frankfurt" (uses API_REGION), "dublin.ie1" or a full URL;
+ * each becomes a base URL such as https://api.frankfurt.us1.twilio.com.
+ */
+class EdgeSelector {
+private:
+    std::vector<std::string> candidates;    // Base URLs to probe
+    std::vector<double> latency_ms;         // Last probe result per candidate (-1 = unreachable)
+    size_t selected = 0;                    // Index of the fastest candidate
+    int reprobe_seconds;
+    std::chrono::steady_clock::time_point last_probe;
+
+    static size_t DiscardCallback(void*, size_t size, size_t nmemb, void*) {
+        return size * nmemb;
+    }
+
+public:
+    // Constructor
+    EdgeSelector(const TwilioConfig& cfg) : reprobe_seconds(cfg.edge_reprobe_seconds) {
+        for (const auto& edge : cfg.api_edges) {
+            if (edge.find("://") != std::string::npos) {
+                candidates.push_back(edge);
+            } else if (edge.find('.') != std::string::npos) {
+                candidates.push_back("https://api." + edge + ".twilio.com");
+            } else {
+                candidates.push_back("https://api." + edge + "." + cfg.api_region + ".twilio.com");
+            }
+        }
+        if (candidates.empty()) candidates.push_back(cfg.api_base_url);
+        latency_ms.assign(candidates.size(), -1);
+        last_probe = std::chrono::steady_clock::now();
+    }
+
+    /*
+     * @brief Measures the round trip to every candidate in parallel and selects the fastest
+     * Each candidate is probed twice on a fresh connection (DNS, TCP, TLS and one
+     * HTTP exchange); the best sample counts, so a single slow handshake does not
+     * disqualify an edge. The current edge is kept if every probe fails.
+     * @return Base URL of the selected edge
+     */
+    const std::string& probe() {
+        last_probe = std::chrono::steady_clock::now();
+        if (candidates.size() == 1) return candidates[0];
+
+        std::fill(latency_ms.begin(), latency_ms.end(), -1.0);
+        CURLM* multi = curl_multi_init();
+        std::vector<CURL*> handles;
+
+        for (int round = 0; round < 2; ++round) {
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                CURL* curl = curl_easy_init();
+                if (!curl) continue;
+                curl_easy_setopt(curl, CURLOPT_URL, (candidates[i] + "/2010-04-01.json").c_str());
+                curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+                curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 3000L);
+                curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 1L);
+                curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, DiscardCallback);
+                curl_easy_setopt(curl, CURLOPT_PRIVATE, (void*)i);
+                curl_multi_add_handle(multi, curl);
+                handles.push_back(curl);
+            }
+
+            int running = 0;
+            do {
+                curl_multi_perform(multi, &running);
+                if (running) curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+            } while (running);
+
+            int queued = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+                if (msg->msg != CURLMSG_DONE || msg->data.result != CURLE_OK) continue;
+                void* index = nullptr;
+                curl_off_t total_us = 0;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &index);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_TOTAL_TIME_T, &total_us);
+                double& best = latency_ms[(size_t)index];
+                double sample = total_us / 1000.0;
+                if (best < 0 || sample < best) best = sample;
+            }
+
+            for (CURL* curl : handles) {
+                curl_multi_remove_handle(multi, curl);
+                curl_easy_cleanup(curl);
+            }
+            handles.clear();
+        }
+        curl_multi_cleanup(multi);
+
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if (latency_ms[i] >= 0 && (latency_ms[selected] < 0 || latency_ms[i] < latency_ms[selected])) {
+                selected = i;
+            }
+        }
+        return candidates[selected];
+    }
+
+    /*
+     * @brief Checks whether the periodic re-probe interval has elapsed
+     */
+    bool reprobeDue() const {
+        return candidates.size() > 1 && reprobe_seconds > 0 &&
+               std::chrono::steady_clock::now() - last_probe > std::chrono::seconds(reprobe_seconds);
+    }
+
+    const std::string& current() const { return candidates[selected]; }
+    const std::vector<std::string>& edges() const { return candidates; }
+    double latency(size_t i) const { return latency_ms[i]; }
+};
+
+/*
+ * @brief Expected duration of one send, for campaign planning
+ * Uses the probed round trip of the selected edge (measured on a fresh
+ * connection, so it errs long); without a probe, a typical API latency.
+ */
+double expectedSendSeconds(const EdgeSelector& edges) {
+    const double TYPICAL_SEND_SECONDS = 0.2;
+    for (size_t i = 0; i < edges.edges().size(); ++i) {
+        if (edges.edges()[i] == edges.current() && edges.latency(i) >= 0) return edges.latency(i) / 1000.0;
+    }
+    return TYPICAL_SEND_SECONDS;
+}
+
+/*
+ * Memory-mapped hash table class
+ * Open-addressing table (linear probing) of fixed-size slots stored in a file
+ * and mapped into memory, so lookups cost no syscalls and the contents persist
+ * between runs. Each Slot must start with a uint64_t key; key 0 marks an empty
+ * slot, which matches the zero-filled pages of a freshly extended file.
+ */
+template <typename Slot>
+class MappedHashTable {
+private:
+    /*
+     * Structure at the start of the file, padded to keep slots cache-aligned
+     */
+    struct Header {
+        char magic[8];          // Identifies the store type
+        uint32_t slot_size;     // sizeof(Slot) when the file was created
+        uint32_t reserved;
+        uint64_t capacity;      // Number of slots (power of two)
+        uint64_t count;         // Occupied slots
+        char padding[32];
+    };
+
+    std::string path;
+    std::string magic;
+    int fd = -1;
+    size_t mapped_size = 0;
+    Header* header = nullptr;
+    Slot* slots = nullptr;
+
+    static uint64_t mix(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        return key ^ (key >> 33);
+    }
+
+    /*
+     * @brief Opens (creating if needed) and maps a table file
+     */
+    void open(const std::string& file, uint64_t capacity) {
+        fd = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Error: cannot open " + file + ": " + std::strerror(errno));
+        }
+
+        struct stat info{};
+        if (fstat(fd, &info) != 0) {
+            int error = errno;
+            close();
+            throw std::runtime_error("Error: cannot stat " + file + ": " + std::strerror(error));
+        }
+        bool fresh = info.st_size < (off_t)sizeof(Header);
+        if (fresh) {
+            mapped_size = sizeof(Header) + capacity * sizeof(Slot);
+            if (ftruncate(fd, mapped_size) != 0) {
+                int error = errno;
+                close();
+                throw std::runtime_error("Error: cannot size " + file + ": " + std::strerror(error));
+            }
+        } else {
+            mapped_size = info.st_size;
+        }
+
+        void* memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (memory == MAP_FAILED) {
+            int error = errno;
+            close();
+            throw std::runtime_error("Error: cannot map " + file + ": " + std::strerror(error));
+        }
+        header = (Header*)memory;
+        slots = (Slot*)((char*)memory + sizeof(Header));
+
+        if (fresh) {
+            std::memcpy(header->magic, magic.c_str(), std::min(magic.size(), sizeof(header->magic)));
+            header->slot_size = sizeof(Slot);
+            header->capacity = capacity;
+            header->count = 0;
+        } else {
+            // The header comes from disk: its capacity becomes a probe mask, so check it before use
+            uint64_t stored = header->capacity;
+            bool valid = std::memcmp(header->magic, magic.c_str(), std::min(magic.size(), sizeof(header->magic))) == 0 &&
+                         header->slot_size == sizeof(Slot) &&
+                         stored != 0 && (stored & (stored - 1)) == 0 &&
+                         stored <= (mapped_size - sizeof(Header)) / sizeof(Slot) &&
+                         header->count < stored;
+            if (!valid) {
+                close();
+                throw std::runtime_error("Error: " + file + " is not a valid " + magic + " store");
+            }
+        }
+    }
+
+    void close() {
+        if (header) munmap(header, mapped_size);
+        if (fd >= 0) ::close(fd);
+        header = nullptr;
+        slots = nullptr;
+        fd = -1;
+    }
+
+    /*
+     * @brief Doubles the capacity by rehashing into a new file that replaces the old one
+     * The old mapping stays in use until the new file is renamed into place and
+     * mapped, so a failure leaves the table usable.
+     */
+    void grow() {
+        std::string tmp = path + ".grow";
+        std::remove(tmp.c_str());
+        {
+            MappedHashTable bigger(tmp, magic, header->capacity * 2);
+            for (uint64_t i = 0; i < header->capacity; ++i) {
+                if (slots[i].key != 0) *bigger.findOrInsert(slots[i].key) = slots[i];
+            }
+            bigger.sync();
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            int error = errno;
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Error: cannot replace " + path + ": " + std::strerror(error));
+        }
+
+        int old_fd = fd;
+        size_t old_size = mapped_size;
+        Header* old_header = header;
+        Slot* old_slots = slots;
+        fd = -1;
+        header = nullptr;
+        try {
+            open(path, 0);
+        } catch (const std::exception&) {
+            // Keep working on the old mapping; its contents are already in the new file
+            fd = old_fd;
+            mapped_size = old_size;
+            header = old_header;
+            slots = old_slots;
+            throw;
+        }
+        munmap(old_header, old_size);
+        ::close(old_fd);
+    }
+
+public:
+    // Constructor
+    MappedHashTable(const std::string& file, const std::string& type, uint64_t initial_capacity = 1 << 16)
+        : path(file), magic(type) {
+        open(file, initial_capacity);
+    }
+
+    ~MappedHashTable() { close(); }
+
+    MappedHashTable(const MappedHashTable&) = delete;
+    MappedHashTable& operator=(const MappedHashTable&) = delete;
+
+    /*
+     * @brief Hints the CPU to load the first probe slot of a key ahead of use
+     */
+    void prefetch(uint64_t key) const {
+        __builtin_prefetch(&slots[mix(key) & (header->capacity - 1)]);
+    }
+
+    /*
+     * @brief Looks up a key
+     * @return Pointer to the slot, or nullptr if the key is not stored
+     */
+    Slot* find(uint64_t key) const {
+        uint64_t mask = header->capacity - 1;
+        for (uint64_t i = mix(key) & mask;; i = (i + 1) & mask) {
+            if (slots[i].key == key) return &slots[i];
+            if (slots[i].key == 0) return nullptr;
+        }
+    }
+
+    /*
+     * @brief Looks up a key, inserting a zeroed slot for it if absent
+     * @return Pointer to the slot (valid until the next insertion)
+     */
+    Slot* findOrInsert(uint64_t key) {
+        if ((header->count + 1) * 10 > header->capacity * 7) grow();
+        uint64_t mask = header->capacity - 1;
+        for (uint64_t i = mix(key) & mask;; i = (i + 1) & mask) {
+            if (slots[i].key == key) return &slots[i];
+            if (slots[i].key == 0) {
+                slots[i] = Slot{};
+                slots[i].key = key;
+                header->count++;
+                return &slots[i];
+            }
+        }
+    }
+
+    /*
+     * @brief Flushes dirty pages to disk
+     */
+    void sync() {
+        if (header) msync(header, mapped_size, MS_SYNC);
+    }
+
+    uint64_t size() const { return header->count; }
+};
+
+/*
+ * Frequency store class
+ * Remembers when each recipient was last messaged, across campaigns and runs,
+ * so nobody receives more than FREQUENCY_CAP messages per window. Keeps the
+ * most recent send times of each packed number in one cache line.
+ */
+class FrequencyStore {
+private:
+    static const int HISTORY = 14;  // Send times kept per recipient
+
+    /*
+     * Structure to hold one recipient's recent send times (minutes since epoch)
+     */
+    struct Slot {
+        uint64_t key;
+        uint32_t sends[HISTORY];
+    };
+    static_assert(sizeof(Slot) == 64, "frequency slots must fill one cache line");
+
+    MappedHashTable<Slot> table;
+    int cap;
+    uint32_t window_minutes;
+    Clock& clock;
+
+    uint32_t nowMinutes() const {
+        return (uint32_t)(clock.wallTime() / 60);
+    }
+
+    int recentSends(const Slot* slot, uint32_t now) const {
+        if (!slot) return 0;
+        int recent = 0;
+        for (uint32_t sent : slot->sends) {
+            recent += sent != 0 && now - sent < window_minutes;
+        }
+        return recent;
+    }
+
+public:
+    static const int MAX_CAP = HISTORY;
+
+    // Constructor
+    FrequencyStore(const TwilioConfig& cfg, Clock& time_source = systemClock())
+        : table(cfg.frequency_file, "SMSFREQ"), cap(cfg.frequency_cap),
+          window_minutes((uint32_t)cfg.frequency_window_days * 24 * 60), clock(time_source) {
+        if (cap > MAX_CAP) {
+            throw std::runtime_error(Color::RED + "FREQUENCY_CAP may not exceed " +
+                                     std::to_string(MAX_CAP) + Color::RESET);
+        }
+    }
+
+    /*
+     * @brief Checks whether a recipient may be messaged again
+     */
+    bool allowed(uint64_t packed) const {
+        return recentSends(table.find(packed), nowMinutes()) < cap;
+    }
+
+    /*
+     * @brief Checks a batch of recipients, prefetching slots ahead of the probes
+     * Table lookups are random memory accesses; issuing the loads a few keys
+     * ahead keeps several cache misses in flight instead of one at a time.
+     * @param keys Packed recipient numbers
+     * @param count Number of keys
+     * @param allowed_out Set to 1 for keys below the cap, 0 otherwise
+     * @return Number of allowed keys
+     */
+    size_t filterBatch(const uint64_t* keys, size_t count, uint8_t* allowed_out) const {
+        const size_t distance = 16;
+        uint32_t now = nowMinutes();
+        size_t allowed_count = 0;
+        for (size_t i = 0; i < std::min(distance, count); ++i) table.prefetch(keys[i]);
+        for (size_t i = 0; i < count; ++i) {
+            if (i + distance < count) table.prefetch(keys[i + distance]);
+            allowed_out[i] = recentSends(table.find(keys[i]), now) < cap;
+            allowed_count += allowed_out[i];
+        }
+        return allowed_count;
+    }
+
+    /*
+     * @brief Records a successful send, replacing the oldest remembered one
+     */
+    void recordSend(uint64_t packed) {
+        Slot* slot = table.findOrInsert(packed);
+        uint32_t* oldest = &slot->sends[0];
+        for (uint32_t& sent : slot->sends) {
+            if (sent < *oldest) oldest = &sent;
+        }
+        *oldest = nowMinutes();
+    }
+
+    void sync() { table.sync(); }
+};
+
+/*
+ * Number lookup class
+ * Optional pre-pass that asks a carrier/line-type lookup endpoint about each
+ * recipient and drops invalid numbers and landlines before dispatch. Results
+ * are cached by packed number in a memory-mapped table with a TTL, so repeat
+ * lists are answered from memory without network requests.
+ */
+class NumberLookup {
+public:
+    /*
+     * Line types reported by the lookup endpoint
+     */
+    enum LineType : uint8_t {
+        UNKNOWN = 0, MOBILE, LANDLINE, FIXED_VOIP, NON_FIXED_VOIP, TOLL_FREE, OTHER
+    };
+
+    /*
+     * Structure to hold the outcome of a lookup pre-pass
+     */
+    struct Stats {
+        size_t cached = 0;      // Answered from the local cache
+        size_t queried = 0;     // Answered by the endpoint
+        size_t errors = 0;      // Lookups that failed (numbers are kept)
+        size_t invalid = 0;     // Dropped: endpoint reports the number invalid
+        size_t landline = 0;    // Dropped: landline
+    };
+
+private:
+    /*
+     * Structure to hold one cached lookup result
+     */
+    struct Slot {
+        uint64_t key;
+        uint32_t checked;       // Minutes since epoch of the lookup
+        uint8_t valid;
+        uint8_t line_type;
+        uint16_t reserved;
+    };
+
+    const TwilioConfig& config;
+    MappedHashTable<Slot> cache;
+    uint32_t ttl_minutes;
+
+    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+        ((std::string*)userp)->append((char*)contents, size * nmemb);
+        return size * nmemb;
+    }
+
+    static LineType parseLineType(const std::string& type) {
+        if (type == "mobile") return MOBILE;
+        if (type == "landline") return LANDLINE;
+        if (type == "fixedVoip") return FIXED_VOIP;
+        if (type == "nonFixedVoip") return NON_FIXED_VOIP;
+        if (type == "tollFree") return TOLL_FREE;
+        return type.empty() ? UNKNOWN : OTHER;
+    }
+
+    static bool keep(const Slot& slot, Stats& stats) {
+        if (!slot.valid) {
+            stats.invalid++;
+            return false;
+        }
+        if (slot.line_type == LANDLINE) {
+            stats.landline++;
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Structure to hold one in-flight lookup request
+     */
+    struct Request {
+        size_t index;
+        std::string url;
+        std::string response;
+    };
+
+public:
+    // Constructor
+    NumberLookup(const TwilioConfig& cfg)
+        : config(cfg), cache(cfg.lookup_cache_file, "SMSLOOK"),
+          ttl_minutes((uint32_t)cfg.lookup_ttl_days * 24 * 60) {}
+
+    /*
+     * @brief Removes invalid numbers and landlines from a recipient list
+     * Cached results are used while fresh; the rest are queried with up to
+     * LOOKUP_CONCURRENCY requests in flight over shared connections.
+     * @param numbers Normalized recipient numbers, filtered in place
+     * @return Stats structure describing what was checked and dropped
+     */
+    Stats filter(std::vector<std::string>& numbers) {
+        Stats stats;
+        uint32_t now = (uint32_t)(std::time(nullptr) / 60);
+        std::vector<uint8_t> keep_flags(numbers.size(), 1);
+        std::vector<size_t> pending;
+
+        // Answer what we can from the cache
+        for (size_t i = 0; i < numbers.size(); ++i) {
+            if (i + 16 < numbers.size()) cache.prefetch(packPhoneNumber(numbers[i + 16]));
+            const Slot* slot = cache.find(packPhoneNumber(numbers[i]));
+            if (slot && now - slot->checked < ttl_minutes) {
+                stats.cached++;
+                keep_flags[i] = keep(*slot, stats);
+            } else {
+                pending.push_back(i);
+            }
+        }
+
+        // Query the endpoint for the rest
+        CURLM* multi = curl_multi_init();
+        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)config.lookup_concurrency);
+        std::vector<Request> requests(pending.size());
+        size_t next = 0, done = 0;
+        int running = 0;
+
+        auto start = [&](size_t r) {
+            Request& request = requests[r];
+            request.index = pending[r];
+            request.url = config.lookup_url + "/%2B" + numbers[request.index].substr(1) +
+                          "?Fields=line_type_intelligence";
+            CURL* curl = curl_easy_init();
+            curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+            curl_easy_setopt(curl, CURLOPT_USERNAME, config.account_sid.c_str());
+            curl_easy_setopt(curl, CURLOPT_PASSWORD, config.auth_token.c_str());
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &request.response);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 10000L);
+            curl_easy_setopt(curl, CURLOPT_PRIVATE, (void*)r);
+            curl_multi_add_handle(multi, curl);
+        };
+
+        while (done < pending.size()) {
+            while (next < pending.size() && (int)(next - done) < config.lookup_concurrency) {
+                start(next++);
+            }
+            curl_multi_perform(multi, &running);
+            if (running) curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+
+            int queued = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+                if (msg->msg != CURLMSG_DONE) continue;
+                void* r = nullptr;
+                long status = 0;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &r);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+                Request& request = requests[(size_t)r];
+
+                Slot result{};
+                bool answered = false;
+                if (msg->data.result == CURLE_OK && (status == 200 || status == 404)) {
+                    try {
+                        json response = json::parse(request.response);
+                        // A 404 only means "invalid number" when it is a lookup answer saying so; a wrong
+                        // LOOKUP_URL also returns 404, and must not drop (or cache) the whole list
+                        if (status == 404 && !(response.is_object() && response.contains("valid") &&
+                                               response["valid"].is_boolean() && !response["valid"].get<bool>())) {
+                            throw std::runtime_error("not a lookup response");
+                        }
+                        result.valid = response.value("valid", true);
+                        if (response.contains("line_type_intelligence") &&
+                            response["line_type_intelligence"].is_object()) {
+                            const json& line = response["line_type_intelligence"];
+                            if (line.contains("type") && line["type"].is_string()) {
+                                result.line_type = parseLineType(line["type"].get<std::string>());
+                            }
+                        }
+                        answered = true;
+                    } catch (const std::exception&) {
+                    }
+                }
+
+                if (answered) {
+                    stats.queried++;
+                    Slot* slot = cache.findOrInsert(packPhoneNumber(numbers[request.index]));
+                    slot->checked = now;
+                    slot->valid = result.valid;
+                    slot->line_type = result.line_type;
+                    keep_flags[request.index] = keep(*slot, stats);
+                } else {
+                    stats.errors++;  // Fail open: an unreachable lookup never blocks a send
+                }
+                request.response.clear();
+                request.response.shrink_to_fit();
+
+                curl_multi_remove_handle(multi, msg->easy_handle);
+                curl_easy_cleanup(msg->easy_handle);
+                done++;
+                displayProgress((int)done, (int)pending.size());
+            }
+        }
+        curl_multi_cleanup(multi);
+        if (!pending.empty()) std::cout << "\r" << std::string(80, ' ') << "\r";
+        cache.sync();
+
+        size_t kept = 0;
+        for (size_t i = 0; i < numbers.size(); ++i) {
+            if (keep_flags[i]) numbers[kept++] = std::move(numbers[i]);
+        }
+        numbers.resize(kept);
+        return stats;
+    }
+};
+
+/*
+ * @brief Decodes an application/x-www-form-urlencoded value
+ * @param value Encoded string ('+' for space, %XX escapes)
+ * @return Decoded string
+ */
+std::string urlDecode(const std::string& value) {
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '+') {
+            decoded += ' ';
+        } else if (value[i] == '%' && i + 2 < value.size() &&
+                   isxdigit((unsigned char)value[i + 1]) && isxdigit((unsigned char)value[i + 2])) {
+            decoded += (char)std::stoi(value.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+        } else {
+            decoded += value[i];
+        }
+    }
+    return decoded;
+}
+
+/*
+ * @brief Parses a form-encoded body into its (decoded) parameters
+ */
+std::map<std::string, std::string> parseFormBody(const std::string& body) {
+    std::map<std::string, std::string> params;
+    std::stringstream stream(body);
+    std::string pair;
+    while (std::getline(stream, pair, '&')) {
+        size_t eq = pair.find('=');
+        if (eq == std::string::npos) continue;
+        params[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq + 1));
+    }
+    return params;
+}
+
+/*
+ * SHA-1 primitives for webhook signature verification
+ * The scalar compression function handles one message; the 4-lane variant uses
+ * GCC vector extensions (SSE2 on x86-64, NEON on ARM) to hash four independent
+ * messages at once, one 32-bit lane per message.
+ */
+namespace Sha1 {
+    typedef uint32_t Lanes __attribute__((vector_size(16)));
+    const int LANES = 4;
+
+    const uint32_t INITIAL[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    inline uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+    inline Lanes rotl(Lanes x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    inline uint32_t loadBigEndian(const uint8_t* p) {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+
+    /*
+     * @brief Runs the 80 SHA-1 rounds over one 64-byte block
+     * Written once for both uint32_t and Lanes, which support the same operators.
+     */
+    template <typename Word>
+    inline void rounds(Word state[5], Word w[16]) {
+        Word a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (int t = 0; t < 80; ++t) {
+            if (t >= 16) {
+                w[t & 15] = rotl(w[(t + 13) & 15] ^ w[(t + 8) & 15] ^ w[(t + 2) & 15] ^ w[t & 15], 1);
+            }
+            Word f;
+            uint32_t k;
+            if (t < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (t < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (t < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            Word temp = rotl(a, 5) + f + e + k + w[t & 15];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+
+    /*
+     * @brief Compresses one block into a scalar state
+     */
+    inline void compress(uint32_t state[5], const uint8_t* block) {
+        uint32_t w[16];
+        for (int i = 0; i < 16; ++i) w[i] = loadBigEndian(block + 4 * i);
+        rounds(state, w);
+    }
+
+    /*
+     * @brief Compresses one block per lane into a 4-lane state
+     */
+    inline void compress4(Lanes state[5], const uint8_t* const blocks[LANES]) {
+        Lanes w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = Lanes{loadBigEndian(blocks[0] + 4 * i), loadBigEndian(blocks[1] + 4 * i),
+                         loadBigEndian(blocks[2] + 4 * i), loadBigEndian(blocks[3] + 4 * i)};
+        }
+        rounds(state, w);
+    }
+
+    /*
+     * @brief Appends SHA-1 padding to a message buffer in place
+     * @param buffer Message bytes; grows to a multiple of 64
+     * @param prefix_bytes Bytes already hashed before this buffer (e.g. an HMAC key block)
+     */
+    inline void pad(std::string& buffer, size_t prefix_bytes) {
+        uint64_t bits = (uint64_t)(buffer.size() + prefix_bytes) * 8;
+        buffer += (char)0x80;
+        buffer.append((120 - buffer.size() % 64) % 64, '\0');
+        for (int i = 7; i >= 0; --i) buffer += (char)(bits >> (8 * i));
+    }
+
+    /*
+     * Structure to hold one hashing job for the multi-buffer scheduler
+     */
+    struct Job {
+        const uint8_t* data;    // Padded message (multiple of 64 bytes)
+        size_t blocks;          // Number of 64-byte blocks
+        uint32_t state[5];      // Starting state in, digest state out
+    };
+
+    /*
+     * @brief Hashes many independent messages, four at a time
+     * Each lane works through its own job; when a lane's job ends, the next
+     * queued job is loaded into it, so messages of different lengths keep all
+     * lanes busy. Idle lanes at the end hash a dummy block that is discarded.
+     * @param jobs Jobs to process; their states are updated in place
+     */
+    inline void hashMany(std::vector<Job>& jobs) {
+        static const uint8_t idle_block[64] = {0};
+        Lanes state[5] = {};
+        size_t lane_job[LANES];
+        size_t lane_block[LANES] = {0};
+        size_t next = 0;
+        int active = 0;
+
+        auto load = [&](int lane) {
+            if (next < jobs.size()) {
+                lane_job[lane] = next++;
+                lane_block[lane] = 0;
+                for (int k = 0; k < 5; ++k) state[k][lane] = jobs[lane_job[lane]].state[k];
+                active++;
+            } else {
+                lane_job[lane] = SIZE_MAX;
+            }
+        };
+        for (int lane = 0; lane < LANES; ++lane) load(lane);
+
+        while (active > 0) {
+            // Too few jobs left to fill the lanes: finish them on the scalar path
+            if (active == 1 && next == jobs.size()) {
+                for (int lane = 0; lane < LANES; ++lane) {
+                    if (lane_job[lane] == SIZE_MAX) continue;
+                    Job& job = jobs[lane_job[lane]];
+                    for (int k = 0; k < 5; ++k) job.state[k] = state[k][lane];
+                    for (size_t b = lane_block[lane]; b < job.blocks; ++b) compress(job.state, job.data + 64 * b);
+                }
+                return;
+            }
+
+            const uint8_t* blocks[LANES];
+            for (int lane = 0; lane < LANES; ++lane) {
+                blocks[lane] = lane_job[lane] == SIZE_MAX ? idle_block
+                                                          : jobs[lane_job[lane]].data + 64 * lane_block[lane];
+            }
+            compress4(state, blocks);
+
+            for (int lane = 0; lane < LANES; ++lane) {
+                if (lane_job[lane] == SIZE_MAX) continue;
+                Job& job = jobs[lane_job[lane]];
+                if (++lane_block[lane] < job.blocks) continue;
+                for (int k = 0; k < 5; ++k) job.state[k] = state[k][lane];
+                active--;
+                load(lane);
+            }
+        }
+    }
+}
+
+/*
+ * Signature verifier class
+ * Checks X-Twilio-Signature: base64(HMAC-SHA1(auth token, URL + sorted POST
+ * parameters)). The HMAC key schedule (the hashed ipad/opad key blocks) is
+ * computed once, per-request buffers are reused between batches, and the inner
+ * and outer hashes of a whole batch run through the multi-buffer SHA-1.
+ */
+class SignatureVerifier {
+private:
+    uint32_t inner_state[5];    // State after hashing key ^ ipad
+    uint32_t outer_state[5];    // State after hashing key ^ opad
+
+    // Buffers reused across batches so steady-state verification does not allocate
+    std::vector<std::string> messages;
+    std::vector<std::string> outer_blocks;
+    std::vector<Sha1::Job> jobs;
+    std::string scratch;
+    std::vector<std::pair<size_t, size_t>> fields;  // (offset, length) pairs in scratch
+    std::vector<size_t> order;
+
+    /*
+     * @brief Decodes a base64 signature into 20 bytes
+     * @return false if the value is not a base64-encoded SHA-1 digest
+     */
+    static bool decodeSignature(const std::string& text, uint8_t out[20]) {
+        static const std::string alphabet =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        if (text.size() != 28 || text[27] != '=') return false;
+        uint32_t bits = 0;
+        int count = 0, written = 0;
+        for (size_t i = 0; i < 27; ++i) {
+            size_t value = alphabet.find(text[i]);
+            if (value == std::string::npos) return false;
+            bits = bits << 6 | (uint32_t)value;
+            count += 6;
+            if (count >= 8) {
+                count -= 8;
+                if (written < 20) out[written++] = (uint8_t)(bits >> count);
+            }
+        }
+        return written == 20;
+    }
+
+    /*
+     * @brief Writes URL + sorted, decoded parameters into a message buffer
+     */
+    void buildMessage(const std::string& url, const std::string& body, std::string& message) {
+        message.assign(url);
+        scratch.clear();
+        fields.clear();
+
+        size_t start = 0;
+        while (start <= body.size()) {
+            size_t end = body.find('&', start);
+            if (end == std::string::npos) end = body.size();
+            size_t eq = body.find('=', start);
+            if (eq != std::string::npos && eq < end) {
+                for (size_t part = 0; part < 2; ++part) {
+                    size_t from = part == 0 ? start : eq + 1;
+                    size_t to = part == 0 ? eq : end;
+                    size_t offset = scratch.size();
+                    for (size_t i = from; i < to; ++i) {
+                        char c = body[i];
+                        if (c == '+') {
+                            c = ' ';
+                        } else if (c == '%' && i + 2 < to &&
+                                   isxdigit((unsigned char)body[i + 1]) && isxdigit((unsigned char)body[i + 2])) {
+                            char hex[3] = {body[i + 1], body[i + 2], 0};
+                            c = (char)std::strtol(hex, nullptr, 16);
+                            i += 2;
+                        }
+                        scratch += c;
+                    }
+                    fields.push_back({offset, scratch.size() - offset});
+                }
+            }
+            start = end + 1;
+        }
+
+        // Twilio sorts parameters by name before concatenating name and value
+        order.clear();
+        for (size_t f = 0; f < fields.size(); f += 2) order.push_back(f);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return scratch.compare(fields[a].first, fields[a].second,
+                                   scratch, fields[b].first, fields[b].second) < 0;
+        });
+        for (size_t f : order) {
+            message.append(scratch, fields[f].first, fields[f].second);
+            message.append(scratch, fields[f + 1].first, fields[f + 1].second);
+        }
+    }
+
+public:
+    // Constructor
+    SignatureVerifier(const std::string& auth_token) {
+        uint8_t key[64] = {0};
+        if (auth_token.size() > 64) {
+            std::string digest_input = auth_token;
+            Sha1::pad(digest_input, 0);
+            uint32_t state[5];
+            std::copy(Sha1::INITIAL, Sha1::INITIAL + 5, state);
+            for (size_t b = 0; b < digest_input.size(); b += 64) {
+                Sha1::compress(state, (const uint8_t*)digest_input.data() + b);
+            }
+            for (int i = 0; i < 20; ++i) key[i] = (uint8_t)(state[i / 4] >> (24 - 8 * (i % 4)));
+        } else {
+            std::memcpy(key, auth_token.data(), auth_token.size());
+        }
+
+        uint8_t block[64];
+        std::copy(Sha1::INITIAL, Sha1::INITIAL + 5, inner_state);
+        for (int i = 0; i < 64; ++i) block[i] = key[i] ^ 0x36;
+        Sha1::compress(inner_state, block);
+        std::copy(Sha1::INITIAL, Sha1::INITIAL + 5, outer_state);
+        for (int i = 0; i < 64; ++i) block[i] = key[i] ^ 0x5c;
+        Sha1::compress(outer_state, block);
+    }
+
+    /*
+     * @brief Verifies the signatures of a batch of form-encoded POST callbacks
+     * @param urls Full URL Twilio requested, per callback
+     * @param bodies Raw form-encoded bodies
+     * @param signatures X-Twilio-Signature header values
+     * @param valid Set to true for each callback whose signature matches
+     */
+    void verifyBatch(const std::vector<std::string>& urls, const std::vector<const std::string*>& bodies,
+                     const std::vector<const std::string*>& signatures, std::vector<bool>& valid) {
+        size_t count = urls.size();
+        if (messages.size() < count) {
+            messages.resize(count);
+            outer_blocks.resize(count);
+        }
+        jobs.resize(count);
+
+        // Inner hashes: key ^ ipad is already absorbed, so hash URL + params only
+        for (size_t i = 0; i < count; ++i) {
+            buildMessage(urls[i], *bodies[i], messages[i]);
+            Sha1::pad(messages[i], 64);
+            jobs[i].data = (const uint8_t*)messages[i].data();
+            jobs[i].blocks = messages[i].size() / 64;
+            std::copy(inner_state, inner_state + 5, jobs[i].state);
+        }
+        Sha1::hashMany(jobs);
+
+        // Outer hashes: one block each holding the 20-byte inner digest
+        for (size_t i = 0; i < count; ++i) {
+            std::string& block = outer_blocks[i];
+            block.clear();
+            for (int w = 0; w < 5; ++w) {
+                for (int byte = 3; byte >= 0; --byte) block += (char)(jobs[i].state[w] >> (8 * byte));
+            }
+            Sha1::pad(block, 64);
+            jobs[i].data = (const uint8_t*)block.data();
+            jobs[i].blocks = 1;
+            std::copy(outer_state, outer_state + 5, jobs[i].state);
+        }
+        Sha1::hashMany(jobs);
+
+        valid.assign(count, false);
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t expected[20];
+            if (!signatures[i] || !decodeSignature(*signatures[i], expected)) continue;
+            uint8_t difference = 0;  // Constant-time comparison
+            for (int b = 0; b < 20; ++b) {
+                difference |= expected[b] ^ (uint8_t)(jobs[i].state[b / 4] >> (24 - 8 * (b % 4)));
+            }
+            valid[i] = difference == 0;
+        }
+    }
+};
+
+/*
+ * Minimal HTTP/1.1 server class
+ * Serves requests on one background thread with poll(), keeping connections
+ * alive between requests. Used for local webhook receivers, not as a general
+ * purpose web server: requests must carry their body with Content-Length.
+ */
+class HttpServer {
+public:
+    /*
+     * Structure to hold a parsed request
+     */
+    struct Request {
+        std::string method;
+        std::string path;       // Path including the query string
+        std::map<std::string, std::string> headers;  // Lower-case names
+        std::string body;
+    };
+
+    /*
+     * Structure to hold a response
+     */
+    struct Response {
+        int status = 200;
+        std::string content_type = "text/plain";
+        std::string body;
+        double delay = 0;       // Seconds to hold the response (latency injection for mocks)
+        bool raw = false;       // Send the body as-is and close, without HTTP framing (fault injection)
+        bool reset = false;     // Abort the connection with a TCP reset instead of answering (fault injection)
+    };
+
+    using Handler = std::function<Response(const Request&)>;
+
+    /*
+     * Handler receiving every request that became complete in one poll round,
+     * so expensive per-request work (such as signature checks) can be batched.
+     * It must append exactly one response per request, in order.
+     */
+    using BatchHandler = std::function<void(const std::vector<Request>&, std::vector<Response>&)>;
+
+private:
+    /*
+     * Structure to hold a client connection and its buffered input
+     */
+    struct Connection {
+        int fd;
+        std::string input;
+        std::string output;
+        std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> delayed;
+        bool closing = false;   // Close once the output is written
+    };
+
+    BatchHandler handler;
+    int listen_fd = -1;
+    int bound_port = 0;
+    std::atomic<bool> running{false};
+    std::thread worker;
+
+    static const char* reason(int status) {
+        switch (status) {
+            case 200: return "OK";
+            case 201: return "Created";
+            case 204: return "No Content";
+            case 400: return "Bad Request";
+            case 403: return "Forbidden";
+            case 404: return "Not Found";
+            case 429: return "Too Many Requests";
+            case 500: return "Internal Server Error";
+            case 503: return "Service Unavailable";
+            default: return "Unknown";
+        }
+    }
+
+    /*
+     * @brief Parses every complete request buffered on a connection
+     * @param conn Connection with buffered input
+     * @param owner Index of the connection, recorded for each parsed request
+     * @param batch Requests parsed in this poll round
+     * @param owners Connection index of each request in the batch
+     * @return false if the connection must be closed
+     */
+    bool parse(Connection& conn, size_t owner, std::vector<Request>& batch, std::vector<size_t>& owners) {
+        while (true) {
+            size_t header_end = conn.input.find("\r\n\r\n");
+            if (header_end == std::string::npos) return conn.input.size() < 64 * 1024;
+
+            Request request;
+            std::istringstream head(conn.input.substr(0, header_end));
+            std::string line;
+            std::getline(head, line);
+            std::istringstream request_line(line);
+            request_line >> request.method >> request.path;
+            while (std::getline(head, line)) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                size_t colon = line.find(':');
+                if (colon == std::string::npos) continue;
+                std::string name = line.substr(0, colon);
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                size_t value_start = line.find_first_not_of(' ', colon + 1);
+                request.headers[name] = value_start == std::string::npos ? "" : line.substr(value_start);
+            }
+
+            size_t length = 0;
+            auto cl = request.headers.find("content-length");
+            if (cl != request.headers.end()) {
+                // Any peer can reach the webhook: a malformed length closes the connection, not the process
+                const std::string& value = cl->second;
+                if (value.empty() || !std::all_of(value.begin(), value.end(), ::isdigit)) {
+                    static const char bad_request[] =
+                        "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                    send(conn.fd, bad_request, sizeof(bad_request) - 1, MSG_NOSIGNAL);
+                    return false;
+                }
+                length = std::strtoul(value.c_str(), nullptr, 10);     // Saturates instead of throwing
+            }
+            if (length > 1024 * 1024) return false;
+            if (conn.input.size() < header_end + 4 + length) return true;
+            request.body = conn.input.substr(header_end + 4, length);
+            conn.input.erase(0, header_end + 4 + length);
+
+            batch.push_back(std::move(request));
+            owners.push_back(owner);
+        }
+    }
+
+    void loop() {
+        std::vector<Connection> connections;
+        std::vector<pollfd> fds;
+        std::vector<Request> batch;
+        std::vector<Response> responses;
+        std::vector<size_t> owners;
+        char buffer[16384];
+
+        while (running) {
+            fds.clear();
+            fds.push_back({listen_fd, POLLIN, 0});
+            // Wake up in time for the earliest delayed response
+            auto now = std::chrono::steady_clock::now();
+            long timeout = 100;
+            for (const auto& conn : connections) {
+                fds.push_back({conn.fd, (short)(conn.output.empty() ? POLLIN : POLLIN | POLLOUT), 0});
+                if (!conn.delayed.empty()) {
+                    long due = (long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                        conn.delayed.front().first - now).count();
+                    timeout = std::max(0L, std::min(timeout, due + 1));
+                }
+            }
+            int ready = poll(fds.data(), fds.size(), (int)timeout);
+
+            if (ready > 0 && (fds[0].revents & POLLIN)) {
+                int client;
+                while ((client = accept(listen_fd, nullptr, nullptr)) >= 0) {
+                    fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+                    connections.push_back({client, "", "", {}, false});
+                }
+            }
+
+            // Read from every ready connection, collecting complete requests
+            batch.clear();
+            owners.clear();
+            for (size_t i = 1; i < fds.size() && ready > 0; ++i) {
+                Connection& conn = connections[i - 1];
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+                if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+                    conn.input.clear();
+                    conn.output.clear();
+                    ::close(conn.fd);
+                    conn.fd = -1;
+                } else if (received > 0) {
+                    conn.input.append(buffer, received);
+                    if (!parse(conn, i - 1, batch, owners)) {
+                        ::close(conn.fd);
+                        conn.fd = -1;
+                    }
+                }
+            }
+
+            // Handle the round's requests together
+            if (!batch.empty()) {
+                responses.clear();
+                try {
+                    handler(batch, responses);
+                } catch (const std::exception&) {
+                    responses.clear();
+                }
+                responses.resize(batch.size(), {500, "text/plain", "Internal Server Error"});
+                for (size_t r = 0; r < batch.size(); ++r) {
+                    Connection& conn = connections[owners[r]];
+                    if (conn.fd < 0) continue;
+                    const Response& response = responses[r];
+                    if (response.reset) {
+                        linger abort{1, 0};
+                        setsockopt(conn.fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+                        ::close(conn.fd);
+                        conn.fd = -1;
+                        continue;
+                    }
+                    conn.closing = conn.closing || response.raw;
+                    std::string text = response.raw ? response.body : "HTTP/1.1 " + std::to_string(response.status) + " " +
+                                       reason(response.status) +
+                                       "\r\nContent-Type: " + response.content_type +
+                                       "\r\nContent-Length: " + std::to_string(response.body.size()) +
+                                       "\r\n\r\n" + response.body;
+                    if (response.delay > 0 || !conn.delayed.empty()) {
+                        auto due = now + std::chrono::microseconds((long)(response.delay * 1e6));
+                        if (!conn.delayed.empty()) due = std::max(due, conn.delayed.back().first);
+                        conn.delayed.emplace_back(due, std::move(text));
+                    } else {
+                        conn.output += text;
+                    }
+                }
+            }
+
+            // Release delayed responses that are due, keeping each connection's order
+            now = std::chrono::steady_clock::now();
+            for (auto& conn : connections) {
+                while (!conn.delayed.empty() && conn.delayed.front().first <= now) {
+                    conn.output += conn.delayed.front().second;
+                    conn.delayed.pop_front();
+                }
+            }
+
+            // Write whatever the sockets will take without blocking
+            for (auto& conn : connections) {
+                if (conn.fd < 0 || conn.output.empty()) continue;
+                ssize_t sent = send(conn.fd, conn.output.data(), conn.output.size(), MSG_NOSIGNAL);
+                if (sent > 0) {
+                    conn.output.erase(0, sent);
+                    if (conn.closing && conn.output.empty() && conn.delayed.empty()) {
+                        ::close(conn.fd);
+                        conn.fd = -1;
+                    }
+                } else if (sent < 0 && errno != EAGAIN && errno != EINTR) {
+                    ::close(conn.fd);
+                    conn.fd = -1;
+                }
+            }
+            connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                             [](const Connection& c) { return c.fd < 0; }),
+                              connections.end());
+        }
+
+        for (const auto& conn : connections) ::close(conn.fd);
+    }
+
+public:
+    // Constructor for handlers that serve one request at a time
+    HttpServer(Handler request_handler)
+        : handler([h = std::move(request_handler)](const std::vector<Request>& batch,
+                                                    std::vector<Response>& responses) {
+              for (const auto& request : batch) {
+                  try {
+                      responses.push_back(h(request));
+                  } catch (const std::exception& e) {
+                      responses.push_back({500, "text/plain", e.what()});
+                  }
+              }
+          }) {}
+
+    // Constructor for batch handlers
+    HttpServer(BatchHandler batch_handler) : handler(std::move(batch_handler)) {}
+
+    ~HttpServer() { stop(); }
+
+    /*
+     * @brief Binds the listening socket and starts serving in the background
+     * @param address IPv4 address to bind
+     * @param port TCP port (0 picks a free port)
+     * @throws std::runtime_error if the socket cannot be bound
+     */
+    void start(const std::string& address, int port) {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int yes = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1 ||
+            bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+            std::string error = std::strerror(errno);
+            ::close(listen_fd);
+            listen_fd = -1;
+            throw std::runtime_error("Error: cannot listen on " + address + ":" + std::to_string(port) +
+                                     ": " + error);
+        }
+
+        socklen_t length = sizeof(addr);
+        getsockname(listen_fd, (sockaddr*)&addr, &length);
+        bound_port = ntohs(addr.sin_port);
+        fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+        running = true;
+        worker = std::thread(&HttpServer::loop, this);
+    }
+
+    /*
+     * @brief Stops serving and closes every connection
+     */
+    void stop() {
+        if (!running) return;
+        running = false;
+        if (worker.joinable()) worker.join();
+        ::close(listen_fd);
+        listen_fd = -1;
+    }
+
+    int port() const { return bound_port; }
+};
+
+/*
+ * Concurrent packed set class
+ * Set of packed numbers that any number of threads insert into and probe at
+ * once, without locks: open addressing over atomic slots, with an empty slot
+ * claimed by compare-and-swap. When a table passes half full, a table four
+ * times its size is chained after it and new keys go there; older tables stay
+ * readable and are never copied, so growing never stops other threads, and a
+ * few tables cover any realistic list. An insert that lands in a table after a
+ * newer one appeared repeats itself in the newer table, so exactly one of
+ * several concurrent inserts of a key reports it as new. Memory is released
+ * only when the set is destroyed.
+ */
+class ConcurrentPackedSet {
+private:
+    static const int MAX_TABLES = 20;
+    static const int GROWTH_BITS = 2;       // Each table is 4x the previous one
+    static const int STRIPES = 16;
+    static const size_t PREFETCH_DISTANCE = 8;
+
+    /*
+     * Counter split over cache lines, so threads counting at once do not
+     * contend on one line
+     */
+    struct StripedCounter {
+        struct alignas(64) Stripe {
+            std::atomic<size_t> value{0};
+        };
+        Stripe stripes[STRIPES];
+
+        static size_t stripe() {
+            static std::atomic<size_t> next{0};
+            thread_local size_t mine = next.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+            return mine;
+        }
+
+        // Returns the stripe's new value
+        size_t add(size_t n) {
+            return stripes[stripe()].value.fetch_add(n, std::memory_order_relaxed) + n;
+        }
+
+        size_t sum() const {
+            size_t total = 0;
+            for (const auto& s : stripes) total += s.value.load(std::memory_order_relaxed);
+            return total;
+        }
+    };
+
+    /*
+     * Structure to hold one open-addressing table; 0 marks an empty slot
+     */
+    struct Table {
+        enum Result { INSERTED, PRESENT, FULL };
+
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+        uint64_t mask;
+        int shift;
+        size_t limit;                   // Keys before the next table takes over
+        StripedCounter count;
+        std::atomic<bool> full{false};
+
+        explicit Table(int bits)
+            : slots(new std::atomic<uint64_t>[1ULL << bits]()), mask((1ULL << bits) - 1), shift(64 - bits),
+              limit(1ULL << (bits - 1)) {}
+
+        size_t home(uint64_t key) const { return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> shift); }
+
+        void prefetch(uint64_t key) const { __builtin_prefetch(&slots[home(key)]); }
+
+        bool contains(uint64_t key) const {
+            for (size_t i = home(key), probes = 0; probes <= mask; i = (i + 1) & mask, ++probes) {
+                uint64_t seen = slots[i].load();
+                if (seen == key) return true;
+                if (seen == 0) return false;
+            }
+            return false;
+        }
+
+        Result insert(uint64_t key) {
+            for (size_t i = home(key), probes = 0; probes <= mask; i = (i + 1) & mask, ++probes) {
+                uint64_t seen = slots[i].load();
+                if (seen == key) return PRESENT;
+                if (seen != 0) continue;
+                if (full.load(std::memory_order_relaxed)) return FULL;
+                if (slots[i].compare_exchange_strong(seen, key)) {
+                    // Large tables only sum the exact total every 256 inserts of a stripe
+                    size_t stripe_count = count.add(1);
+                    if ((limit < 4096 || (stripe_count & 255) == 0) && count.sum() >= limit) {
+                        full.store(true, std::memory_order_relaxed);
+                    }
+                    return INSERTED;
+                }
+                if (seen == key) return PRESENT;
+            }
+            return FULL;
+        }
+    };
+
+    std::atomic<Table*> tables[MAX_TABLES];
+    std::atomic<int> table_count{1};
+    int first_bits;
+    StripedCounter members;
+
+    /*
+     * @brief Makes sure the table after table k exists and is published
+     */
+    void grow(int k) {
+        if (table_count.load() > k + 1) return;
+        if (k + 1 >= MAX_TABLES) throw std::runtime_error("Error: concurrent set is out of tables");
+        Table* next = new Table(first_bits + (k + 1) * GROWTH_BITS);
+        Table* expected = nullptr;
+        if (!tables[k + 1].compare_exchange_strong(expected, next)) delete next;
+        int count = k + 1;
+        table_count.compare_exchange_strong(count, k + 2);
+    }
+
+public:
+    // Constructor: bits is the log2 size of the first table
+    explicit ConcurrentPackedSet(int bits = 16) : first_bits(bits) {
+        for (auto& table : tables) table.store(nullptr);
+        tables[0].store(new Table(bits));
+    }
+
+    ~ConcurrentPackedSet() {
+        for (auto& table : tables) delete table.load();
+    }
+
+    ConcurrentPackedSet(const ConcurrentPackedSet&) = delete;
+    ConcurrentPackedSet& operator=(const ConcurrentPackedSet&) = delete;
+
+    /*
+     * @brief Checks whether a key is in the set (lock-free)
+     * The newest table is probed first: it holds most of the keys.
+     */
+    bool contains(uint64_t key) const {
+        for (int k = table_count.load() - 1; k >= 0; --k) {
+            if (tables[k].load()->contains(key)) return true;
+        }
+        return false;
+    }
+
+    /*
+     * @brief Adds a key (lock-free)
+     * @param key Packed number; 0 is never stored
+     * @return true if this call added the key, false if it was already there
+     */
+    bool insert(uint64_t key) {
+        if (key == 0) return false;
+        int n = table_count.load();
+        for (int k = 0; k < n - 1; ++k) {
+            if (tables[k].load()->contains(key)) return false;
+        }
+        for (int k = n - 1;; ++k) {
+            Table* table = tables[k].load();
+            Table::Result result = table->insert(key);
+            if (result == Table::PRESENT) return false;
+            if (result == Table::FULL) {
+                // Re-check after the switch: an insert that beat it either shows up here or moves on too
+                grow(k);
+                if (table->contains(key)) return false;
+                continue;
+            }
+            if (table_count.load() == k + 1) {
+                members.add(1);
+                return true;
+            }
+        }
+    }
+
+    /*
+     * @brief Probes many keys, prefetching the slots of later keys meanwhile
+     * @param found Set to 1 per key in the set, 0 otherwise
+     */
+    void containsBatch(const uint64_t* keys, size_t count, uint8_t* found) const {
+        int n = table_count.load();
+        for (size_t i = 0; i < count; ++i) {
+            if (i + PREFETCH_DISTANCE < count) {
+                for (int k = 0; k < n; ++k) tables[k].load()->prefetch(keys[i + PREFETCH_DISTANCE]);
+            }
+            found[i] = contains(keys[i]);
+        }
+    }
+
+    /*
+     * @brief Inserts many keys, prefetching the slots of later keys meanwhile
+     * @param inserted Set to 1 per key this call added, 0 otherwise (may be null)
+     * @return Number of keys added
+     */
+    size_t insertBatch(const uint64_t* keys, size_t count, uint8_t* inserted = nullptr) {
+        size_t added = 0;
+        int n = table_count.load();
+        for (size_t i = 0; i < count; ++i) {
+            if (i + PREFETCH_DISTANCE < count) {
+                for (int k = 0; k < n; ++k) tables[k].load()->prefetch(keys[i + PREFETCH_DISTANCE]);
+            }
+            bool added_key = insert(keys[i]);
+            if (inserted) inserted[i] = added_key;
+            added += added_key;
+            if (i % 1024 == 1023) n = table_count.load();
+        }
+        return added;
+    }
+
+    size_t size() const { return members.sum(); }
+};
+
+/*
+ * Suppression list class
+ * Owns the suppression set and the on-disk suppression file. Opt-outs become
+ * visible to the dispatcher immediately and are appended to the file by a
+ * background thread, so the webhook never waits on disk I/O.
+ */
+class SuppressionList {
+private:
+    std::string path;
+    ConcurrentPackedSet set;
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    std::deque<uint64_t> pending;   // Numbers not yet written to the file
+    bool stopping = false;
+    std::thread writer;
+
+    void writeLoop() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        while (true) {
+            queue_ready.wait(lock, [&] { return stopping || !pending.empty(); });
+            if (pending.empty() && stopping) return;
+
+            std::deque<uint64_t> batch;
+            batch.swap(pending);
+            lock.unlock();
+
+            std::ofstream file(path, std::ios::app);
+            for (uint64_t key : batch) file << unpackPhoneNumber(key) << "\n";
+            file.flush();
+            if (!file) {
+                std::cerr << Color::RED << "\nWarning: cannot append to " << path << Color::RESET << std::endl;
+            }
+
+            lock.lock();
+        }
+    }
+
+public:
+    // Constructor
+    SuppressionList(const std::string& file) : path(file) {
+        load();
+        writer = std::thread(&SuppressionList::writeLoop, this);
+    }
+
+    ~SuppressionList() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_ready.notify_one();
+        writer.join();
+    }
+
+    /*
+     * @brief Loads the suppression file; a missing file means nobody opted out yet
+     */
+    void load() {
+        if (path.empty()) return;
+        std::ifstream file(path);
+        std::string line;
+        std::vector<uint64_t> keys;
+        while (std::getline(file, line)) {
+            uint64_t key = packPhoneNumber(line);
+            if (key != 0) keys.push_back(key);
+        }
+        set.insertBatch(keys.data(), keys.size());
+    }
+
+    bool contains(uint64_t key) { return set.contains(key); }
+
+    /*
+     * @brief Suppresses a number now and persists it in the background
+     */
+    void add(uint64_t key) {
+        if (!set.insert(key)) return;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            pending.push_back(key);
+        }
+        queue_ready.notify_one();
+    }
+
+    size_t size() const { return set.size(); }
+};
+
+/*
+ * @brief Checks whether an inbound message body is an opt-out request
+ * Matches the standard carrier keywords, ignoring case and surrounding space.
+ */
+bool isOptOutKeyword(const std::string& body) {
+    static const char* keywords[] = {"STOP", "STOPALL", "UNSUBSCRIBE", "CANCEL", "END", "QUIT",
+                                     "OPTOUT", "REVOKE"};
+    size_t first = body.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return false;
+    size_t last = body.find_last_not_of(" \t\r\n.!");
+    if (last == std::string::npos || last < first) return false;
+    std::string word = body.substr(first, last - first + 1);
+    std::transform(word.begin(), word.end(), word.begin(), ::toupper);
+    for (const char* keyword : keywords) {
+        if (word == keyword) return true;
+    }
+    return false;
+}
+
+/*
+ * Inbound webhook class
+ * Receives Twilio inbound-message callbacks and suppresses senders of opt-out
+ * keywords while a campaign is running. Replies with empty TwiML so Twilio's
+ * own opt-out confirmation is still sent. When INBOUND_URL is configured, every
+ * callback must carry a valid X-Twilio-Signature; callbacks that arrive in the
+ * same poll round are verified together.
+ */
+class InboundWebhook {
+private:
+    SuppressionList& suppression;
+    std::string public_url;
+    std::unique_ptr<SignatureVerifier> verifier;
+    HttpServer server;
+    std::atomic<size_t> opt_outs{0};
+    std::atomic<size_t> rejected{0};
+
+    // Batch state reused between poll rounds
+    std::vector<std::string> urls;
+    std::vector<const std::string*> bodies;
+    std::vector<const std::string*> signatures;
+    std::vector<bool> valid;
+
+    void handle(const std::vector<HttpServer::Request>& batch, std::vector<HttpServer::Response>& responses) {
+        if (verifier) {
+            urls.resize(batch.size());
+            bodies.clear();
+            signatures.clear();
+            for (size_t i = 0; i < batch.size(); ++i) {
+                urls[i].assign(public_url).append(batch[i].path);
+                bodies.push_back(&batch[i].body);
+                auto header = batch[i].headers.find("x-twilio-signature");
+                signatures.push_back(header == batch[i].headers.end() ? nullptr : &header->second);
+            }
+            verifier->verifyBatch(urls, bodies, signatures, valid);
+        }
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            const HttpServer::Request& request = batch[i];
+            if (request.method != "POST") {
+                responses.push_back({404, "text/plain", "Not Found"});
+                continue;
+            }
+            if (verifier && !valid[i]) {
+                rejected++;
+                responses.push_back({403, "text/plain", "Invalid signature"});
+                continue;
+            }
+
+            auto params = parseFormBody(request.body);
+            if (isOptOutKeyword(params["Body"])) {
+                uint64_t key = packPhoneNumber(params["From"]);
+                if (key != 0 && !suppression.contains(key)) {
+                    suppression.add(key);
+                    opt_outs++;
+                }
+            }
+            responses.push_back({200, "text/xml", "<?xml version=\"1.0\" encoding=\"UTF-8\"?><Response></Response>"});
+        }
+    }
+
+public:
+    // Constructor
+    InboundWebhook(SuppressionList& list, const TwilioConfig& config)
+        : suppression(list), public_url(config.inbound_url),
+          server(HttpServer::BatchHandler([this](const std::vector<HttpServer::Request>& batch,
+                                                 std::vector<HttpServer::Response>& responses) {
+              handle(batch, responses);
+          })) {
+        if (!public_url.empty()) verifier.reset(new SignatureVerifier(config.auth_token));
+    }
+
+    void start(const std::string& address, int port) { server.start(address, port); }
+    bool verifying() const { return verifier != nullptr; }
+    size_t optOuts() const { return opt_outs.load(); }
+    size_t rejectedCallbacks() const { return rejected.load(); }
+    int port() const { return server.port(); }
+};
+
+bool hasAssignedCountryCode(const std::string& digits);  // Defined with the number checks
+
+/*
+ * Packed list class
+ * Sorted, duplicate-free array of packed numbers. Compiled lists are stored as
+ * an 8-byte magic, a 64-bit count and the raw array, and are memory-mapped on
+ * open. Any other file is read as text with one number per line, ignoring
+ * punctuation and anything after the first separated word (so sent journals
+ * work as input too), and sorted in memory. Lines the sender would reject are
+ * dropped.
+ */
+class PackedList {
+private:
+    static constexpr char MAGIC[8] = {'S', 'M', 'S', 'L', 'I', 'S', 'T', '1'};
+
+    std::vector<uint64_t> owned;
+    const uint64_t* values = nullptr;
+    size_t count = 0;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    /*
+     * @brief Parses the first number of every line of a text buffer
+     * Numbers must pass the same checks as checkPhoneNumber: 9-14 digits, no
+     * leading zero, an assigned country code and no letters between digits.
+     * A letter after a separator ends the number instead, since journal lines
+     * carry a SID and a timestamp after it.
+     */
+    static void parseText(const char* text, size_t size, std::vector<uint64_t>& out) {
+        uint64_t packed = 0;
+        int digits = 0;
+        char head[3];           // First digits, for the country code
+        bool in_first_field = true;
+        bool corrupt = false;   // A letter between digits
+        bool glued = false;     // A letter right after a digit, in the same token
+        for (size_t i = 0; i <= size; ++i) {
+            char c = i < size ? text[i] : '\n';
+            if (c == '\n') {
+                if (!corrupt && digits >= 9 && digits <= 14 &&
+                    hasAssignedCountryCode(std::string(head, std::min(digits, 3)))) {
+                    out.push_back(packed);
+                }
+                packed = 0;
+                digits = 0;
+                in_first_field = true;
+                corrupt = glued = false;
+            } else if (!in_first_field) {
+                if (c >= '0' && c <= '9') corrupt = corrupt || glued;
+                else if (!isalpha((unsigned char)c)) glued = false;  // Token ended: the letters were text
+            } else if (c >= '0' && c <= '9') {
+                if (digits == 0 && c == '0') digits = 99;  // Leading zero: invalid
+                if (digits < 3) head[digits] = c;
+                packed = packed * 10 + (uint64_t)(c - '0');
+                digits++;
+            } else if (isalpha((unsigned char)c) && digits > 0) {
+                in_first_field = false;  // Journal SID or other trailing text
+                glued = isdigit((unsigned char)text[i - 1]);
+            }
+        }
+    }
+
+public:
+    // Constructor: opens a compiled list or compiles a text file
+    PackedList(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Error: cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat info{};
+        fstat(fd, &info);
+        mapping_size = info.st_size;
+        if (mapping_size > 0) {
+            mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            throw std::runtime_error("Error: cannot map " + path + ": " + std::strerror(errno));
+        }
+
+        const char* bytes = (const char*)mapping;
+        if (mapping_size >= 16 && std::memcmp(bytes, MAGIC, 8) == 0) {
+            std::memcpy(&count, bytes + 8, sizeof(uint64_t));
+            // Divided, not multiplied: a corrupt count must not wrap past the check
+            if (count > (mapping_size - 16) / sizeof(uint64_t)) {
+                munmap(mapping, mapping_size);  // The destructor does not run for a throwing constructor
+                mapping = nullptr;
+                throw std::runtime_error("Error: " + path + " is truncated");
+            }
+            values = (const uint64_t*)(bytes + 16);
+            madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+            return;
+        }
+
+        parseText(bytes, mapping_size, owned);
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        RadixSort::sort(owned.data(), owned.size());
+        owned.erase(std::unique(owned.begin(), owned.end()), owned.end());
+        values = owned.data();
+        count = owned.size();
+    }
+
+    // Constructor: takes ownership of already sorted, duplicate-free values
+    PackedList(std::vector<uint64_t>&& sorted) : owned(std::move(sorted)) {
+        values = owned.data();
+        count = owned.size();
+    }
+
+    ~PackedList() {
+        if (mapping) munmap(mapping, mapping_size);
+    }
+
+    PackedList(const PackedList&) = delete;
+    PackedList& operator=(const PackedList&) = delete;
+
+    const uint64_t* data() const { return values; }
+    size_t size() const { return count; }
+
+    /*
+     * @brief Writes values as a compiled list, replacing the file atomically
+     * @throws std::runtime_error if the file cannot be written
+     */
+    static void write(const std::string& path, const uint64_t* data, size_t size) {
+        std::string tmp = path + ".tmp";
+        FILE* file = std::fopen(tmp.c_str(), "wb");
+        uint64_t size64 = size;
+        bool ok = file && std::fwrite(MAGIC, 1, 8, file) == 8 &&
+                  std::fwrite(&size64, sizeof(size64), 1, file) == 1 &&
+                  std::fwrite(data, sizeof(uint64_t), size, file) == size;
+        if (file && std::fclose(file) != 0) ok = false;
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Error: cannot write " + path + ": " + std::strerror(errno));
+        }
+    }
+};
+
+/*
+ * Linear merges over sorted, duplicate-free packed lists
+ * Each step compares a block of four values against the head of the other
+ * list with one vector comparison; the count of smaller values tells how many
+ * elements can be copied or skipped at once, so long runs from one side cost
+ * a fraction of a branch per element. Outputs are sorted and duplicate-free.
+ */
+namespace ListMerge {
+    typedef uint64_t Block __attribute__((vector_size(32)));
+
+    /*
+     * @brief Counts how many of p[0..3] are smaller than x (p is sorted)
+     */
+    inline size_t countLess4(const uint64_t* p, uint64_t x) {
+        Block block;
+        std::memcpy(&block, p, sizeof(block));
+        Block less = block < (Block){x, x, x, x};   // All ones where smaller
+        return (size_t)-(int64_t)(less[0] + less[1] + less[2] + less[3]);
+    }
+
+    /*
+     * @brief Advances i past the elements of a[] smaller than x, four at a time
+     * @param emit Output to copy skipped elements to (nullptr to discard them)
+     * @return Number of elements emitted
+     */
+    inline size_t skipLess(const uint64_t* a, size_t na, size_t& i, uint64_t x, uint64_t* emit) {
+        size_t emitted = 0;
+        while (i + 4 <= na) {
+            size_t k = countLess4(a + i, x);
+            if (emit) std::memcpy(emit + emitted, a + i, k * sizeof(uint64_t));
+            emitted += emit ? k : 0;
+            i += k;
+            if (k < 4) return emitted;
+        }
+        while (i < na && a[i] < x) {
+            if (emit) emit[emitted++] = a[i];
+            i++;
+        }
+        return emitted;
+    }
+
+    /*
+     * @brief A ∪ B; out must hold na + nb values
+     */
+    inline size_t unite(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out) {
+        size_t i = 0, j = 0, n = 0;
+        while (i < na && j < nb) {
+            n += skipLess(a, na, i, b[j], out + n);
+            if (i == na) break;
+            n += skipLess(b, nb, j, a[i], out + n);
+            if (j == nb) break;
+            if (a[i] == b[j]) {
+                out[n++] = a[i++];
+                j++;
+            }
+        }
+        std::memcpy(out + n, a + i, (na - i) * sizeof(uint64_t));
+        n += na - i;
+        std::memcpy(out + n, b + j, (nb - j) * sizeof(uint64_t));
+        return n + nb - j;
+    }
+
+    /*
+     * @brief A ∩ B; out must hold min(na, nb) values
+     */
+    inline size_t intersect(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out) {
+        size_t i = 0, j = 0, n = 0;
+        while (i < na && j < nb) {
+            skipLess(a, na, i, b[j], nullptr);
+            if (i == na) break;
+            skipLess(b, nb, j, a[i], nullptr);
+            if (j == nb) break;
+            if (a[i] == b[j]) {
+                out[n++] = a[i++];
+                j++;
+            }
+        }
+        return n;
+    }
+
+    /*
+     * @brief A \ B; out must hold na values
+     */
+    inline size_t subtract(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out) {
+        size_t i = 0, j = 0, n = 0;
+        while (i < na && j < nb) {
+            n += skipLess(a, na, i, b[j], out + n);
+            if (i == na) break;
+            skipLess(b, nb, j, a[i], nullptr);
+            if (j == nb) break;
+            if (a[i] == b[j]) {
+                i++;
+                j++;
+            }
+        }
+        std::memcpy(out + n, a + i, (na - i) * sizeof(uint64_t));
+        return n + na - i;
+    }
+}
+
+/*
+ * @brief Removes every recipient contained in a packed list, keeping list order
+ * Recipients are sorted by packed number and merged linearly against the list.
+ * @param numbers Normalized recipient numbers, filtered in place
+ * @param list Sorted packed list of numbers to remove
+ * @return Number of recipients removed
+ */
+size_t removeListed(std::vector<std::string>& numbers, const PackedList& list) {
+    std::vector<uint64_t> sorted(numbers.size());
+    std::vector<uint32_t> index(numbers.size());
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        sorted[i] = packPhoneNumber(numbers[i]);
+        index[i] = (uint32_t)i;
+    }
+    RadixSort::sort(sorted.data(), index.data(), sorted.size());
+
+    std::vector<uint8_t> listed(numbers.size(), 0);
+    const uint64_t* values = list.data();
+    size_t j = 0;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        ListMerge::skipLess(values, list.size(), j, sorted[i], nullptr);
+        if (j == list.size()) break;
+        listed[index[i]] = values[j] == sorted[i];
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        if (!listed[i]) numbers[kept++] = std::move(numbers[i]);
+    }
+    size_t removed = numbers.size() - kept;
+    numbers.resize(kept);
+    return removed;
+}
+
+/*
+ * @brief Runs the "list" subcommands over compiled packed-number lists
+ * @param args Arguments after "list"
+ * @return Process exit code
+ */
+int runListCommand(const std::vector<std::string>& args) {
+    auto usage = [] {
+        std::cerr << "Usage:\n"
+                  << "  sms_sender list compile <numbers.txt> <out.lst>\n"
+                  << "  sms_sender list union|intersect|subtract <a> <b> <out.lst>\n"
+                  << "  sms_sender list export <list> [out.txt]\n"
+                  << "Inputs may be compiled lists, text lists or sent journals.\n";
+        return 2;
+    };
+    if (args.empty()) return usage();
+
+    const std::string& command = args[0];
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&] {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    };
+
+    if (command == "compile" && args.size() == 3) {
+        PackedList list(args[1]);
+        PackedList::write(args[2], list.data(), list.size());
+        std::cout << Color::GREEN << "✓ " << Color::RESET << "Compiled " << list.size()
+                  << " unique numbers into " << args[2] << " (" << elapsed() << " ms)\n";
+        return 0;
+    }
+
+    if (command == "export" && (args.size() == 2 || args.size() == 3)) {
+        PackedList list(args[1]);
+        std::ofstream file;
+        if (args.size() == 3) file.open(args[2], std::ios::trunc);
+        std::ostream& out = args.size() == 3 ? file : std::cout;
+        char line[24];
+        for (size_t i = 0; i < list.size(); ++i) {
+            int length = std::snprintf(line, sizeof(line), "+%llu\n", (unsigned long long)list.data()[i]);
+            out.write(line, length);
+        }
+        return out ? 0 : 1;
+    }
+
+    if ((command == "union" || command == "intersect" || command == "subtract") && args.size() == 4) {
+        PackedList a(args[1]);
+        PackedList b(args[2]);
+        std::vector<uint64_t> result(command == "union" ? a.size() + b.size() : a.size());
+        size_t n;
+        if (command == "union") {
+            n = ListMerge::unite(a.data(), a.size(), b.data(), b.size(), result.data());
+        } else if (command == "intersect") {
+            n = ListMerge::intersect(a.data(), a.size(), b.data(), b.size(), result.data());
+        } else {
+            n = ListMerge::subtract(a.data(), a.size(), b.data(), b.size(), result.data());
+        }
+        PackedList::write(args[3], result.data(), n);
+        std::cout << Color::GREEN << "✓ " << Color::RESET << command << ": " << a.size() << " and "
+                  << b.size() << " numbers -> " << n << " written to " << args[3]
+                  << " (" << elapsed() << " ms)\n";
+        return 0;
+    }
+
+    return usage();
+}
+
+/*
+ * Structure to hold SMS sending result
+ */
+struct SendResult {
+    bool success;           // Indicates if send was successful
+    std::string message;    // Result message or error description
+    std::string sid;        // Twilio message SID
+    long http_status = 0;   // HTTP status of the response (0 if none arrived)
+    int error_code = 0;     // Twilio error code, if the API returned one
+    int curl_code = 0;      // libcurl error, if the request did not complete
+    bool ambiguous = false; // The API may have accepted the message (reset, timeout, unreadable reply)
+};
+
+/*
+ * Transport interface
+ * Delivers one message to the messaging API. The dispatcher only talks to this
+ * interface, so the real Twilio client and simulated or recorded transports
+ * are interchangeable.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    /*
+     * @brief Sends one message
+     * @param from Sender number
+     * @param to Recipient number
+     * @param body Message content
+     * @return SendResult structure containing the result
+     */
+    virtual SendResult send(const std::string& from, const std::string& to, const std::string& body) = 0;
+
+    /*
+     * @brief Checks whether a send with an ambiguous outcome reached the API
+     * @param from Sender number
+     * @param to Recipient number
+     * @param body Message content
+     * @param since Time of the first attempt (seconds since epoch)
+     * @param sid Filled in with the accepted message's SID
+     * @return 1 if the message was accepted, 0 if it was not, -1 if that cannot be told
+     */
+    virtual int reconcile(const std::string& from, const std::string& to, const std::string& body,
+                          double since, std::string& sid) {
+        (void)from; (void)to; (void)body; (void)since; (void)sid;
+        return -1;
+    }
+};
+
+/*
+ * Reasons a line of the numbers file is rejected
+ */
+enum class NumberRejection {
+    NONE,           // Valid number
+    NON_NUMERIC,    // No digits, or letters inside the number
+    LEADING_ZERO,   // Starts with 0 (a national trunk prefix, not a country code)
+    TOO_SHORT,      // Fewer than 9 digits
+    TOO_LONG,       // More than 14 digits
+    BAD_COUNTRY,    // Starts with an unassigned country code
+    REJECTION_COUNT
+};
+
+/*
+ * @brief Returns a short display name for a rejection reason
+ */
+const char* rejectionName(NumberRejection reason) {
+    switch (reason) {
+        case NumberRejection::NONE: return "valid";
+        case NumberRejection::NON_NUMERIC: return "non-numeric";
+        case NumberRejection::LEADING_ZERO: return "leading zero";
+        case NumberRejection::TOO_SHORT: return "too short";
+        case NumberRejection::TOO_LONG: return "too long";
+        case NumberRejection::BAD_COUNTRY: return "bad country code";
+        default: return "unknown";
+    }
+}
+
+/*
+ * @brief Finds the E.164 country code that digits start with
+ * Codes are matched by length: 1 and 7 are the only 1-digit codes, then the
+ * 2-digit table, then the 3-digit one (ITU-T E.164 assignments).
+ * @param digits Number without the leading '+'
+ * @return Country code, or 0 if the digits start with no assigned code
+ */
+int countryCode(const std::string& digits) {
+    static const std::vector<bool> assigned = [] {
+        std::vector<bool> table(1000, false);
+        const int two[] = {20, 27, 30, 31, 32, 33, 34, 36, 39, 40, 41, 43, 44, 45, 46, 47, 48, 49, 51, 52, 53,
+                           54, 55, 56, 57, 58, 60, 61, 62, 63, 64, 65, 66, 81, 82, 84, 86, 90, 91, 92, 93, 94,
+                           95, 98};
+        const int ranges[][2] = {{211, 213}, {216, 216}, {218, 218}, {220, 258}, {260, 269}, {290, 291},
+                                 {297, 299}, {350, 359}, {370, 383}, {385, 387}, {389, 389}, {420, 421},
+                                 {423, 423}, {500, 509}, {590, 599}, {670, 670}, {672, 683}, {685, 692},
+                                 {800, 800}, {808, 808}, {850, 850}, {852, 853}, {855, 856}, {870, 870},
+                                 {878, 878}, {880, 883}, {886, 886}, {888, 888}, {960, 968}, {970, 979},
+                                 {991, 996}, {998, 998}};
+        for (int code : two) table[code] = true;
+        for (const auto& range : ranges) {
+            for (int code = range[0]; code <= range[1]; ++code) table[code] = true;
+        }
+        return table;
+    }();
+    if (digits.empty()) return 0;
+    if (digits[0] == '1' || digits[0] == '7') return digits[0] - '0';
+    if (digits.size() < 3 || !std::all_of(digits.begin(), digits.begin() + 3, ::isdigit)) return 0;
+    int two = (digits[0] - '0') * 10 + (digits[1] - '0');
+    int three = two * 10 + (digits[2] - '0');
+    return assigned[two] ? two : assigned[three] ? three : 0;
+}
+
+/*
+ * @brief Tells whether digits start with an assigned E.164 country code
+ */
+bool hasAssignedCountryCode(const std::string& digits) {
+    return countryCode(digits) != 0;
+}
+
+/*
+ * @brief Normalizes a phone number to '+' followed by its digits
+ * @param number Phone number as entered
+ * @return Normalized number, or "" if it has no digits
+ */
+std::string normalizePhoneNumber(const std::string& number) {
+    std::string cleaned;
+    for (char c : number) {
+        if (isdigit((unsigned char)c)) cleaned += c;
+    }
+    return cleaned.empty() ? "" : "+" + cleaned;
+}
+
+/*
+ * @brief Checks one line of the numbers file
+ * Text around the number (such as "tel:" or a trailing name column) is ignored,
+ * but letters between digits mean the number itself is corrupt.
+ * @param line Raw line
+ * @param normalized The line's digits with a leading '+'
+ * @return Rejection reason, or NumberRejection::NONE if the number is valid
+ */
+NumberRejection checkPhoneNumber(const std::string& line, const std::string& normalized) {
+    size_t first = line.find_first_of("0123456789");
+    if (first == std::string::npos || normalized.size() < 2) return NumberRejection::NON_NUMERIC;
+    size_t last = line.find_last_of("0123456789");
+    for (size_t i = first; i < last; ++i) {
+        if (std::isalpha((unsigned char)line[i])) return NumberRejection::NON_NUMERIC;
+    }
+    if (normalized[1] == '0') return NumberRejection::LEADING_ZERO;
+    if (normalized.length() < 10) return NumberRejection::TOO_SHORT;
+    if (normalized.length() > 15) return NumberRejection::TOO_LONG;
+    if (!hasAssignedCountryCode(normalized.substr(1, 3))) return NumberRejection::BAD_COUNTRY;
+    return NumberRejection::NONE;
+}
+
+/*
+ * Reject report class
+ * Summary of rejected lines in constant memory, however large the input:
+ * counts per reason, a line-range histogram of 32 buckets whose width doubles
+ * (merging neighbours) whenever the file outgrows it, a uniform reservoir
+ * sample of example lines, and an optional rejects file streamed to disk.
+ */
+class RejectReport {
+public:
+    /*
+     * Structure to hold one sampled rejected line
+     */
+    struct Example {
+        long line;
+        NumberRejection reason;
+        std::string input;      // Truncated to 64 characters
+    };
+
+private:
+    static const size_t BUCKETS = 32;
+    static const size_t SAMPLES = 10;
+    static const int REASONS = (int)NumberRejection::REJECTION_COUNT;
+
+    long total = 0;
+    long by_reason[REASONS] = {0};
+    long bucket_width = 1024;   // Lines per histogram bucket
+    long buckets[BUCKETS][REASONS] = {{0}};
+    std::vector<Example> sample;
+    std::mt19937_64 random{0x5eed};
+    std::ofstream rejects;
+
+    void widen() {
+        for (size_t b = 0; b < BUCKETS / 2; ++b) {
+            for (int r = 0; r < REASONS; ++r) buckets[b][r] = buckets[2 * b][r] + buckets[2 * b + 1][r];
+        }
+        for (size_t b = BUCKETS / 2; b < BUCKETS; ++b) {
+            for (int r = 0; r < REASONS; ++r) buckets[b][r] = 0;
+        }
+        bucket_width *= 2;
+    }
+
+public:
+    // Constructor: an empty path means no rejects file
+    RejectReport(const std::string& rejects_path = "") {
+        if (!rejects_path.empty()) {
+            rejects.open(rejects_path, std::ios::trunc);
+            if (!rejects.is_open()) throw std::runtime_error("Error: cannot create rejects file " + rejects_path);
+            rejects << "line\treason\tinput\n";
+        }
+    }
+
+    /*
+     * @brief Records a rejected line
+     * @param line_number 1-based line number
+     * @param reason Rejection reason
+     * @param input The rejected text
+     */
+    void add(long line_number, NumberRejection reason, const std::string& input) {
+        total++;
+        by_reason[(int)reason]++;
+        while (line_number > bucket_width * (long)BUCKETS) widen();
+        buckets[(line_number - 1) / bucket_width][(int)reason]++;
+
+        // Algorithm R: every rejected line ends up in the sample with equal probability
+        if (sample.size() < SAMPLES) {
+            sample.push_back({line_number, reason, input.substr(0, 64)});
+        } else {
+            uint64_t slot = random() % (uint64_t)total;
+            if (slot < SAMPLES) sample[slot] = {line_number, reason, input.substr(0, 64)};
+        }
+
+        if (rejects.is_open()) rejects << line_number << '\t' << rejectionName(reason) << '\t' << input << '\n';
+    }
+
+    long count() const { return total; }
+    long count(NumberRejection reason) const { return by_reason[(int)reason]; }
+
+    /*
+     * @brief Prints the per-reason counts, the busiest line ranges and the examples
+     */
+    void print() const {
+        if (total == 0) return;
+        std::cout << Color::YELLOW << "\nWarning: Found " << total << " invalid numbers!\n" << Color::RESET;
+        for (int r = 1; r < REASONS; ++r) {
+            if (by_reason[r] > 0) {
+                std::cout << "  " << std::left << std::setw(18) << rejectionName((NumberRejection)r) << std::right
+                          << by_reason[r] << "\n";
+            }
+        }
+
+        // Line ranges holding rejects, most affected first
+        std::vector<std::pair<long, size_t>> ranges;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            long sum = 0;
+            for (int r = 0; r < REASONS; ++r) sum += buckets[b][r];
+            if (sum > 0) ranges.push_back({sum, b});
+        }
+        std::sort(ranges.begin(), ranges.end(), [](const std::pair<long, size_t>& a,
+                                                   const std::pair<long, size_t>& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+        std::cout << "Lines with the most rejects:\n";
+        for (size_t i = 0; i < ranges.size() && i < 5; ++i) {
+            size_t b = ranges[i].second;
+            int top = 1;
+            for (int r = 1; r < REASONS; ++r) {
+                if (buckets[b][r] > buckets[b][top]) top = r;
+            }
+            std::cout << "  " << b * bucket_width + 1 << "-" << (b + 1) * bucket_width << ": " << ranges[i].first
+                      << " (mostly " << rejectionName((NumberRejection)top) << ")\n";
+        }
+
+        std::vector<Example> examples = sample;
+        std::sort(examples.begin(), examples.end(), [](const Example& a, const Example& b) { return a.line < b.line; });
+        std::cout << "Examples:\n";
+        for (const auto& example : examples) {
+            std::cout << "  line " << example.line << ": " << example.input << " ("
+                      << rejectionName(example.reason) << ")\n";
+        }
+    }
+};
+
+/*
+ * Main SMS Sender class
+ * Handles all SMS sending operations and phone number management
+ */
+class SMSSender : public Transport {
+private:
+    TwilioConfig config;
+    std::string api_base;       // Base URL of the API edge in use
+    CURL* curl = nullptr;       // Reused across requests so the connection stays warm
+    curl_slist* post_headers = nullptr;
+    double wire_delay = 0;      // Seconds from the last send's start until its request was on the wire
+    bool reused = false;        // Whether the last send found its connection already open
+
+    /*
+     * Structure to hold a request body being uploaded
+     */
+    struct Upload {
+        const std::string* data;
+        size_t offset = 0;
+    };
+    
     /*
      * @brief Callback function for CURL to write received data
      * @return Size of processed data
      */
-    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-        ((std::string*)userp)->append((char*)contents, size * nmemb);
-        return size * nmemb;
+    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+        ((std::string*)userp)->append((char*)contents, size * nmemb);
+        return size * nmemb;
+    }
+
+    /*
+     * @brief Callback function for CURL to read the request body
+     * @return Number of bytes copied into buffer
+     */
+    static size_t ReadCallback(char* buffer, size_t size, size_t nitems, void* userp) {
+        Upload* upload = (Upload*)userp;
+        size_t n = std::min(size * nitems, upload->data->size() - upload->offset);
+        std::memcpy(buffer, upload->data->data() + upload->offset, n);
+        upload->offset += n;
+        return n;
+    }
+
+    /*
+     * @brief Callback function for CURL to rewind the request body
+     * libcurl silently resends a request whose reused connection died before
+     * any reply. For a POST that may already have been accepted, that resend
+     * could deliver the message twice, so rewinding is refused once part of the
+     * body went out: the send fails with CURLE_SEND_FAIL_REWIND and is treated
+     * as ambiguous instead.
+     */
+    static int SeekCallback(void* userp, curl_off_t offset, int origin) {
+        Upload* upload = (Upload*)userp;
+        if (offset != 0 || origin != SEEK_SET || upload->offset != 0) return CURL_SEEKFUNC_CANTSEEK;
+        return CURL_SEEKFUNC_OK;
+    }
+
+    /*
+     * @brief Normalizes phone numbers to a standard format
+     * @param number Phone number to normalize
+     * @return Normalized phone number string
+     */
+    std::string normalizePhoneNumber(const std::string& number) {
+        return ::normalizePhoneNumber(number);
+    }
+
+    /*
+     * @brief Validates phone number format
+     * @param number Phone number to validate
+     * @return bool indicating if number is valid
+     */
+    bool validatePhoneNumber(const std::string& number) {
+        return checkPhoneNumber(number, normalizePhoneNumber(number)) == NumberRejection::NONE;
+    }
+
+    /*
+     * @brief URL encodes a string for HTTP transmission
+     * @param value String to encode
+     * @return URL encoded string
+     */
+    std::string urlEncode(const std::string& value) {
+        std::ostringstream escaped;
+        escaped.fill('0');
+        escaped << std::hex;
+
+        for (char c : value) {
+            if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+                escaped << c;
+            } else {
+                escaped << '%' << std::setw(2) << int((unsigned char)c);
+            }
+        }
+
+        return escaped.str();
+    }
+
+    /*
+     * @brief Formats phone number for display
+     * @param number Phone number to format
+     * @return Formatted phone number string
+     */
+    std::string formatPhoneNumber(const std::string& number) {
+        if (number.length() >= 12) {
+            return number.substr(0, 3) + " " + number.substr(3, 2) + " " + 
+                   number.substr(5, 4) + " " + number.substr(9);
+        }
+        return number;
+    }
+
+public:
+    // Constructor
+    SMSSender(const TwilioConfig& cfg) : config(cfg), api_base(cfg.api_base_url), curl(curl_easy_init()) {
+        post_headers = curl_slist_append(nullptr, "Expect:");   // Streamed bodies must not wait for 100-continue
+    }
+
+    ~SMSSender() {
+        if (curl) curl_easy_cleanup(curl);
+        curl_slist_free_all(post_headers);
+    }
+
+    SMSSender(const SMSSender&) = delete;
+    SMSSender& operator=(const SMSSender&) = delete;
+
+    /*
+     * @brief Switches the API edge used for subsequent requests
+     * @param base Base URL such as https://api.frankfurt.us1.twilio.com
+     */
+    void setApiBase(const std::string& base) { api_base = base; }
+
+    double lastWireDelay() const { return wire_delay; }
+    bool lastReused() const { return reused; }
+
+    /*
+     * @brief Opens (or refreshes) the connection to the API ahead of the next send
+     * Fetches the account resource, which completes DNS, TCP and TLS setup so
+     * the next message goes out on a connection that is already open.
+     * @return true if the API answered
+     */
+    bool warm() {
+        if (!curl) return false;
+        curl_easy_reset(curl);
+        std::string readBuffer;
+        std::string url = api_base + "/2010-04-01/Accounts/" + config.account_sid + ".json";
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_USERNAME, config.account_sid.c_str());
+        curl_easy_setopt(curl, CURLOPT_PASSWORD, config.auth_token.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)config.http_timeout_seconds);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        return curl_easy_perform(curl) == CURLE_OK;
+    }
+
+    using SendResult = ::SendResult;
+
+    /*
+     * @brief Loads phone numbers from file
+     * @return Vector of validated phone numbers
+     * @throws std::runtime_error if numbers file is missing
+     */
+    std::vector<std::string> loadPhoneNumbers() {
+        std::vector<std::string> numbers;
+        RejectReport rejects(config.rejects_file);
+        std::ifstream file("numbers.txt");
+        std::string line;
+
+        if (!file.is_open()) {
+            throw std::runtime_error(
+                Color::RED + "Error: numbers.txt not found!\n" + Color::RESET +
+                "Please create numbers.txt with one phone number per line.\n"
+                "Format: [country_code][number] (Example: 5511999999999)"
+            );
+        }
+
+        std::cout << Color::CYAN << "\nReading phone numbers from numbers.txt...\n" << Color::RESET;
+        int line_number = 0;
+        
+        auto readLine = [&] {
+            StageProfiler::Scope load(profiler(), StageProfiler::LOAD);
+            if (!std::getline(file, line)) return false;
+            line.erase(remove_if(line.begin(), line.end(), isspace), line.end());
+            return true;
+        };
+
+        // Process each line in the file
+        while (readLine()) {
+            line_number++;
+            
+            if (!line.empty()) {
+                std::string normalizedNumber;
+                NumberRejection rejection;
+                {
+                    StageProfiler::Scope normalize(profiler(), StageProfiler::NORMALIZE);
+                    normalizedNumber = normalizePhoneNumber(line);
+                }
+                {
+                    StageProfiler::Scope validate(profiler(), StageProfiler::VALIDATE);
+                    rejection = checkPhoneNumber(line, normalizedNumber);
+                }
+                if (rejection == NumberRejection::NONE) {
+                    numbers.push_back(normalizedNumber);
+                    if (config.log_valid_numbers) {
+                        logger().info("number_valid", {{"number", normalizedNumber}},
+                                      Color::GREEN + "✓ " + Color::RESET + "Valid number: " +
+                                      formatPhoneNumber(normalizedNumber));
+                    }
+                } else {
+                    // Per-line detail only at debug level; the summary below covers the rest
+                    rejects.add(line_number, rejection, line);
+                    if (logger().enabled(Logger::Level::DEBUG)) {
+                        logger().debug("number_invalid", {{"line", std::to_string(line_number)},
+                                                          {"reason", rejectionName(rejection)}, {"input", line}},
+                                       Color::RED + "✗ " + Color::RESET + "Invalid number on line " +
+                                       std::to_string(line_number) + ": " + line + " (" +
+                                       rejectionName(rejection) + ")");
+                    }
+                }
+            }
+        }
+
+        logger().flush();
+
+        // Report invalid numbers if any
+        if (rejects.count() > 0) {
+            rejects.print();
+            if (!config.rejects_file.empty()) {
+                std::cout << "All rejected lines written to " << config.rejects_file << "\n";
+            }
+            std::cout << "Numbers should include country code (e.g., +5511999999999)\n\n";
+        }
+
+        return numbers;
+    }
+
+    /*
+     * @brief Sends an SMS message using Twilio API
+     * @param recipient Recipient phone number
+     * @param message Message content
+     * @param from Sender number (defaults to the configured phone number)
+     * @return SendResult structure containing the result
+     */
+    SendResult sendSMS(const std::string& recipient, const std::string& message,
+                       const std::string& from = "") {
+        SendResult result{false, "", "", 0, 0};
+
+        if (curl) {
+            // Clears the options of the previous request but keeps its connection open
+            curl_easy_reset(curl);
+            std::string readBuffer;
+            std::string url;
+            std::string postData;
+            {
+                StageProfiler::Scope encode(profiler(), StageProfiler::ENCODE);
+                url = api_base + "/2010-04-01/Accounts/" + config.account_sid + "/Messages.json";
+
+                // Prepare POST data
+                postData = "From=" + urlEncode(from.empty() ? config.phone_number : from) +
+                           "&To=" + urlEncode(recipient) +
+                           "&Body=" + urlEncode(message);
+            }
+
+            // Configure CURL options
+            Upload upload{&postData};
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_POST, 1L);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)postData.size());
+            curl_easy_setopt(curl, CURLOPT_READFUNCTION, ReadCallback);
+            curl_easy_setopt(curl, CURLOPT_READDATA, &upload);
+            curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, SeekCallback);
+            curl_easy_setopt(curl, CURLOPT_SEEKDATA, &upload);
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, post_headers);
+            curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+            curl_easy_setopt(curl, CURLOPT_USERNAME, config.account_sid.c_str());
+            curl_easy_setopt(curl, CURLOPT_PASSWORD, config.auth_token.c_str());
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+            curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)config.http_timeout_seconds);
+            curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+            // Perform the request
+            CURLcode res;
+            {
+                StageProfiler::Scope submit(profiler(), StageProfiler::SUBMIT);
+                res = curl_easy_perform(curl);
+            }
+            curl_off_t pretransfer_us = 0;
+            long connects = 0;
+            curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer_us);
+            curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+            wire_delay = pretransfer_us / 1e6;
+            reused = connects == 0;
+
+            if (res == CURLE_OK) {
+                StageProfiler::Scope parse(profiler(), StageProfiler::PARSE);
+                long status = 0;
+                curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+                result.http_status = (int)status;
+                try {
+                    json response = json::parse(readBuffer);
+                    if (response.contains("sid")) {
+                        result.success = true;
+                        result.sid = response["sid"].get<std::string>();
+                        result.message = "Message sent successfully";
+                    } else if (response.contains("code") && response["code"].is_number()) {
+                        result.error_code = response["code"].get<int>();
+                        result.message = "Twilio Error " + std::to_string(result.error_code) + ": " +
+                                         response.value("message", std::string("unknown error"));
+                    } else if (response.contains("error_message")) {
+                        result.message = "Twilio Error: " + response["error_message"].get<std::string>();
+                    } else {
+                        result.message = "Unknown response: " + readBuffer;
+                    }
+                } catch (const std::exception& e) {
+                    result.message = "Error parsing response: " + std::string(e.what());
+                }
+                // A success status with an unreadable body means the message was probably queued
+                result.ambiguous = !result.success &&
+                                   ((result.http_status >= 200 && result.http_status < 300) ||
+                                    result.http_status == 500);
+            } else {
+                result.curl_code = res;
+                result.message = "Connection failed: " + std::string(curl_easy_strerror(res));
+                // Only failures before the request went out are known not to have reached the API
+                result.ambiguous = res != CURLE_COULDNT_RESOLVE_HOST && res != CURLE_COULDNT_RESOLVE_PROXY &&
+                                   res != CURLE_COULDNT_CONNECT && res != CURLE_SSL_CONNECT_ERROR;
+            }
+        }
+
+        return result;
+    }
+
+    // Transport interface
+    SendResult send(const std::string& from, const std::string& to, const std::string& body) override {
+        return sendSMS(to, body, from);
+    }
+
+    /*
+     * @brief Looks for a message that an ambiguous send may have created
+     * Lists the recent messages between the two numbers and matches the body
+     * and creation time. Only messages created at or after the first attempt
+     * (to the second) count, so an identical earlier message to the same
+     * recipient is never taken for this one. The message list can lag slightly
+     * behind sends, so callers should wait a moment before reconciling and not
+     * trust a single empty answer.
+     */
+    int reconcile(const std::string& from, const std::string& to, const std::string& body,
+                  double since, std::string& sid) override {
+        if (!curl) return -1;
+        curl_easy_reset(curl);
+
+        std::string readBuffer;
+        std::string url = api_base + "/2010-04-01/Accounts/" + config.account_sid +
+                          "/Messages.json?To=" + urlEncode(to) +
+                          "&From=" + urlEncode(from.empty() ? config.phone_number : from) + "&PageSize=20";
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_USERNAME, config.account_sid.c_str());
+        curl_easy_setopt(curl, CURLOPT_PASSWORD, config.auth_token.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)config.http_timeout_seconds);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        CURLcode res = curl_easy_perform(curl);
+        long status = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        if (res != CURLE_OK || status != 200) return -1;
+
+        try {
+            json response = json::parse(readBuffer);
+            for (const auto& message : response.at("messages")) {
+                // date_created is RFC 2822 in UTC, e.g. "Wed, 18 Oct 2026 12:00:00 +0000"
+                std::tm created{};
+                std::string date = message.value("date_created", std::string());
+                if (!strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S", &created)) continue;
+                if ((double)timegm(&created) < std::floor(since)) continue;
+                if (message.value("body", std::string()) != body) continue;
+                sid = message.value("sid", std::string());
+                return 1;
+            }
+            return 0;
+        } catch (const std::exception&) {
+            return -1;
+        }
+    }
+};
+
+/*
+ * Error classes used to judge the health of a running campaign
+ */
+enum class ErrorClass {
+    NONE,           // Sent successfully
+    RECIPIENT,      // Problem with one recipient (invalid, unsubscribed, unreachable)
+    SENDER,         // Credentials, sender number or account problem: affects every message
+    CONTENT,        // Message body rejected or filtered: affects every message
+    THROTTLED,      // Rate or concurrency limit hit
+    TRANSPORT,      // Network failure or server error
+    UNCONFIRMED,    // The request may have been accepted, and reconciliation could not tell
+    UNKNOWN         // Anything else
+};
+
+/*
+ * @brief Returns a short display name for an error class
+ */
+const char* errorClassName(ErrorClass error) {
+    switch (error) {
+        case ErrorClass::NONE: return "ok";
+        case ErrorClass::RECIPIENT: return "recipient";
+        case ErrorClass::SENDER: return "sender/account";
+        case ErrorClass::CONTENT: return "content";
+        case ErrorClass::THROTTLED: return "throttled";
+        case ErrorClass::TRANSPORT: return "transport";
+        case ErrorClass::UNCONFIRMED: return "unconfirmed";
+        default: return "unknown";
+    }
+}
+
+/*
+ * @brief Classifies the outcome of a send from its HTTP status and Twilio error code
+ */
+ErrorClass classifyError(const SMSSender::SendResult& result) {
+    if (result.success) return ErrorClass::NONE;
+    if (result.ambiguous) return ErrorClass::UNCONFIRMED;
+    switch (result.error_code) {
+        case 21211: case 21214: case 21217: case 21408: case 21610: case 21612: case 21614:
+        case 30003: case 30004: case 30005: case 30006:
+            return ErrorClass::RECIPIENT;
+        case 20003: case 20005: case 20404: case 21212: case 21606: case 21659: case 21660:
+        case 30032: case 30034:
+            return ErrorClass::SENDER;
+        case 21617: case 30007: case 30019:
+            return ErrorClass::CONTENT;
+        case 14107: case 20429: case 30022:
+            return ErrorClass::THROTTLED;
+        default:
+            break;
+    }
+    if (result.http_status == 429) return ErrorClass::THROTTLED;
+    if (result.http_status == 401 || result.http_status == 403) return ErrorClass::SENDER;
+    if (result.http_status == 0 || result.http_status >= 500) return ErrorClass::TRANSPORT;
+    return ErrorClass::UNKNOWN;
+}
+
+/*
+ * @brief Tells whether a failed send can be retried without risking a duplicate
+ * Throttling, gateway errors and failures to connect never reach the API.
+ */
+bool isRetryable(const SendResult& result) {
+    if (result.success || result.ambiguous) return false;
+    if (result.http_status == 429 || result.http_status == 502 || result.http_status == 503 ||
+        result.http_status == 504) {
+        return true;
+    }
+    return result.http_status == 0 && result.curl_code != 0;
+}
+
+/*
+ * @brief Sends one message, retrying safe failures and reconciling ambiguous ones
+ * Retries back off exponentially from RETRY_BACKOFF_MS. When the outcome of an
+ * attempt is unknown (reset, timeout, unreadable reply) the message list is
+ * checked before anything is resent, so a recipient is never sent the same
+ * message twice; if that check fails too, the send is reported unconfirmed.
+ * The list lags behind sends, so the message must be missing from two
+ * lookups, a backoff apart, before it is sent again.
+ * @param transport Transport to send through
+ * @param clock Clock used for backoff
+ * @param config Retry settings
+ * @param from Sender number
+ * @param to Recipient number
+ * @param body Message content
+ * @param attempts Set to the number of attempts made
+ * @return Final SendResult
+ */
+SendResult deliver(Transport& transport, Clock& clock, const TwilioConfig& config, const std::string& from,
+                   const std::string& to, const std::string& body, int* attempts = nullptr) {
+    double first_attempt = clock.now();
+    double backoff = config.retry_backoff_ms / 1000.0;
+    SendResult result{false, "", "", 0, 0};
+    int attempt = 0;
+    while (attempt < config.retry_attempts) {
+        attempt++;
+        result = transport.send(from, to, body);
+        if (result.success) break;
+
+        if (result.ambiguous) {
+            clock.sleepFor(backoff);
+            std::string sid;
+            int found = transport.reconcile(from, to, body, first_attempt, sid);
+            if (found == 0) {
+                clock.sleepFor(backoff);
+                found = transport.reconcile(from, to, body, first_attempt, sid);
+            }
+            if (found == 1) {
+                result.success = true;
+                result.ambiguous = false;
+                result.sid = sid;
+                result.message = "Message sent successfully (confirmed after: " + result.message + ")";
+                break;
+            }
+            if (found < 0) break;
+            result.ambiguous = false;   // Absent twice: not accepted, safe to send again
+        } else if (!isRetryable(result)) {
+            break;
+        } else if (attempt < config.retry_attempts) {
+            clock.sleepFor(backoff);
+        }
+        backoff = std::min(backoff * 2, 30.0);
+    }
+    if (attempts) *attempts = attempt;
+    return result;
+}
+
+/*
+ * Ramp controller class
+ * Slow-start policy for the send rate. A campaign starts at a fraction of each
+ * sender's rate and doubles it after every healthy window of sends. Failures
+ * that point at a systemic problem (everything but per-recipient errors) are
+ * tracked over a rolling window: crossing the pause ratio drops back to the
+ * start rate for a cool-down, and crossing the abort ratio, or pausing too many
+ * times in a row, stops the campaign before the whole list is burned.
+ */
+class RampController {
+public:
+    enum class Action { CONTINUE, PAUSE, ABORT };
+
+private:
+    const TwilioConfig& config;
+    std::vector<ErrorClass> window;     // Rolling window of recent outcomes
+    size_t next = 0;
+    size_t filled = 0;
+    size_t since_change = 0;            // Sends since the rate last changed
+    int consecutive_pauses = 0;
+    double rate = 1.0;                  // Fraction of the full rate in use
+
+public:
+    // Constructor
+    RampController(const TwilioConfig& cfg) : config(cfg), window(std::max(1, cfg.ramp_window)) {
+        rate = cfg.ramp_enabled ? std::min(100, std::max(1, cfg.ramp_start_percent)) / 100.0 : 1.0;
+    }
+
+    /*
+     * @brief Fraction of each sender's configured rate to use right now
+     */
+    double rateFactor() const { return rate; }
+
+    /*
+     * @brief Ratio of systemic failures in the rolling window
+     */
+    double failureRatio() const {
+        if (filled == 0) return 0;
+        size_t failures = 0;
+        for (size_t i = 0; i < filled; ++i) {
+            failures += window[i] != ErrorClass::NONE && window[i] != ErrorClass::RECIPIENT;
+        }
+        return (double)failures / filled;
+    }
+
+    /*
+     * @brief Describes the failures in the rolling window by class
+     */
+    std::string breakdown() const {
+        std::map<std::string, int> counts;
+        for (size_t i = 0; i < filled; ++i) {
+            if (window[i] != ErrorClass::NONE) counts[errorClassName(window[i])]++;
+        }
+        std::string text;
+        for (const auto& entry : counts) {
+            text += (text.empty() ? "" : ", ") + std::to_string(entry.second) + " " + entry.first;
+        }
+        return text.empty() ? "none" : text;
+    }
+
+    /*
+     * @brief Records one send outcome and decides how the campaign proceeds
+     * @return CONTINUE, PAUSE (cool down, rate reset) or ABORT
+     */
+    Action record(ErrorClass outcome) {
+        if (!config.ramp_enabled) return Action::CONTINUE;
+
+        window[next] = outcome;
+        next = (next + 1) % window.size();
+        filled = std::min(filled + 1, window.size());
+        since_change++;
+        if (filled < window.size()) return Action::CONTINUE;
+
+        double ratio = failureRatio();
+        if (ratio >= config.ramp_abort_ratio) return Action::ABORT;
+        if (ratio >= config.ramp_pause_ratio) {
+            if (++consecutive_pauses > config.ramp_max_pauses) return Action::ABORT;
+            rate = std::min(100, std::max(1, config.ramp_start_percent)) / 100.0;
+            filled = 0;
+            next = 0;
+            since_change = 0;
+            return Action::PAUSE;
+        }
+
+        // A full healthy window at this rate: double it
+        if (since_change >= window.size()) {
+            consecutive_pauses = 0;
+            rate = std::min(1.0, rate * 2);
+            since_change = 0;
+        }
+        return Action::CONTINUE;
+    }
+};
+
+/*
+ * Latency histogram class
+ * Log-linear buckets (16 per power of two) over microseconds: constant memory,
+ * O(1) recording and percentiles within about 6% of the true value.
+ */
+class LatencyHistogram {
+private:
+    static const int SUB_BUCKETS = 16;
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(64 * SUB_BUCKETS, 0);
+    uint64_t samples = 0;
+    double sum_us = 0;
+    double max_us = 0;
+
+    static size_t bucketOf(uint64_t us) {
+        if (us < SUB_BUCKETS) return us;
+        int exponent = 63 - __builtin_clzll(us);
+        int sub = (int)((us >> (exponent - 4)) & (SUB_BUCKETS - 1));
+        return (size_t)(exponent - 3) * SUB_BUCKETS + sub;
+    }
+
+    static double upperBound(size_t bucket) {
+        if (bucket < SUB_BUCKETS) return (double)bucket;
+        int exponent = (int)(bucket / SUB_BUCKETS) + 3;
+        uint64_t sub = bucket % SUB_BUCKETS;
+        return (double)(((SUB_BUCKETS + sub + 1) << (exponent - 4)) - 1);
+    }
+
+public:
+    void record(double seconds) {
+        uint64_t us = (uint64_t)std::max(0.0, seconds * 1e6);
+        buckets[std::min(bucketOf(us), buckets.size() - 1)]++;
+        samples++;
+        sum_us += (double)us;
+        max_us = std::max(max_us, (double)us);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < buckets.size(); ++i) buckets[i] += other.buckets[i];
+        samples += other.samples;
+        sum_us += other.sum_us;
+        max_us = std::max(max_us, other.max_us);
+    }
+
+    void reset() { *this = LatencyHistogram(); }
+
+    /*
+     * @brief Returns a percentile in milliseconds
+     * @param p Percentile between 0 and 100
+     */
+    double percentileMs(double p) const {
+        if (samples == 0) return 0;
+        uint64_t rank = (uint64_t)std::ceil(p / 100.0 * samples);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= std::max<uint64_t>(rank, 1)) return std::min(upperBound(i), max_us) / 1000.0;
+        }
+        return max_us / 1000.0;
+    }
+
+    double meanMs() const { return samples ? sum_us / samples / 1000.0 : 0; }
+    double maxMs() const { return max_us / 1000.0; }
+    uint64_t count() const { return samples; }
+};
+
+/*
+ * Outcome of a message as stored in the result archive
+ */
+enum class ArchiveStatus : uint8_t {
+    SENT,           // Accepted by the API
+    FAILED,         // Not sent
+    UNCONFIRMED,    // May have been sent; reconciliation could not tell
+    SKIPPED         // Not attempted (opted out or frequency capped)
+};
+
+const char* archiveStatusName(ArchiveStatus status) {
+    switch (status) {
+        case ArchiveStatus::SENT: return "sent";
+        case ArchiveStatus::FAILED: return "failed";
+        case ArchiveStatus::UNCONFIRMED: return "unconfirmed";
+        default: return "skipped";
+    }
+}
+
+/*
+ * Result archive namespace
+ * Columnar, compressed store of per-message results for audits. Rows are
+ * grouped in blocks of up to 64K; each column of a block is compressed with
+ * zstd on its own, behind a header holding the block's min/max time, latency
+ * and error code plus bitmaps of the statuses and countries present, so a
+ * query can skip blocks that cannot match and decompress only the columns it
+ * filters on until a row matches. Blocks are only ever appended, so one file
+ * collects the results of many campaigns.
+ */
+namespace ResultArchive {
+
+const char MAGIC[8] = {'S', 'M', 'S', 'A', 'R', 'C', '0', '1'};
+const uint32_t BLOCK_MAGIC = 0x314b4c42;    // "BLK1"
+const size_t BLOCK_ROWS = 65536;
+const size_t SID_BYTES = 34;
+
+enum Column { TIME, NUMBER, COUNTRY, STATUS, ERROR_CODE, LATENCY, SID, COLUMNS };
+
+/*
+ * Structure in front of every block's compressed columns
+ */
+struct BlockHeader {
+    uint32_t magic;
+    uint32_t rows;
+    int64_t base_time;          // Earliest time in the block (Unix seconds); times are stored as offsets
+    uint32_t max_time_offset;
+    uint32_t min_latency_us;
+    uint32_t max_latency_us;
+    int32_t min_error;
+    int32_t max_error;
+    uint8_t status_mask;        // Bit per ArchiveStatus present
+    uint8_t reserved[3];
+    uint64_t country_mask;      // Bit (country code % 64) per country present
+    uint32_t column_bytes[COLUMNS];         // Compressed size of each column
+};
+
+inline size_t columnWidth(int column) {
+    switch (column) {
+        case TIME: return sizeof(uint32_t);
+        case NUMBER: return sizeof(uint64_t);
+        case COUNTRY: return sizeof(uint16_t);
+        case STATUS: return sizeof(uint8_t);
+        case ERROR_CODE: return sizeof(int32_t);
+        case LATENCY: return sizeof(uint32_t);
+        default: return SID_BYTES;
+    }
+}
+
+/*
+ * Writer class
+ * Buffers rows column by column and appends a block whenever BLOCK_ROWS have
+ * accumulated and when closed. Safe to use from several threads.
+ */
+class Writer {
+private:
+    std::string path;
+    int fd = -1;
+    std::mutex mutex;
+    std::vector<int64_t> times;
+    std::vector<uint64_t> numbers;
+    std::vector<uint16_t> countries;
+    std::vector<uint8_t> statuses;
+    std::vector<int32_t> errors;
+    std::vector<uint32_t> latencies;
+    std::vector<char> sids;
+
+    void flushBlock() {
+        if (times.empty()) return;
+        BlockHeader header{};
+        header.magic = BLOCK_MAGIC;
+        header.rows = (uint32_t)times.size();
+        header.base_time = *std::min_element(times.begin(), times.end());
+        header.min_latency_us = *std::min_element(latencies.begin(), latencies.end());
+        header.max_latency_us = *std::max_element(latencies.begin(), latencies.end());
+        header.min_error = *std::min_element(errors.begin(), errors.end());
+        header.max_error = *std::max_element(errors.begin(), errors.end());
+        std::vector<uint32_t> offsets(times.size());
+        for (size_t i = 0; i < times.size(); ++i) {
+            offsets[i] = (uint32_t)std::min<int64_t>(times[i] - header.base_time, INT32_MAX);
+            header.max_time_offset = std::max(header.max_time_offset, offsets[i]);
+            header.status_mask |= (uint8_t)(1u << statuses[i]);
+            header.country_mask |= 1ULL << (countries[i] % 64);
+        }
+
+        const void* columns[COLUMNS] = {offsets.data(), numbers.data(), countries.data(), statuses.data(),
+                                        errors.data(), latencies.data(), sids.data()};
+        std::string block((const char*)&header, sizeof(header));
+        for (int c = 0; c < COLUMNS; ++c) {
+            size_t raw = header.rows * columnWidth(c);
+            std::string compressed(ZSTD_compressBound(raw), '\0');
+            size_t size = ZSTD_compress(&compressed[0], compressed.size(), columns[c], raw, 3);
+            if (ZSTD_isError(size)) throw std::runtime_error(std::string("Error: zstd: ") + ZSTD_getErrorName(size));
+            ((BlockHeader*)&block[0])->column_bytes[c] = (uint32_t)size;
+            block.append(compressed.data(), size);
+        }
+        // One write per block, so a crash never leaves half a header behind a complete block
+        if (write(fd, block.data(), block.size()) != (ssize_t)block.size()) {
+            throw std::runtime_error("Error: cannot write result archive " + path + ": " + std::strerror(errno));
+        }
+
+        times.clear();
+        numbers.clear();
+        countries.clear();
+        statuses.clear();
+        errors.clear();
+        latencies.clear();
+        sids.clear();
+    }
+
+public:
+    // Constructor: opens the archive for appending, creating it if needed
+    Writer(const std::string& file) : path(file) {
+        fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) throw std::runtime_error("Error: cannot open result archive " + file + ": " + std::strerror(errno));
+        struct stat info{};
+        fstat(fd, &info);
+        if (info.st_size == 0 && write(fd, MAGIC, sizeof(MAGIC)) != (ssize_t)sizeof(MAGIC)) {
+            throw std::runtime_error("Error: cannot write result archive " + file);
+        }
+    }
+
+    // Writes the last partial block
+    ~Writer() {
+        try { flushBlock(); } catch (...) {}
+        ::close(fd);
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    /*
+     * @brief Adds one message outcome
+     * @param time Unix time of the outcome
+     * @param number Recipient
+     * @param status Outcome
+     * @param error_code Twilio error code (0 if none)
+     * @param latency Seconds the send took, retries included
+     * @param sid Message SID ("" if none)
+     */
+    void add(std::time_t time, const std::string& number, ArchiveStatus status, int error_code, double latency,
+             const std::string& sid) {
+        std::lock_guard<std::mutex> lock(mutex);
+        times.push_back(time);
+        numbers.push_back(packPhoneNumber(number));
+        countries.push_back((uint16_t)countryCode(number.substr(number[0] == '+' ? 1 : 0, 3)));
+        statuses.push_back((uint8_t)status);
+        errors.push_back(error_code);
+        latencies.push_back((uint32_t)std::min(latency * 1e6, 4e9));
+        size_t at = sids.size();
+        sids.resize(at + SID_BYTES, '\0');
+        std::memcpy(&sids[at], sid.data(), std::min(sid.size(), SID_BYTES));
+        if (times.size() >= BLOCK_ROWS) flushBlock();
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushBlock();
+    }
+};
+
+/*
+ * Column filters
+ * Narrow a row selection (one byte per row, 1 = still matching) to the rows
+ * whose value lies in [low, high]. The SSE2 paths compare 16 rows per step
+ * and merge the results into the selection without branches.
+ */
+inline void filterRange8(const uint8_t* values, size_t rows, uint8_t low, uint8_t high, uint8_t* keep) {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i bias = _mm_set1_epi8((char)0x80);    // Unsigned order via signed compares
+    const __m128i lo = _mm_set1_epi8((char)(low ^ 0x80));
+    const __m128i hi = _mm_set1_epi8((char)(high ^ 0x80));
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= rows; i += 16) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(values + i)), bias);
+        __m128i out = _mm_or_si128(_mm_cmplt_epi8(v, lo), _mm_cmpgt_epi8(v, hi));
+        __m128i k = _mm_loadu_si128((const __m128i*)(keep + i));
+        _mm_storeu_si128((__m128i*)(keep + i), _mm_andnot_si128(out, _mm_and_si128(k, one)));
+    }
+#endif
+    for (; i < rows; ++i) keep[i] &= (uint8_t)(values[i] >= low && values[i] <= high);
+}
+
+inline void filterRange16(const uint16_t* values, size_t rows, uint16_t low, uint16_t high, uint8_t* keep) {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    const __m128i lo = _mm_set1_epi16((short)(low ^ 0x8000));
+    const __m128i hi = _mm_set1_epi16((short)(high ^ 0x8000));
+    auto outside = [&](size_t at) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(values + at)), bias);
+        return _mm_or_si128(_mm_cmplt_epi16(v, lo), _mm_cmpgt_epi16(v, hi));
+    };
+    for (; i + 16 <= rows; i += 16) {
+        __m128i out = _mm_packs_epi16(outside(i), outside(i + 8));
+        __m128i k = _mm_loadu_si128((const __m128i*)(keep + i));
+        _mm_storeu_si128((__m128i*)(keep + i), _mm_andnot_si128(out, k));
+    }
+#endif
+    for (; i < rows; ++i) keep[i] &= (uint8_t)(values[i] >= low && values[i] <= high);
+}
+
+inline void filterRange32(const int32_t* values, size_t rows, int32_t low, int32_t high, uint8_t* keep) {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i lo = _mm_set1_epi32(low);
+    const __m128i hi = _mm_set1_epi32(high);
+    auto outside = [&](size_t at) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(values + at));
+        return _mm_or_si128(_mm_cmplt_epi32(v, lo), _mm_cmpgt_epi32(v, hi));
+    };
+    for (; i + 16 <= rows; i += 16) {
+        __m128i out = _mm_packs_epi16(_mm_packs_epi32(outside(i), outside(i + 4)),
+                                      _mm_packs_epi32(outside(i + 8), outside(i + 12)));
+        __m128i k = _mm_loadu_si128((const __m128i*)(keep + i));
+        _mm_storeu_si128((__m128i*)(keep + i), _mm_andnot_si128(out, k));
+    }
+#endif
+    for (; i < rows; ++i) keep[i] &= (uint8_t)(values[i] >= low && values[i] <= high);
+}
+
+/*
+ * @brief Counts the selected rows
+ */
+inline size_t countSelected(const uint8_t* keep, size_t rows) {
+    size_t total = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i sums = _mm_setzero_si128();
+    for (; i + 16 <= rows; i += 16) {
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(keep + i)), _mm_setzero_si128()));
+    }
+    total = (size_t)_mm_cvtsi128_si64(sums) + (size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums));
+#endif
+    for (; i < rows; ++i) total += keep[i];
+    return total;
+}
+
+}  // namespace ResultArchive
+
+/*
+ * @brief Parses a time given as Unix seconds, YYYY-MM-DD or YYYY-MM-DDTHH:MM[:SS] (UTC)
+ * @throws std::runtime_error if the format is not recognised
+ */
+std::time_t parseQueryTime(const std::string& text) {
+    if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) return std::stoll(text);
+    std::tm when{};
+    const char* end = strptime(text.c_str(), "%Y-%m-%dT%H:%M:%S", &when);
+    if (!end || *end) {
+        when = std::tm{};
+        end = strptime(text.c_str(), "%Y-%m-%dT%H:%M", &when);
+    }
+    if (!end || *end) {
+        when = std::tm{};
+        end = strptime(text.c_str(), "%Y-%m-%d", &when);
+    }
+    if (!end || *end) throw std::runtime_error("Invalid time (expected YYYY-MM-DD[THH:MM[:SS]] or Unix seconds): " + text);
+    return timegm(&when);
+}
+
+/*
+ * @brief Lists or counts archived results matching a filter
+ * Blocks whose header rules out a match are skipped without decompressing
+ * anything; in the rest, filter columns are decompressed and scanned first,
+ * and the other columns only if some row matched.
+ * @param args Arguments after "query"
+ * @return Process exit code
+ */
+int runQueryCommand(const std::vector<std::string>& args) {
+    using namespace ResultArchive;
+    auto usage = [] {
+        std::cerr << "Usage: sms_sender query <archive> [--status sent|failed|unconfirmed|skipped] [--error CODE]\n"
+                  << "         [--country CODE] [--since TIME] [--until TIME] [--count] [--limit N]\n"
+                  << "TIME is Unix seconds, YYYY-MM-DD or YYYY-MM-DDTHH:MM[:SS] (UTC)\n";
+        return 2;
+    };
+    if (args.empty()) return usage();
+
+    std::string path = args[0];
+    int status = -1;
+    long long error_code = LLONG_MIN;
+    int country = -1;
+    std::time_t since = LLONG_MIN;
+    std::time_t until = LLONG_MAX;
+    bool count_only = false;
+    size_t limit = SIZE_MAX;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i] == "--count") {
+            count_only = true;
+            continue;
+        }
+        if (i + 1 >= args.size()) return usage();
+        const std::string& option = args[i];
+        const std::string& value = args[++i];
+        if (option == "--status") {
+            for (int s = 0; s <= (int)ArchiveStatus::SKIPPED; ++s) {
+                if (value == archiveStatusName((ArchiveStatus)s)) status = s;
+            }
+            if (status < 0) return usage();
+        } else if (option == "--error") {
+            error_code = std::stoll(value);
+        } else if (option == "--country") {
+            country = std::stoi(value[0] == '+' ? value.substr(1) : value);
+        } else if (option == "--since") {
+            since = parseQueryTime(value);
+        } else if (option == "--until") {
+            until = parseQueryTime(value);
+        } else if (option == "--limit") {
+            limit = std::stoull(value);
+        } else {
+            return usage();
+        }
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Error: cannot open " + path + ": " + std::strerror(errno));
+    struct stat info{};
+    fstat(fd, &info);
+    size_t size = (size_t)info.st_size;
+    if (size < sizeof(MAGIC)) {
+        ::close(fd);
+        throw std::runtime_error("Error: " + path + " is not a result archive");
+    }
+    const char* data = (const char*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) throw std::runtime_error("Error: cannot map " + path + ": " + std::strerror(errno));
+    std::unique_ptr<const char, std::function<void(const char*)>> mapping(
+        data, [size](const char* p) { munmap((void*)p, size); });
+    if (std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error("Error: " + path + " is not a result archive");
+
+    if (!count_only) std::cout << "time\tnumber\tstatus\terror\tlatency_ms\tsid\n";
+    size_t blocks = 0, skipped = 0, scanned_rows = 0, matched = 0;
+    std::vector<char> columns[COLUMNS];
+    std::vector<uint8_t> keep;
+    size_t offset = sizeof(MAGIC);
+    while (offset + sizeof(BlockHeader) <= size && matched < limit) {
+        BlockHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        size_t compressed = 0;
+        for (uint32_t bytes : header.column_bytes) compressed += bytes;
+        if (header.magic != BLOCK_MAGIC || offset + sizeof(header) + compressed > size) {
+            std::cerr << Color::YELLOW << "Warning: " << path << " ends with an incomplete block" << Color::RESET << "\n";
+            break;
+        }
+        const char* column_data[COLUMNS];
+        const char* cursor = data + offset + sizeof(header);
+        for (int c = 0; c < COLUMNS; ++c) {
+            column_data[c] = cursor;
+            cursor += header.column_bytes[c];
+        }
+        offset += sizeof(header) + compressed;
+        blocks++;
+
+        // Skip blocks the header rules out
+        int64_t first = header.base_time;
+        int64_t last = header.base_time + header.max_time_offset;
+        if ((status >= 0 && !(header.status_mask & (1u << status))) ||
+            (error_code != LLONG_MIN && (error_code < header.min_error || error_code > header.max_error)) ||
+            (country >= 0 && !(header.country_mask & (1ULL << (country % 64)))) ||
+            last < (int64_t)since || first > (int64_t)until) {
+            skipped++;
+            continue;
+        }
+
+        size_t rows = header.rows;
+        auto column = [&](int c) -> const char* {
+            std::vector<char>& out = columns[c];
+            if (out.size() != rows * columnWidth(c)) {
+                out.resize(rows * columnWidth(c));
+                size_t got = ZSTD_decompress(out.data(), out.size(), column_data[c], header.column_bytes[c]);
+                if (ZSTD_isError(got) || got != out.size()) throw std::runtime_error("Error: corrupt block in " + path);
+            }
+            return out.data();
+        };
+        for (auto& c : columns) c.clear();
+        keep.assign(rows, 1);
+        scanned_rows += rows;
+
+        if (status >= 0) filterRange8((const uint8_t*)column(STATUS), rows, (uint8_t)status, (uint8_t)status, keep.data());
+        if (error_code != LLONG_MIN) {
+            filterRange32((const int32_t*)column(ERROR_CODE), rows, (int32_t)error_code, (int32_t)error_code, keep.data());
+        }
+        if (country >= 0) {
+            filterRange16((const uint16_t*)column(COUNTRY), rows, (uint16_t)country, (uint16_t)country, keep.data());
+        }
+        if ((int64_t)since > first || (int64_t)until < last) {
+            int32_t low = (int32_t)std::max<int64_t>(0, (int64_t)since - first);
+            int32_t high = (int32_t)std::min<int64_t>(INT32_MAX, (int64_t)until - first);
+            filterRange32((const int32_t*)column(TIME), rows, low, high, keep.data());
+        }
+
+        size_t hits = countSelected(keep.data(), rows);
+        if (count_only) {
+            matched += hits;
+            continue;
+        }
+        if (hits == 0) continue;
+        const uint32_t* times = (const uint32_t*)column(TIME);
+        const uint64_t* numbers = (const uint64_t*)column(NUMBER);
+        const uint8_t* statuses = (const uint8_t*)column(STATUS);
+        const int32_t* errors = (const int32_t*)column(ERROR_CODE);
+        const uint32_t* latencies = (const uint32_t*)column(LATENCY);
+        const char* sids = column(SID);
+        for (size_t r = 0; r < rows && matched < limit; ++r) {
+            if (!keep[r]) continue;
+            std::time_t when = (std::time_t)(first + times[r]);
+            std::tm utc{};
+            gmtime_r(&when, &utc);
+            std::cout << std::put_time(&utc, "%Y-%m-%dT%H:%M:%SZ") << '\t' << (numbers[r] ? unpackPhoneNumber(numbers[r]) : "-") << '\t'
+                      << archiveStatusName((ArchiveStatus)statuses[r]) << '\t' << errors[r] << '\t' << std::fixed
+                      << std::setprecision(1) << latencies[r] / 1000.0 << '\t'
+                      << std::string(sids + r * SID_BYTES, strnlen(sids + r * SID_BYTES, SID_BYTES)) << '\n';
+            matched++;
+        }
+    }
+
+    if (count_only) std::cout << matched << "\n";
+    std::cerr << "Matched " << matched << " rows; scanned " << scanned_rows << " rows in " << blocks - skipped
+              << " of " << blocks << " blocks (" << skipped << " skipped by their index)\n";
+    return 0;
+}
+
+/*
+ * @brief Attributes tracking tokens to recipients through a token index
+ * @param args Arguments after "token": the index, then tokens (read one per
+ *             line from stdin when none are given)
+ * @return Process exit code
+ */
+int runTokenCommand(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        std::cerr << "Usage: sms_sender token <index> [TOKEN...]\n"
+                  << "Without tokens, reads one per line from standard input\n";
+        return 2;
+    }
+    std::vector<std::string> tokens(args.begin() + 1, args.end());
+    if (tokens.empty()) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            line.erase(0, line.find_first_not_of(" \t\r"));
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty()) tokens.push_back(line);
+        }
+    }
+
+    std::vector<std::vector<std::string>> found = TrackingTokens::lookup(args[0], tokens);
+    size_t resolved = 0;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (found[i].empty()) std::cout << tokens[i] << "\t-\n";
+        for (const auto& number : found[i]) std::cout << tokens[i] << '\t' << number << '\n';
+        if (!found[i].empty()) resolved++;
+    }
+    std::cerr << "Resolved " << resolved << " of " << tokens.size() << " tokens\n";
+    return 0;
+}
+
+/*
+ * StatusBoard class
+ * Publishes a running campaign's or engine's progress in a small memory-mapped
+ * file that `sms_sender status` reads from another process. Every field is an
+ * atomic updated with relaxed stores, so publishing costs no system calls and
+ * no locks; the rate and ETA are recomputed at most once a second by whichever
+ * thread completes a message first after the second has passed.
+ */
+class StatusBoard {
+public:
+    enum class Stage : uint32_t { STARTING, SENDING, IDLE, WINDOW_WAIT, QUOTA_WAIT, PAUSED, DRAINING, FINISHED,
+                                  ABORTED };
+    enum class Mode : uint32_t { CAMPAIGN, ENGINE };
+
+    /*
+     * Structure of the status file
+     * The magic is written last, so a reader never sees a half-initialized block.
+     */
+    struct Block {
+        char magic[8];
+        std::atomic<int64_t> pid;
+        std::atomic<int64_t> started_ms;    // Unix time in milliseconds
+        std::atomic<int64_t> updated_ms;
+        std::atomic<uint64_t> total;        // Messages planned (0 = open-ended)
+        std::atomic<uint64_t> sent;
+        std::atomic<uint64_t> failed;
+        std::atomic<uint64_t> skipped;
+        std::atomic<int64_t> in_flight;     // Queued or being sent
+        std::atomic<uint64_t> rate_milli;   // Completions per second, times 1000
+        std::atomic<int64_t> eta_seconds;   // -1 if unknown
+        std::atomic<uint32_t> stage;
+        std::atomic<uint32_t> mode;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "status fields must be lock-free to share them");
+
+    static constexpr const char* MAGIC = "SMSSTA01";
+
+private:
+    Block* block = nullptr;
+    std::atomic_flag rating = ATOMIC_FLAG_INIT;     // Held by the thread recomputing the rate
+    double window_start = -1;
+    uint64_t window_done = 0;
+    double rate = 0;
+
+    static int64_t wallMillis() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void completed(double now) {
+        if (rating.test_and_set(std::memory_order_acquire)) return;
+        uint64_t done = block->sent.load(std::memory_order_relaxed) + block->failed.load(std::memory_order_relaxed) +
+                        block->skipped.load(std::memory_order_relaxed);
+        if (window_start < 0) {
+            window_start = now;
+            window_done = done;
+        } else if (now - window_start >= 1.0) {
+            double current = (done - window_done) / (now - window_start);
+            rate = rate > 0 ? 0.7 * rate + 0.3 * current : current;
+            window_start = now;
+            window_done = done;
+            uint64_t total = block->total.load(std::memory_order_relaxed);
+            block->rate_milli.store((uint64_t)(rate * 1000), std::memory_order_relaxed);
+            block->eta_seconds.store(total > done && rate > 0 ? (int64_t)((total - done) / rate) : -1,
+                                     std::memory_order_relaxed);
+            block->updated_ms.store(wallMillis(), std::memory_order_relaxed);
+        }
+        rating.clear(std::memory_order_release);
+    }
+
+public:
+    /*
+     * @brief Returns the pid of a live, unfinished run publishing to a status file
+     * @return The pid, or 0 if the file is missing, not a status file, or its run has ended
+     */
+    static pid_t owner(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return 0;
+        Block existing;
+        bool whole = ::read(fd, &existing, sizeof(existing)) == (ssize_t)sizeof(existing);
+        ::close(fd);
+        if (!whole || std::memcmp(existing.magic, MAGIC, sizeof(existing.magic)) != 0) return 0;
+        pid_t pid = (pid_t)existing.pid.load(std::memory_order_relaxed);
+        uint32_t stage = existing.stage.load(std::memory_order_relaxed);
+        if (pid <= 0 || pid == getpid() || stage == (uint32_t)Stage::FINISHED || stage == (uint32_t)Stage::ABORTED) {
+            return 0;
+        }
+        return kill(pid, 0) == 0 || errno == EPERM ? pid : 0;
+    }
+
+    // Constructor: publishes a fresh status file, refusing one that a running process still updates
+    StatusBoard(const std::string& path, Mode mode) {
+        if (pid_t pid = owner(path)) {
+            throw std::runtime_error("Error: status file " + path + " is in use by process " + std::to_string(pid) +
+                                     "; give this run its own STATUS_FILE");
+        }
+        // Built aside and renamed over: a reader (or a dead run) may still map the old file, and truncating
+        // a mapped file in place kills its readers with SIGBUS
+        std::string tmp = path + "." + std::to_string(getpid()) + ".tmp";
+        int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, sizeof(Block)) != 0) {
+            std::string reason = std::strerror(errno);
+            if (fd >= 0) {
+                ::close(fd);
+                ::unlink(tmp.c_str());
+            }
+            throw std::runtime_error("Error: cannot create status file " + path + ": " + reason);
+        }
+        void* data = mmap(nullptr, sizeof(Block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            ::unlink(tmp.c_str());
+            throw std::runtime_error("Error: cannot map status file " + path);
+        }
+        block = new (data) Block{};
+        block->pid.store(getpid(), std::memory_order_relaxed);
+        block->started_ms.store(wallMillis(), std::memory_order_relaxed);
+        block->updated_ms.store(wallMillis(), std::memory_order_relaxed);
+        block->eta_seconds.store(-1, std::memory_order_relaxed);
+        block->mode.store((uint32_t)mode, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(block->magic, MAGIC, sizeof(block->magic));
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::string reason = std::strerror(errno);
+            munmap(block, sizeof(Block));
+            ::unlink(tmp.c_str());
+            throw std::runtime_error("Error: cannot replace status file " + path + ": " + reason);
+        }
+    }
+
+    ~StatusBoard() { munmap(block, sizeof(Block)); }
+
+    StatusBoard(const StatusBoard&) = delete;
+    StatusBoard& operator=(const StatusBoard&) = delete;
+
+    void setTotal(uint64_t total) { block->total.store(total, std::memory_order_relaxed); }
+
+    void setStage(Stage stage) {
+        if (block->stage.load(std::memory_order_relaxed) == (uint32_t)stage) return;
+        block->stage.store((uint32_t)stage, std::memory_order_relaxed);
+        block->updated_ms.store(wallMillis(), std::memory_order_relaxed);
+    }
+
+    void queued(int64_t count) { block->in_flight.fetch_add(count, std::memory_order_relaxed); }
+
+    /*
+     * @brief Counts a finished message
+     * @param now Seconds on the caller's monotonic clock, for the rate
+     */
+    void sent(double now) {
+        block->in_flight.fetch_sub(1, std::memory_order_relaxed);
+        block->sent.fetch_add(1, std::memory_order_relaxed);
+        completed(now);
+    }
+    void failed(double now) {
+        block->in_flight.fetch_sub(1, std::memory_order_relaxed);
+        block->failed.fetch_add(1, std::memory_order_relaxed);
+        completed(now);
+    }
+    void skipped(double now) {
+        block->in_flight.fetch_sub(1, std::memory_order_relaxed);
+        block->skipped.fetch_add(1, std::memory_order_relaxed);
+        completed(now);
+    }
+
+    static const char* stageName(uint32_t stage) {
+        static const char* names[] = {"starting", "sending", "idle", "waiting for send window", "waiting for quota",
+                                      "paused after error spike", "draining", "finished", "aborted"};
+        return stage < sizeof(names) / sizeof(names[0]) ? names[stage] : "unknown";
+    }
+};
+
+/*
+ * Structure to hold the outcome of a campaign run
+ */
+struct CampaignReport {
+    int total = 0;              // Recipients in the campaign
+    int success = 0;
+    int failed = 0;
+    int skipped = 0;            // Opted out or frequency-capped at send time
+    int not_attempted = 0;      // Left over after an abort
+    bool aborted = false;       // Stopped by the error-rate guard
+    int pauses = 0;             // Ramp pauses after error spikes
+    int retries = 0;            // Extra attempts after throttling and transient errors
+    std::map<ErrorClass, int> failures_by_class;
+    LatencyHistogram latency;   // Per-message send time, including retries
+    double started = 0;         // Clock time the first send was dispatched
+    double finished = 0;        // Clock time the last send completed
+};
+
+/*
+ * Campaign runner class
+ * The dispatch loop: walks the campaign plan, applies suppression, frequency
+ * caps, send windows, quotas and the slow-start ramp, paces each sender, sends
+ * through the transport and records the outcome. All waiting goes through the
+ * clock, so the same code runs in real time or on a virtual clock.
+ */
+class CampaignRunner {
+private:
+    const TwilioConfig& config;
+    Clock& clock;
+    Transport& transport;
+    QuotaManager& quotas;
+    FrequencyStore* frequency = nullptr;
+    SuppressionList* suppression = nullptr;
+    std::ostream* journal = nullptr;
+    ResultArchive::Writer* archive = nullptr;
+    TrackingTokens* tokens = nullptr;
+    StatusBoard* status = nullptr;
+    EdgeSelector* edges = nullptr;
+    SMSSender* edge_client = nullptr;
+    bool verbose = true;        // Log an event for every message (interactive runs)
+
+    // Progress bars and rate-limit dots only make sense on a terminal
+    bool decorated() const { return logger().interactive(); }
+
+    void clearLine() const {
+        if (verbose && decorated()) std::cout << "\r" << std::string(80, ' ') << "\r";
+    }
+
+public:
+    // Constructor
+    CampaignRunner(const TwilioConfig& cfg, Clock& time_source, Transport& out, QuotaManager& quota_manager)
+        : config(cfg), clock(time_source), transport(out), quotas(quota_manager) {}
+
+    void setFrequencyStore(FrequencyStore* store) { frequency = store; }
+    void setSuppression(SuppressionList* list) { suppression = list; }
+    void setJournal(std::ostream* out) { journal = out; }
+    void setArchive(ResultArchive::Writer* writer) { archive = writer; }
+    void setTokens(TrackingTokens* renderer) { tokens = renderer; }
+    void setStatus(StatusBoard* board) { status = board; }
+    void setVerbose(bool enabled) { verbose = enabled; }
+
+    /*
+     * @brief Enables periodic edge re-probing for the real Twilio client
+     */
+    void setEdges(EdgeSelector* selector, SMSSender* client) {
+        edges = selector;
+        edge_client = client;
+    }
+
+    /*
+     * @brief Sends a planned campaign
+     * @param numbers Recipient list the plan refers to
+     * @param message Message content
+     * @param plan Campaign plan from planCampaign
+     * @param segments Segments per message
+     * @return CampaignReport with counts, failure classes and latencies
+     */
+    CampaignReport run(const std::vector<std::string>& numbers, const std::string& message,
+                       const CampaignPlan& plan, int segments) {
+        Logger& log = logger();
+        log.flush();
+        CampaignReport report;
+        report.total = (int)numbers.size();
+        report.started = clock.now();
+        int total = report.total;
+        int current = 0;
+        size_t progress_step = std::max<size_t>(1, plan.entries.size() / 100);
+        bool quiet_progress = !verbose && decorated();
+        if (status) {
+            status->setTotal(numbers.size());
+            status->setStage(StatusBoard::Stage::SENDING);
+        }
+
+        // Recipients no sender may deliver to are reported as failures
+        for (size_t r : plan.unservable) {
+            if (verbose) {
+                log.warn("unservable", {{"to", numbers[r]}},
+                         Color::RED + "✗ SKIPPED: " + Color::RESET + numbers[r] +
+                         " (no sender eligible for this country)");
+            }
+            if (archive) archive->add(clock.wallTime(), numbers[r], ArchiveStatus::FAILED, 0, 0, "");
+            if (status) {
+                status->queued(1);
+                status->failed(clock.now());
+            }
+            report.failed++;
+        }
+
+        // Process recipients in plan order, pacing each sender at its own (ramped) rate
+        RampController ramp(config);
+        std::vector<double> next_free(config.senders.size(), clock.now());
+        for (const auto& entry : plan.entries) {
+            const std::string& number = numbers[entry.recipient];
+            uint64_t packed = packPhoneNumber(number);
+            current++;
+            if (quiet_progress && current % progress_step == 0) displayProgress(current, (int)plan.entries.size());
+            std::string position = "[" + std::to_string(current) + "/" + std::to_string(total) + "] ";
+            if (status) status->queued(1);
+
+            // Recipients may reply STOP while the campaign is running
+            if (suppression && suppression->contains(packed)) {
+                clearLine();
+                if (verbose) {
+                    log.info("skipped", {{"to", number}, {"reason", "opted_out"}},
+                             position + Color::YELLOW + "SKIPPED: " + Color::RESET + number + " (opted out)");
+                }
+                if (archive) archive->add(clock.wallTime(), number, ArchiveStatus::SKIPPED, 0, 0, "");
+                if (status) status->skipped(clock.now());
+                report.skipped++;
+                continue;
+            }
+
+            // Duplicates within this campaign count against the frequency cap too
+            if (frequency && !frequency->allowed(packed)) {
+                clearLine();
+                if (verbose) {
+                    log.info("skipped", {{"to", number}, {"reason", "frequency_cap"}},
+                             position + Color::YELLOW + "SKIPPED: " + Color::RESET + number +
+                             " (frequency cap reached)");
+                }
+                if (archive) archive->add(clock.wallTime(), number, ArchiveStatus::SKIPPED, 0, 0, "");
+                if (status) status->skipped(clock.now());
+                report.skipped++;
+                continue;
+            }
+
+            // Hold messages outside the configured send window
+            std::time_t now = clock.wallTime();
+            std::time_t opening = nextWindowOpening(now, config.send_window);
+            if (opening > now) {
+                if (status) status->setStage(StatusBoard::Stage::WINDOW_WAIT);
+                clearLine();
+                if (verbose) {
+                    log.info("window_wait", {{"seconds", std::to_string(opening - now)}},
+                             Color::YELLOW + "Outside send window. " + Color::RESET + "Resuming in " +
+                             std::to_string((opening - now) / 3600) + "h " +
+                             std::to_string(((opening - now) % 3600) / 60) + "m");
+                }
+                clock.sleepFor((double)(opening - now));
+            }
+
+            // Use the planned sender unless it is near its cap; when every sender is capped, wait for the reset
+            int sender_index = quotas.pickSender(number, entry.sender);
+            while (sender_index < 0) {
+                if (status) status->setStage(StatusBoard::Stage::QUOTA_WAIT);
+                quotas.save();
+                long wait = quotas.secondsUntilReset(number);
+                clearLine();
+                if (verbose) {
+                    log.info("quota_wait", {{"seconds", std::to_string(wait)},
+                                            {"remaining", std::to_string(total - current + 1)}},
+                             Color::YELLOW + "Quota reached for all senders. " + Color::RESET + "Resuming in " +
+                             (wait >= 86400 ? std::to_string(wait / 86400) + "d " : "") +
+                             std::to_string((wait % 86400) / 3600) + "h " + std::to_string((wait % 3600) / 60) +
+                             "m (" + std::to_string(total - current + 1) + " messages left)");
+                }
+                // Sleep through to the reset of the limit that blocks (a monthly cap can mean days)
+                clock.sleepFor((double)wait);
+                sender_index = quotas.pickSender(number, entry.sender);
+            }
+            const SenderConfig& from = config.senders[sender_index];
+            if (status) status->setStage(StatusBoard::Stage::SENDING);
+
+            // Long campaigns re-check edge latency as network paths change
+            if (edges && edges->reprobeDue()) {
+                std::string previous = edges->current();
+                edge_client->setApiBase(edges->probe());
+                if (edges->current() != previous && verbose) {
+                    clearLine();
+                    log.info("edge_switch", {{"edge", edges->current()}},
+                             Color::CYAN + "Switched API edge to " + edges->current() + Color::RESET);
+                }
+            }
+
+            // Implement rate limiting with visual feedback
+            double ready = next_free[sender_index];
+            while (clock.now() < ready) {
+                double left = ready - clock.now();
+                if (verbose && decorated()) {
+                    std::cout << "\rWaiting for rate limit... " <<
+                             std::string(std::min(11L, (long)(left * 10) + 1), '.') << "   " << std::flush;
+                }
+                clock.sleepFor(verbose && decorated() ? std::min(0.1, left) : left);
+            }
+            next_free[sender_index] = std::max(ready, clock.now()) +
+                segments / (from.mps * ramp.rateFactor());
+            clearLine();
+
+            if (verbose && decorated()) displayProgress(current, total);
+            double sent_at = clock.now();
+            int attempts = 0;
+            const std::string* body = &message;
+            if (tokens) {
+                StageProfiler::Scope render(profiler(), StageProfiler::RENDER);
+                body = &tokens->render(packed);
+            }
+            SendResult result = deliver(transport, clock, config, from.number, number, *body, &attempts);
+            report.latency.record(clock.now() - sent_at);
+            report.retries += attempts - 1;
+            if (archive) {
+                ArchiveStatus status = result.success ? ArchiveStatus::SENT
+                                     : result.ambiguous ? ArchiveStatus::UNCONFIRMED : ArchiveStatus::FAILED;
+                archive->add(clock.wallTime(), number, status, result.error_code, clock.now() - sent_at, result.sid);
+            }
+
+            // Record and display the result
+            ErrorClass outcome = classifyError(result);
+            {
+                StageProfiler::Scope reporting(profiler(), StageProfiler::REPORT);
+
+                // Clear progress bar line
+                clearLine();
+                std::string sending = position + "Sending to " + number +
+                                      (config.senders.size() > 1 ? " via " + from.number : "") + "... ";
+
+                if (result.success) {
+                    if (verbose) {
+                        log.info("sent", {{"to", number}, {"from", from.number}, {"sid", result.sid},
+                                          {"attempts", std::to_string(attempts)}},
+                                 sending + Color::GREEN + "✓ SUCCESS" + Color::RESET + " (SID: " + result.sid + ")");
+                    }
+                    quotas.record(from);
+                    if (frequency) frequency->recordSend(packed);
+                    if (journal) {
+                        // Flushed line by line: --exclude-sent relies on the journal surviving a crash
+                        std::time_t sent_time = clock.wallTime();
+                        std::tm sent_utc{};
+                        gmtime_r(&sent_time, &sent_utc);
+                        *journal << number << " " << result.sid << " "
+                                 << std::put_time(&sent_utc, "%Y-%m-%dT%H:%M:%SZ") << std::endl;
+                    }
+                    if (status) status->sent(clock.now());
+                    report.success++;
+                } else {
+                    if (verbose) {
+                        log.warn("failed", {{"to", number}, {"from", from.number}, {"class", errorClassName(outcome)},
+                                            {"status", std::to_string(result.http_status)},
+                                            {"code", std::to_string(result.error_code)},
+                                            {"attempts", std::to_string(attempts)}, {"error", result.message}},
+                                 sending + Color::RED + "✗ FAILED: " + Color::RESET + result.message);
+                    }
+                    if (status) status->failed(clock.now());
+                    report.failures_by_class[outcome]++;
+                    report.failed++;
+                }
+            }
+
+            // Slow start: widen the rate while healthy, back off or stop on error spikes
+            double previous_rate = ramp.rateFactor();
+            RampController::Action action = ramp.record(outcome);
+            if (action == RampController::Action::ABORT) {
+                clearLine();
+                std::ostringstream ratio;
+                ratio << std::fixed << std::setprecision(0) << ramp.failureRatio() * 100;
+                log.error("aborted", {{"failure_ratio", ratio.str() + "%"}, {"breakdown", ramp.breakdown()}},
+                          Color::RED + "\nAborting campaign: " + ratio.str() + "% of recent sends failed (" +
+                          ramp.breakdown() + ")" + Color::RESET);
+                report.not_attempted = (int)plan.entries.size() - current;
+                report.aborted = true;
+                if (status) status->setStage(StatusBoard::Stage::ABORTED);
+                break;
+            }
+            if (action == RampController::Action::PAUSE) {
+                report.pauses++;
+                if (status) status->setStage(StatusBoard::Stage::PAUSED);
+                if (verbose) {
+                    log.warn("paused", {{"breakdown", ramp.breakdown()},
+                                        {"seconds", std::to_string(config.ramp_pause_seconds)}},
+                             Color::YELLOW + "Error spike (" + ramp.breakdown() + "). Pausing for " +
+                             std::to_string(config.ramp_pause_seconds) + "s and restarting at " +
+                             std::to_string(config.ramp_start_percent) + "% rate" + Color::RESET);
+                }
+                clock.sleepFor(config.ramp_pause_seconds);
+            } else if (ramp.rateFactor() > previous_rate && verbose) {
+                std::string percent = std::to_string((int)(ramp.rateFactor() * 100 + 0.5));
+                log.info("ramp_up", {{"rate_percent", percent}},
+                         Color::CYAN + "Ramping up to " + percent + "% of the send rate" + Color::RESET);
+            }
+        }
+        if (quiet_progress) std::cout << "\r" << std::string(80, ' ') << "\r";
+        log.flush();
+
+        quotas.save();
+        if (frequency) frequency->sync();
+        if (status && !report.aborted) status->setStage(StatusBoard::Stage::FINISHED);
+        report.finished = clock.now();
+        return report;
+    }
+};
+
+/*
+ * @brief Formats a duration in seconds as "1d 02h 03m 04s"
+ */
+std::string formatDuration(double seconds) {
+    long total = (long)(seconds + 0.5);
+    std::ostringstream text;
+    if (total >= 86400) text << total / 86400 << "d ";
+    if (total >= 3600) text << std::setw(2) << std::setfill('0') << (total % 86400) / 3600 << "h ";
+    if (total >= 60) text << std::setw(2) << std::setfill('0') << (total % 3600) / 60 << "m ";
+    text << std::setw(2) << std::setfill('0') << total % 60 << "s";
+    return text.str();
+}
+
+/*
+ * @brief Shows the live status of a running campaign or engine
+ * Reads the status file another process publishes; never blocks or signals it.
+ * @param args Arguments after "status"
+ * @return Process exit code: 0 while running or finished, 1 if the process died
+ */
+int runStatusCommand(const std::vector<std::string>& args) {
+    auto usage = [] {
+        std::cerr << "Usage: sms_sender status [status file] [--watch SECONDS]\n";
+        return 2;
+    };
+    std::string path;
+    double watch = 0;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--watch") {
+            if (i + 1 >= args.size()) return usage();
+            try {
+                watch = std::stod(args[++i]);
+            } catch (const std::logic_error&) {
+                return usage();
+            }
+            if (watch <= 0) return usage();
+        } else if (path.empty() && args[i][0] != '-') {
+            path = args[i];
+        } else {
+            return usage();
+        }
+    }
+    if (path.empty() && std::ifstream("twilio_config.txt").good()) path = readConfig().status_file;
+    if (path.empty()) throw std::runtime_error("Error: give a status file, or set STATUS_FILE in twilio_config.txt");
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Error: no status file at " + path + " (is a campaign running here?)");
+    struct stat info{};
+    fstat(fd, &info);
+    void* data = (size_t)info.st_size >= sizeof(StatusBoard::Block)
+        ? mmap(nullptr, sizeof(StatusBoard::Block), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (data == MAP_FAILED) throw std::runtime_error("Error: " + path + " is not a status file");
+    std::unique_ptr<void, std::function<void(void*)>> mapping(
+        data, [](void* p) { munmap(p, sizeof(StatusBoard::Block)); });
+    const StatusBoard::Block& block = *(const StatusBoard::Block*)data;
+    if (std::memcmp(block.magic, StatusBoard::MAGIC, sizeof(block.magic)) != 0) {
+        throw std::runtime_error("Error: " + path + " is not a status file");
+    }
+
+    while (true) {
+        int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        pid_t pid = (pid_t)block.pid.load(std::memory_order_relaxed);
+        uint32_t stage = block.stage.load(std::memory_order_relaxed);
+        bool ended = stage == (uint32_t)StatusBoard::Stage::FINISHED || stage == (uint32_t)StatusBoard::Stage::ABORTED;
+        bool alive = kill(pid, 0) == 0 || errno == EPERM;
+        uint64_t total = block.total.load(std::memory_order_relaxed);
+        uint64_t sent = block.sent.load(std::memory_order_relaxed);
+        uint64_t failed = block.failed.load(std::memory_order_relaxed);
+        uint64_t skipped = block.skipped.load(std::memory_order_relaxed);
+        uint64_t done = sent + failed + skipped;
+        int64_t eta = block.eta_seconds.load(std::memory_order_relaxed);
+
+        if (watch > 0 && logger().interactive()) std::cout << "\033[H\033[2J";
+        std::cout << Color::CYAN << "=== "
+                  << (block.mode.load(std::memory_order_relaxed) == (uint32_t)StatusBoard::Mode::CAMPAIGN ? "Campaign"
+                                                                                                           : "Engine")
+                  << " Status ===" << Color::RESET << "\n";
+        std::cout << "Process:   " << pid << " "
+                  << (alive ? Color::GREEN + "(running)" : ended ? "(exited)" : Color::RED + "(not running)")
+                  << Color::RESET << "\n";
+        std::cout << "Stage:     " << Color::YELLOW << StatusBoard::stageName(stage) << Color::RESET
+                  << (alive || ended ? "" : " when it stopped") << "\n";
+        int64_t updated_ms = block.updated_ms.load(std::memory_order_relaxed);
+        int64_t until_ms = alive && !ended ? now_ms : updated_ms;
+        std::cout << "Running:   " << formatDuration((until_ms - block.started_ms.load(std::memory_order_relaxed)) / 1000.0)
+                  << " (updated " << formatDuration((now_ms - updated_ms) / 1000.0) << " ago)\n";
+        std::cout << "Progress:  " << done;
+        if (total > 0) {
+            std::cout << " / " << total << std::fixed << std::setprecision(1) << " (" << 100.0 * done / total << "%)";
+        }
+        std::cout << "\n";
+        std::cout << Color::GREEN << "Sent:      " << sent << Color::RESET << "\n";
+        std::cout << Color::RED << "Failed:    " << failed << Color::RESET << "\n";
+        std::cout << "Skipped:   " << skipped << "\n";
+        std::cout << "In flight: " << block.in_flight.load(std::memory_order_relaxed) << "\n";
+        std::cout << "Rate:      " << std::fixed << std::setprecision(1)
+                  << block.rate_milli.load(std::memory_order_relaxed) / 1000.0 << " msg/s\n";
+        if (eta >= 0 && !ended) std::cout << "ETA:       " << formatDuration((double)eta) << "\n";
+        std::cout << std::flush;
+
+        if (watch <= 0 || ended || !alive) return alive || ended ? 0 : 1;
+        std::this_thread::sleep_for(std::chrono::duration<double>(watch));
+    }
+}
+
+/*
+ * @brief Displays the final report of a campaign run
+ */
+void printReport(const CampaignReport& report) {
+    std::cout << Color::CYAN << "\n=== Final Report ===" << Color::RESET << "\n";
+    std::cout << "Total messages: " << Color::YELLOW << report.total << Color::RESET << "\n";
+    std::cout << Color::GREEN << "✓ Successful: " << report.success << Color::RESET << "\n";
+    std::cout << Color::RED << "✗ Failed: " << report.failed << Color::RESET << "\n";
+    for (const auto& entry : report.failures_by_class) {
+        std::cout << "    " << errorClassName(entry.first) << ": " << entry.second << "\n";
+    }
+    if (report.skipped > 0) {
+        std::cout << Color::YELLOW << "- Skipped: " << report.skipped << Color::RESET << "\n";
+    }
+    if (report.not_attempted > 0) {
+        std::cout << Color::RED << "- Not attempted (campaign aborted): " << report.not_attempted
+                  << Color::RESET << "\n";
+    }
+    if (report.pauses > 0) {
+        std::cout << Color::YELLOW << "- Pauses after error spikes: " << report.pauses << Color::RESET << "\n";
+    }
+    if (report.retries > 0) {
+        std::cout << "- Retries: " << report.retries << "\n";
+    }
+
+    double elapsed = report.finished - report.started;
+    std::cout << "Duration: " << formatDuration(elapsed);
+    if (elapsed > 0) {
+        std::cout << std::fixed << std::setprecision(2) << " (" << (report.success + report.failed) / elapsed
+                  << " msg/s)";
+    }
+    std::cout << "\n";
+    if (report.latency.count() > 0) {
+        std::cout << std::fixed << std::setprecision(1) << "API latency: p50 " << report.latency.percentileMs(50)
+                  << " ms, p95 " << report.latency.percentileMs(95) << " ms, p99 "
+                  << report.latency.percentileMs(99) << " ms, max " << report.latency.maxMs() << " ms\n";
+    }
+}
+
+/*
+ * Simulated transport class
+ * Stand-in for the Twilio API in simulation mode. Each send advances the
+ * virtual clock by a lognormal latency and fails at the configured rates:
+ * invalid recipients (21211), transport errors (no HTTP response) and, when
+ * the account rate is exceeded, throttling (429/20429) from a token bucket.
+ */
+class SimulatedTransport : public Transport {
+public:
+    struct Model {
+        double latency_median_ms = 120;     // Median API latency
+        double latency_p99_ms = 600;        // 99th percentile API latency
+        double recipient_error_rate = 0.02; // Fraction of sends rejected as invalid numbers
+        double transport_error_rate = 0;    // Fraction of sends lost to network errors
+        double throttle_mps = 0;            // Account-wide rate limit, 0 for none
+        double list_lag_ms = 0;             // Delay before an accepted message shows in the message list (mock)
+    };
+
+private:
+    Clock& clock;
+    Model model;
+    std::mt19937_64 random;
+    std::lognormal_distribution<double> latency;
+    std::uniform_real_distribution<double> uniform{0.0, 1.0};
+    double tokens;
+    double refilled;
+    uint64_t next_sid = 1;
+
+public:
+    // Constructor
+    SimulatedTransport(Clock& time_source, const Model& settings, uint64_t seed)
+        : clock(time_source), model(settings), random(seed),
+          // p99 of a lognormal sits 2.326 standard deviations above the median
+          latency(std::log(settings.latency_median_ms / 1000.0),
+                  std::max(1e-6, std::log(std::max(settings.latency_p99_ms, settings.latency_median_ms) /
+                                          settings.latency_median_ms) / 2.326)),
+          tokens(settings.throttle_mps), refilled(time_source.now()) {}
+
+    SendResult send(const std::string&, const std::string&, const std::string&) override {
+        clock.sleepFor(latency(random));
+
+        if (model.throttle_mps > 0) {
+            double now = clock.now();
+            tokens = std::min(model.throttle_mps, tokens + (now - refilled) * model.throttle_mps);
+            refilled = now;
+            if (tokens < 1) return {false, "Too Many Requests", "", 429, 20429};
+            tokens -= 1;
+        }
+
+        double roll = uniform(random);
+        if (roll < model.transport_error_rate) {
+            return {false, "Connection failed: Couldn't connect to server", "", 0, 0, CURLE_COULDNT_CONNECT};
+        }
+        if (roll < model.transport_error_rate + model.recipient_error_rate) {
+            return {false, "The 'To' number is not a valid phone number.", "", 400, 21211};
+        }
+
+        char sid[40];
+        std::snprintf(sid, sizeof(sid), "SMsim%029llu", (unsigned long long)next_sid++);
+        return {true, "Message sent successfully", sid, 201, 0};
+    }
+};
+
+/*
+ * Send recording format
+ * "SMSREC01" followed by one 16-byte record per send. Response messages are
+ * interned: a record whose message index equals the number of messages seen so
+ * far is followed by the new message (uint16 length, then the bytes).
+ */
+namespace SendRecording {
+    const char MAGIC[8] = {'S', 'M', 'S', 'R', 'E', 'C', '0', '1'};
+
+    struct Record {
+        uint32_t latency_us;
+        uint16_t http_status;
+        uint8_t flags;          // SUCCESS and AMBIGUOUS bits
+        uint8_t curl_code;
+        uint32_t error_code;
+        uint32_t message_index;
+    };
+    static_assert(sizeof(Record) == 16, "record layout must stay compact");
+    const uint8_t SUCCESS = 1;
+    const uint8_t AMBIGUOUS = 2;
+
+    /*
+     * @brief Masks phone numbers and other long digit runs in a response message
+     */
+    std::string redact(const std::string& text) {
+        std::string out;
+        size_t i = 0;
+        while (i < text.size()) {
+            size_t j = i;
+            while (j < text.size() && (std::isdigit((unsigned char)text[j]) || (j > i && text[j] == ' '))) j++;
+            while (j > i && text[j - 1] == ' ') j--;
+            size_t digits = (size_t)std::count_if(text.begin() + i, text.begin() + j,
+                                                  [](char c) { return std::isdigit((unsigned char)c); });
+            if (digits >= 7) {
+                if (!out.empty() && out.back() == '+') out.pop_back();
+                out += "<number>";
+                i = j;
+            } else {
+                out += text[i++];
+            }
+        }
+        return out;
+    }
+}
+
+/*
+ * Recording transport class
+ * Decorator that passes sends through to another transport and records the
+ * latency and outcome of each one. Phone numbers are masked in recorded
+ * messages and message SIDs are not kept, so recordings of production runs
+ * can be shared for performance work.
+ */
+class RecordingTransport : public Transport {
+private:
+    Transport& inner;
+    Clock& clock;
+    std::ofstream file;
+    std::map<std::string, uint32_t> messages;
+    size_t recorded = 0;
+
+public:
+    // Constructor
+    RecordingTransport(Transport& wrapped, Clock& time_source, const std::string& path)
+        : inner(wrapped), clock(time_source), file(path, std::ios::binary | std::ios::trunc) {
+        if (!file.is_open()) {
+            throw std::runtime_error("Error: cannot create recording " + path);
+        }
+        file.write(SendRecording::MAGIC, sizeof(SendRecording::MAGIC));
+    }
+
+    SendResult send(const std::string& from, const std::string& to, const std::string& body) override {
+        double started = clock.now();
+        SendResult result = inner.send(from, to, body);
+        double latency = clock.now() - started;
+
+        std::string message = SendRecording::redact(result.message).substr(0, 65535);
+        auto interned = messages.emplace(message, (uint32_t)messages.size());
+        SendRecording::Record record{};
+        record.latency_us = (uint32_t)std::min(4.0e9, std::max(0.0, latency * 1e6));
+        record.http_status = (uint16_t)result.http_status;
+        record.flags = (result.success ? SendRecording::SUCCESS : 0) |
+                       (result.ambiguous ? SendRecording::AMBIGUOUS : 0);
+        record.curl_code = (uint8_t)result.curl_code;
+        record.error_code = (uint32_t)result.error_code;
+        record.message_index = interned.first->second;
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        if (interned.second) {
+            uint16_t length = (uint16_t)message.size();
+            file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            file.write(message.data(), length);
+        }
+        recorded++;
+        return result;
+    }
+
+    int reconcile(const std::string& from, const std::string& to, const std::string& body,
+                  double since, std::string& sid) override {
+        return inner.reconcile(from, to, body, since, sid);
+    }
+
+    size_t size() const { return recorded; }
+};
+
+/*
+ * Replay transport class
+ * Serves the outcomes of a recording in order, advancing the clock by each
+ * recorded latency, so the dispatcher sees production-shaped traffic without a
+ * network. Campaigns longer than the recording wrap around to its start.
+ */
+class ReplayTransport : public Transport {
+private:
+    Clock& clock;
+    std::vector<SendRecording::Record> records;
+    std::vector<std::string> messages;
+    size_t next = 0;
+    uint64_t next_sid = 1;
+
+public:
+    // Constructor
+    ReplayTransport(Clock& time_source, const std::string& path) : clock(time_source) {
+        std::ifstream file(path, std::ios::binary);
+        char magic[sizeof(SendRecording::MAGIC)];
+        if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, SendRecording::MAGIC, sizeof(magic)) != 0) {
+            throw std::runtime_error("Error: " + path + " is not a send recording");
+        }
+        SendRecording::Record record;
+        while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            if (record.message_index == messages.size()) {
+                uint16_t length = 0;
+                file.read(reinterpret_cast<char*>(&length), sizeof(length));
+                std::string message(length, '\0');
+                file.read(&message[0], length);
+                messages.push_back(message);
+            }
+            if (!file || record.message_index >= messages.size()) {
+                throw std::runtime_error("Error: recording " + path + " is truncated or corrupt");
+            }
+            records.push_back(record);
+        }
+        if (records.empty()) {
+            throw std::runtime_error("Error: recording " + path + " holds no sends");
+        }
+    }
+
+    SendResult send(const std::string&, const std::string&, const std::string&) override {
+        const SendRecording::Record& record = records[next];
+        next = (next + 1) % records.size();
+        clock.sleepFor(record.latency_us / 1e6);
+
+        SendResult result{(record.flags & SendRecording::SUCCESS) != 0, messages[record.message_index], "",
+                          record.http_status, (int)record.error_code, record.curl_code,
+                          (record.flags & SendRecording::AMBIGUOUS) != 0};
+        if (result.success) {
+            char sid[40];
+            std::snprintf(sid, sizeof(sid), "SMreplay%026llu", (unsigned long long)next_sid++);
+            result.sid = sid;
+        }
+        return result;
+    }
+
+    size_t size() const { return records.size(); }
+};
+
+/*
+ * Mock Twilio server class
+ * Local stand-in for the Messages API used by the benchmark and the soak test.
+ * It answers the same requests as Twilio with the behaviour of a
+ * SimulatedTransport model: lognormal response delays, invalid-recipient and
+ * server errors, and 429s once the account rate is exceeded. It keeps a ledger
+ * of accepted messages, which also serves the message-list lookups used to
+ * reconcile ambiguous sends (each message appears there only list_lag_ms after
+ * it was accepted), and can be switched into a fault mode:
+ *
+ *   reset      TCP reset, half of them after the message was accepted
+ *   tls        handshake-style garbage instead of a response (not accepted)
+ *   slow       accepted, but answered long after any client timeout
+ *   truncated  accepted, answered with a cut-off JSON body
+ *   5xx        503 Service Unavailable (not accepted)
+ *   429        every send throttled (not accepted)
+ *
+ * POST /__fault with "fault=<mode>" switches modes and GET /__ledger returns
+ * the number of accepted messages per recipient, so a test driver in another
+ * process can control and audit the mock. Lookups and admin requests are
+ * never faulted.
+ */
+class MockTwilioServer {
+public:
+    enum class Fault { NONE, RESET, TLS_FAILURE, SLOW, TRUNCATED, SERVER_ERRORS, THROTTLE_STORM };
+
+    /*
+     * @brief Parses a fault name as used by /__fault
+     * @throws std::runtime_error for unknown names
+     */
+    static Fault parseFault(const std::string& name) {
+        if (name == "none") return Fault::NONE;
+        if (name == "reset") return Fault::RESET;
+        if (name == "tls") return Fault::TLS_FAILURE;
+        if (name == "slow") return Fault::SLOW;
+        if (name == "truncated") return Fault::TRUNCATED;
+        if (name == "5xx") return Fault::SERVER_ERRORS;
+        if (name == "429") return Fault::THROTTLE_STORM;
+        throw std::runtime_error("Unknown fault: " + name);
+    }
+
+private:
+    /*
+     * Structure to hold an accepted message
+     */
+    struct Accepted {
+        std::string sid;
+        std::string from;
+        std::string body;
+        std::time_t created;
+        std::chrono::steady_clock::time_point listed;   // When lookups start to see it
+    };
+
+    SimulatedTransport::Model model;
+    double slow_seconds;        // Delay of responses in slow mode
+    std::mt19937_64 random;
+    std::lognormal_distribution<double> latency;
+    std::uniform_real_distribution<double> uniform{0.0, 1.0};
+    double tokens;
+    std::chrono::steady_clock::time_point refilled = std::chrono::steady_clock::now();
+    uint64_t next_sid = 1;
+    Fault fault = Fault::NONE;
+    std::map<std::string, std::vector<Accepted>> ledger;    // Accepted messages by recipient
+    HttpServer server;
+
+    static HttpServer::Response reply(int status, const std::string& body) {
+        HttpServer::Response response;
+        response.status = status;
+        response.content_type = "application/json";
+        response.body = body;
+        return response;
+    }
+
+    std::string accept(const std::map<std::string, std::string>& form) {
+        char sid[40];
+        std::snprintf(sid, sizeof(sid), "SMmock%028llu", (unsigned long long)next_sid++);
+        auto field = [&](const char* name) {
+            auto it = form.find(name);
+            return it == form.end() ? std::string() : it->second;
+        };
+        auto listed = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(model.list_lag_ms / 1000.0));
+        ledger[field("To")].push_back({sid, field("From"), field("Body"), std::time(nullptr), listed});
+        return sid;
+    }
+
+    HttpServer::Response listMessages(const std::string& query) {
+        auto params = parseFormBody(query);
+        json messages = json::array();
+        auto found = ledger.find(params["To"]);
+        if (found != ledger.end()) {
+            auto now = std::chrono::steady_clock::now();
+            for (auto it = found->second.rbegin(); it != found->second.rend(); ++it) {
+                if (!params["From"].empty() && it->from != params["From"]) continue;
+                if (it->listed > now) continue;     // Like Twilio's list, lags behind accepted sends
+                std::tm created{};
+                gmtime_r(&it->created, &created);
+                char date[40];
+                std::strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S +0000", &created);
+                messages.push_back({{"sid", it->sid}, {"from", it->from}, {"to", params["To"]},
+                                    {"body", it->body}, {"date_created", date}});
+            }
+        }
+        return reply(200, json{{"messages", messages}}.dump());
+    }
+
+    // Called on the server thread only, so the model and ledger need no locking
+    HttpServer::Response handle(const HttpServer::Request& request) {
+        size_t query_start = request.path.find('?');
+        std::string path = request.path.substr(0, query_start);
+        std::string query = query_start == std::string::npos ? "" : request.path.substr(query_start + 1);
+
+        if (path == "/__fault" && request.method == "POST") {
+            fault = parseFault(parseFormBody(request.body)["fault"]);
+            return reply(200, "{}");
+        }
+        if (path == "/__ledger") {
+            json counts = json::object();
+            for (const auto& entry : ledger) counts[entry.first] = entry.second.size();
+            return reply(200, counts.dump());
+        }
+        bool messages_path = path.size() >= 14 && path.compare(path.size() - 14, 14, "/Messages.json") == 0;
+        if (!messages_path || (request.method != "POST" && request.method != "GET")) {
+            return reply(404, "{\"code\": 20404, \"message\": \"The requested resource was not found\"}");
+        }
+
+        HttpServer::Response response;
+        if (request.method == "GET") {
+            response = listMessages(query);
+            response.delay = latency(random);
+            return response;
+        }
+
+        auto form = parseFormBody(request.body);
+        switch (fault) {
+            case Fault::RESET:
+                if (uniform(random) < 0.5) accept(form);
+                response.reset = true;
+                return response;
+            case Fault::TLS_FAILURE:
+                // A TLS alert record (handshake failure) where an HTTP response should be
+                response.raw = true;
+                response.body = std::string("\x15\x03\x03\x00\x02\x02\x28", 7);
+                return response;
+            case Fault::SLOW:
+                response = reply(201, "{\"sid\": \"" + accept(form) + "\", \"status\": \"queued\"}");
+                response.delay = slow_seconds;
+                return response;
+            case Fault::TRUNCATED:
+                response = reply(201, "{\"sid\": \"" + accept(form) + "\", \"stat");
+                response.delay = latency(random);
+                return response;
+            case Fault::SERVER_ERRORS:
+                return reply(503, "{\"code\": 20503, \"message\": \"Service Unavailable\"}");
+            case Fault::THROTTLE_STORM:
+                return reply(429, "{\"code\": 20429, \"message\": \"Too Many Requests\"}");
+            case Fault::NONE:
+                break;
+        }
+        response.delay = latency(random);
+
+        if (model.throttle_mps > 0) {
+            auto now = std::chrono::steady_clock::now();
+            tokens = std::min(model.throttle_mps,
+                              tokens + std::chrono::duration<double>(now - refilled).count() * model.throttle_mps);
+            refilled = now;
+            if (tokens < 1) {
+                return reply(429, "{\"code\": 20429, \"message\": \"Too Many Requests\"}");
+            }
+            tokens -= 1;
+        }
+
+        double roll = uniform(random);
+        double delay = response.delay;
+        if (roll < model.transport_error_rate) {
+            response = reply(503, "{\"code\": 20503, \"message\": \"Service Unavailable\"}");
+        } else if (roll < model.transport_error_rate + model.recipient_error_rate) {
+            response = reply(400, "{\"code\": 21211, \"message\": \"The 'To' number is not a valid phone number.\"}");
+        } else {
+            response = reply(201, "{\"sid\": \"" + accept(form) + "\", \"status\": \"queued\"}");
+        }
+        response.delay = delay;
+        return response;
+    }
+
+public:
+    // Constructor
+    MockTwilioServer(const SimulatedTransport::Model& settings, uint64_t seed, double slow_response_seconds = 60)
+        : model(settings), slow_seconds(slow_response_seconds), random(seed),
+          latency(std::log(settings.latency_median_ms / 1000.0),
+                  std::max(1e-6, std::log(std::max(settings.latency_p99_ms, settings.latency_median_ms) /
+                                          settings.latency_median_ms) / 2.326)),
+          tokens(settings.throttle_mps),
+          server([this](const HttpServer::Request& request) { return handle(request); }) {}
+
+    void start(int port = 0) { server.start("127.0.0.1", port); }
+    int port() const { return server.port(); }
+};
+
+/*
+ * @brief Runs a campaign against the simulated transport on a virtual clock
+ * Uses twilio_config.txt when present (senders, quotas, windows, ramp) but never
+ * touches its state files: quotas stay in memory and the frequency store lives
+ * in a temporary file. Days of sending complete in seconds, and a given seed
+ * always produces the same report.
+ * @param args Arguments after "simulate"
+ * @return Process exit code
+ */
+int runSimulateCommand(const std::vector<std::string>& args) {
+    auto usage = [] {
+        std::cerr << "Usage: sms_sender simulate [--recipients N | --numbers <file>] [--message <text>]\n"
+                  << "         [--latency-ms M] [--latency-p99-ms M] [--error-rate R]\n"
+                  << "         [--transport-error-rate R] [--throttle-mps N] [--mps N] [--seed S]\n"
+                  << "         [--replay <recording>] [--record <recording>]\n";
+        return 2;
+    };
+
+    size_t recipients = 1000;
+    std::string numbers_file;
+    std::string message = "Simulated campaign message";
+    double mps = 0;
+    uint64_t seed = 1;
+    std::string replay_file;
+    std::string record_file;
+    SimulatedTransport::Model model;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i + 1 >= args.size()) return usage();
+        const std::string& option = args[i];
+        const std::string& value = args[++i];
+        try {
+            if (option == "--recipients") recipients = std::stoul(value);
+            else if (option == "--numbers") numbers_file = value;
+            else if (option == "--message") message = value;
+            else if (option == "--latency-ms") model.latency_median_ms = std::stod(value);
+            else if (option == "--latency-p99-ms") model.latency_p99_ms = std::stod(value);
+            else if (option == "--error-rate") model.recipient_error_rate = std::stod(value);
+            else if (option == "--transport-error-rate") model.transport_error_rate = std::stod(value);
+            else if (option == "--throttle-mps") model.throttle_mps = std::stod(value);
+            else if (option == "--mps") mps = std::stod(value);
+            else if (option == "--seed") seed = std::stoull(value);
+            else if (option == "--replay") replay_file = value;
+            else if (option == "--record") record_file = value;
+            else return usage();
+        } catch (const std::logic_error&) {
+            return usage();
+        }
+    }
+    if (model.latency_median_ms <= 0) return usage();
+
+    TwilioConfig config;
+    if (std::ifstream("twilio_config.txt").good()) {
+        config = readConfig();
+    } else {
+        SenderConfig primary;
+        primary.number = "+15005550006";
+        config.senders.push_back(primary);
+    }
+    if (mps > 0) {
+        for (auto& sender : config.senders) sender.mps = mps;
+    }
+    config.quota_file.clear();
+
+    // Recipients come from a file, or are synthesized in the +1 200 range
+    std::vector<std::string> numbers;
+    if (!numbers_file.empty()) {
+        PackedList list(numbers_file);
+        numbers.reserve(list.size());
+        for (size_t i = 0; i < list.size(); ++i) numbers.push_back(unpackPhoneNumber(list.data()[i]));
+    } else {
+        numbers.reserve(recipients);
+        char number[24];
+        for (size_t i = 0; i < recipients; ++i) {
+            std::snprintf(number, sizeof(number), "+1%010zu", (size_t)2000000000 + i);
+            numbers.push_back(number);
+        }
+    }
+    if (numbers.empty()) {
+        std::cerr << Color::RED << "Error: no recipients to simulate" << Color::RESET << std::endl;
+        return 1;
+    }
+
+    VirtualClock clock(systemClock().now());
+    QuotaManager quotas(config, clock);
+    std::unique_ptr<FrequencyStore> frequency;
+    std::string frequency_file;
+    if (config.frequency_cap > 0) {
+        char path[] = "/tmp/sms_sender_simXXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) throw std::runtime_error("Error: cannot create temporary frequency store");
+        close(fd);
+        unlink(path);
+        frequency_file = path;
+        config.frequency_file = frequency_file;
+        frequency.reset(new FrequencyStore(config, clock));
+    }
+
+    // Simulated runs render tokens too, under a throwaway key if none is configured
+    std::unique_ptr<TrackingTokens> tokens;
+    if (TrackingTokens::uses(message)) {
+        if (config.token_key.empty()) config.token_key = std::string(32, '0');
+        tokens.reset(new TrackingTokens(message, config));
+    }
+
+    int segments = countSegments(tokens ? tokens->preview() : message);
+    CampaignPlan plan = planCampaign(numbers, config, quotas, segments, model.latency_median_ms / 1000.0);
+    std::cout << Color::CYAN << "Simulating " << numbers.size() << " recipients across "
+              << config.senders.size() << " sender(s), " << segments << " segment(s) per message"
+              << Color::RESET << std::endl;
+
+    // Recorded traffic replaces the synthetic model when given
+    std::unique_ptr<Transport> transport;
+    if (!replay_file.empty()) {
+        ReplayTransport* replay = new ReplayTransport(clock, replay_file);
+        transport.reset(replay);
+        std::cout << "Replaying " << replay->size() << " recorded sends from " << replay_file << std::endl;
+    } else {
+        transport.reset(new SimulatedTransport(clock, model, seed));
+    }
+    std::unique_ptr<RecordingTransport> recorder;
+    if (!record_file.empty()) recorder.reset(new RecordingTransport(*transport, clock, record_file));
+
+    CampaignRunner runner(config, clock, recorder ? *recorder : *transport, quotas);
+    runner.setFrequencyStore(frequency.get());
+    runner.setTokens(tokens.get());
+    runner.setVerbose(false);
+
+    auto wall_start = std::chrono::steady_clock::now();
+    CampaignReport report = runner.run(numbers, message, plan, segments);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    printReport(report);
+    std::cout << Color::CYAN << "Simulated " << formatDuration(report.finished - report.started) << " in "
+              << std::fixed << std::setprecision(2) << wall << " s of wall time" << Color::RESET << "\n";
+
+    frequency.reset();
+    if (!frequency_file.empty()) unlink(frequency_file.c_str());
+    return 0;
+}
+
+/*
+ * @brief Compares the concurrent packed set with a mutex-protected std::unordered_set
+ * Every thread count runs the same mix: each thread inserts its share of a key
+ * stream in which every key appears twice (a dedup workload) and probes the
+ * set several times per insert, half of the probes for keys that are present.
+ * @param args Arguments after "benchmark set"
+ * @return Process exit code
+ */
+int runSetBenchmark(const std::vector<std::string>& args) {
+    auto usage = [] {
+        std::cerr << "Usage: sms_sender benchmark set [--keys N] [--probes-per-insert N] [--max-threads N]\n";
+        return 2;
+    };
+    size_t keys = 4000000;
+    size_t probes_per_insert = 4;
+    int max_threads = 64;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i + 1 >= args.size()) return usage();
+        const std::string& option = args[i];
+        const std::string& value = args[++i];
+        try {
+            if (option == "--keys") keys = std::stoull(value);
+            else if (option == "--probes-per-insert") probes_per_insert = std::stoull(value);
+            else if (option == "--max-threads") max_threads = std::stoi(value);
+            else return usage();
+        } catch (const std::logic_error&) {
+            return usage();
+        }
+    }
+    if (keys < 2 || max_threads < 1) return usage();
+
+    // Inserts: keys / 2 distinct numbers, each twice, shuffled; probes: half of them hits
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> distinct(keys / 2);
+    for (auto& key : distinct) key = 10000000000ULL + rng() % 90000000000000ULL;
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    std::vector<uint64_t> inserts(distinct.begin(), distinct.end());
+    inserts.insert(inserts.end(), distinct.begin(), distinct.end());
+    std::shuffle(inserts.begin(), inserts.end(), rng);
+    std::vector<uint64_t> probes(inserts.size() * probes_per_insert);
+    for (auto& key : probes) key = rng() % 2 ? distinct[rng() % distinct.size()] : 100000000000000ULL + rng() % (1ULL << 40);
+
+    std::cout << Color::CYAN << "=== Concurrent Set Benchmark ===" << Color::RESET << "\n"
+              << inserts.size() << " inserts (" << distinct.size() << " distinct), " << probes.size()
+              << " probes, " << std::thread::hardware_concurrency() << " hardware threads\n\n";
+    std::cout << std::left << std::setw(9) << "Threads" << std::setw(20) << "lock-free (Mops/s)"
+              << std::setw(20) << "batched (Mops/s)" << std::setw(22) << "mutex+unordered_set" << "Speedup\n";
+
+    // Runs body(thread, begin, end) over the key stream on n threads; returns Mops/s
+    auto run = [&](int n, const std::function<size_t(size_t, size_t)>& body, size_t& added) {
+        std::vector<std::thread> threads;
+        std::vector<size_t> counts(n, 0);
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < n; ++t) {
+            threads.emplace_back([&, t] {
+                counts[t] = body(inserts.size() * t / n, inserts.size() * (t + 1) / n);
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        added = 0;
+        for (size_t c : counts) added += c;
+        return (inserts.size() + probes.size()) / seconds / 1e6;
+    };
+
+    bool exact = true;
+    std::atomic<size_t> probe_hits{0};      // Keeps the probes from being optimized away
+    for (int n = 1; n <= max_threads; n *= 2) {
+        size_t added_free = 0, added_batch = 0, added_locked = 0;
+
+        ConcurrentPackedSet free_set;
+        double free_rate = run(n, [&](size_t begin, size_t end) {
+            size_t added = 0, hits = 0;
+            for (size_t i = begin; i < end; ++i) {
+                added += free_set.insert(inserts[i]);
+                for (size_t p = i * probes_per_insert; p < (i + 1) * probes_per_insert; ++p) {
+                    hits += free_set.contains(probes[p]);
+                }
+            }
+            probe_hits += hits;
+            return added;
+        }, added_free);
+
+        ConcurrentPackedSet batch_set;
+        double batch_rate = run(n, [&](size_t begin, size_t end) {
+            const size_t CHUNK = 256;
+            std::vector<uint8_t> found(CHUNK * probes_per_insert);
+            size_t added = 0, hits = 0;
+            for (size_t i = begin; i < end; i += CHUNK) {
+                size_t count = std::min(CHUNK, end - i);
+                added += batch_set.insertBatch(&inserts[i], count);
+                batch_set.containsBatch(&probes[i * probes_per_insert], count * probes_per_insert, found.data());
+                for (size_t f = 0; f < count * probes_per_insert; ++f) hits += found[f];
+            }
+            probe_hits += hits;
+            return added;
+        }, added_batch);
+
+        std::unordered_set<uint64_t> locked_set;
+        std::mutex locked_mutex;
+        double locked_rate = run(n, [&](size_t begin, size_t end) {
+            size_t added = 0, hits = 0;
+            for (size_t i = begin; i < end; ++i) {
+                {
+                    std::lock_guard<std::mutex> lock(locked_mutex);
+                    added += locked_set.insert(inserts[i]).second;
+                }
+                for (size_t p = i * probes_per_insert; p < (i + 1) * probes_per_insert; ++p) {
+                    std::lock_guard<std::mutex> lock(locked_mutex);
+                    hits += locked_set.count(probes[p]);
+                }
+            }
+            probe_hits += hits;
+            return added;
+        }, added_locked);
+
+        // Each distinct key must be reported new exactly once, whatever the interleaving
+        bool correct = added_free == distinct.size() && added_batch == distinct.size() &&
+                       added_locked == distinct.size() && free_set.size() == distinct.size();
+        exact = exact && correct;
+        std::cout << std::left << std::setw(9) << n << std::fixed << std::setprecision(1) << std::setw(20) << free_rate
+                  << std::setw(20) << batch_rate << std::setw(22) << locked_rate
+                  << std::setprecision(1) << std::max(free_rate, batch_rate) / locked_rate << "x"
+                  << (correct ? "" : Color::RED + "  (wrong count)" + Color::RESET) << "\n";
+    }
+    return exact ? 0 : 1;
+}
+
+/*
+ * @brief Compares the parallel radix sort with std::sort on packed numbers
+ * Sorts the same random recipient list at 1, 2, 4 … threads, keys alone and
+ * with an index payload, and checks every result against std::sort.
+ * @param args Arguments after "benchmark sort"
+ * @return Process exit code
+ */
+int runSortBenchmark(const std::vector<std::string>& args) {
+    auto usage = [] {
+        std::cerr << "Usage: sms_sender benchmark sort [--keys N] [--max-threads N]\n";
+        return 2;
+    };
+    size_t keys = 50000000;
+    int max_threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i + 1 >= args.size()) return usage();
+        const std::string& option = args[i];
+        const std::string& value = args[++i];
+        try {
+            if (option == "--keys") keys = std::stoull(value);
+            else if (option == "--max-threads") max_threads = std::stoi(value);
+            else return usage();
+        } catch (const std::logic_error&) {
+            return usage();
+        }
+    }
+    if (keys < 1 || keys > UINT32_MAX || max_threads < 1) return usage();
+
+    // Packed E.164 numbers: country code 1-999 followed by up to 12 digits
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> input(keys);
+    for (auto& key : input) key = 10000000000ULL + rng() % 90000000000000ULL;
+    auto seconds_since = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::vector<uint64_t> expected(input);
+    auto start = std::chrono::steady_clock::now();
+    std::sort(expected.begin(), expected.end());
+    double baseline = seconds_since(start);
+
+    std::cout << Color::CYAN << "=== Radix Sort Benchmark ===" << Color::RESET << "\n"
+              << keys << " packed numbers, " << std::thread::hardware_concurrency() << " hardware threads, "
+              << "std::sort " << std::fixed << std::setprecision(3) << baseline << " s\n\n";
+    std::cout << std::left << std::setw(9) << "Threads" << std::setw(16) << "keys (s)" << std::setw(18)
+              << "keys+index (s)" << std::setw(14) << "Mkeys/s" << "vs std::sort\n";
+
+    bool exact = true;
+    std::vector<uint64_t> sorted;
+    std::vector<uint32_t> index;
+    for (int n = 1; n <= max_threads; n *= 2) {
+        sorted = input;
+        start = std::chrono::steady_clock::now();
+        RadixSort::sort(sorted.data(), sorted.size(), n);
+        double keys_only = seconds_since(start);
+        bool correct = sorted == expected;
+
+        // With a payload the permutation must also be stable: equal keys keep input order
+        sorted = input;
+        index.resize(keys);
+        for (size_t i = 0; i < keys; ++i) index[i] = (uint32_t)i;
+        start = std::chrono::steady_clock::now();
+        RadixSort::sort(sorted.data(), index.data(), sorted.size(), n);
+        double with_index = seconds_since(start);
+        correct = correct && sorted == expected;
+        for (size_t i = 0; correct && i < keys; ++i) {
+            correct = input[index[i]] == sorted[i] && (i == 0 || sorted[i] != sorted[i - 1] || index[i] > index[i - 1]);
+        }
+
+        exact = exact && correct;
+        std::cout << std::left << std::setw(9) << n << std::fixed << std::setprecision(3) << std::setw(16) << keys_only
+                  << std::setw(18) << with_index << std::setprecision(1) << std::setw(14) << keys / keys_only / 1e6
+                  << baseline / keys_only << "x"
+                  << (correct ? "" : Color::RED + "  (wrong order)" + Color::RESET) << "\n";
+    }
+    return exact ? 0 : 1;
+}
+
+/*
+ * @brief Measures the effect of thread placement on per-recipient work
+ * Each worker repeatedly walks its slice of a packed recipient array, hashes
+ * every number and updates that recipient's state word, which is the
+ * memory-bound part of a large send. Without placement the arrays are
+ * initialized by the main thread (so they sit on one node) and the scheduler
+ * moves workers freely; with it, each worker is pinned and first touches its
+ * own slice, so the data it walks is on its node.
+ * @param args Arguments after "benchmark placement"
+ * @return Process exit code
+ */
+int runPlacementBenchmark(const std::vector<std::string>& args) {
+    auto usage = [] {
+        std::cerr << "Usage: sms_sender benchmark placement [--recipients N] [--threads N] [--passes N]\n";
+        return 2;
+    };
+    size_t recipients = 20000000;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    int passes = 10;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i + 1 >= args.size()) return usage();
+        const std::string& option = args[i];
+        const std::string& value = args[++i];
+        try {
+            if (option == "--recipients") recipients = std::stoull(value);
+            else if (option == "--threads") threads = std::stoull(value);
+            else if (option == "--passes") passes = std::stoi(value);
+            else return usage();
+        } catch (const std::logic_error&) {
+            return usage();
+        }
+    }
+    if (recipients < 1 || threads < 1 || passes < 1) return usage();
+
+    ThreadPlacement topology("none");
+    std::cout << Color::CYAN << "=== Thread Placement Benchmark ===" << Color::RESET << "\n"
+              << recipients << " recipients, " << threads << " threads, " << passes << " passes, "
+              << topology.nodeCount() << " NUMA node(s), " << topology.cpuCount() << " usable CPUs\n";
+    if (topology.nodeCount() == 1) {
+        std::cout << Color::YELLOW << "Single node: placement can only save migrations here" << Color::RESET << "\n";
+    }
+    std::cout << "\n" << std::left << std::setw(10) << "Placement" << std::setw(12) << "setup (s)"
+              << std::setw(12) << "walk (s)" << std::setw(14) << "Mrecipients/s" << "vs none\n";
+
+    double baseline = 0;
+    uint64_t reference = 0;
+    bool consistent = true;
+    for (const char* setting : {"none", "nodes", "cores"}) {
+        ThreadPlacement placement(setting);
+        bool placed = placement.placement() != ThreadPlacement::Mode::NONE;
+        auto slice = [&](size_t t) { return recipients * t / threads; };
+
+        // Left uninitialized so the first write decides which node holds each page
+        std::unique_ptr<uint64_t[]> numbers(new uint64_t[recipients]);
+        std::unique_ptr<uint64_t[]> state(new uint64_t[recipients]);
+        auto fill = [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                numbers[i] = 10000000000ULL + (i * 0x9E3779B97F4A7C15ULL) % 90000000000000ULL;
+                state[i] = 0;
+            }
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        if (!placed) fill(0, recipients);
+        std::vector<uint64_t> checksums(threads, 0);
+        std::atomic<size_t> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                placement.pin(t, threads);
+                if (placed) fill(slice(t), slice(t + 1));
+                ready++;
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                uint64_t sum = 0;
+                for (int pass = 0; pass < passes; ++pass) {
+                    for (size_t i = slice(t); i < slice(t + 1); ++i) {
+                        uint64_t hash = (numbers[i] ^ state[i]) * 0xFF51AFD7ED558CCDULL;
+                        state[i] = hash ^ (hash >> 33);
+                        sum += state[i] & 0xFF;
+                    }
+                }
+                checksums[t] = sum;
+            });
+        }
+        while (ready.load() < threads) std::this_thread::yield();
+        double setup = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        auto walk_start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& worker : workers) worker.join();
+        double walk = std::chrono::duration<double>(std::chrono::steady_clock::now() - walk_start).count();
+
+        // Every placement must do exactly the same work
+        uint64_t checksum = 0;
+        for (uint64_t sum : checksums) checksum += sum;
+        if (!placed) reference = checksum;
+        consistent = consistent && checksum == reference;
+        double rate = recipients * (double)passes / walk / 1e6;
+        if (!placed) baseline = rate;
+        std::cout << std::left << std::setw(10) << setting << std::fixed << std::setprecision(3) << std::setw(12)
+                  << setup << std::setw(12) << walk << std::setprecision(1) << std::setw(14) << rate
+                  << std::setprecision(2) << rate / baseline << "x"
+                  << (checksum == reference ? "" : Color::RED + "  (checksum mismatch)" + Color::RESET) << "\n";
+    }
+    return consistent ? 0 : 1;
+}
+
+int runQueueBenchmark(const std::vector<std::string>& args);     // Defined after JobQueue
+
+/*
+ * @brief Steps up offered load until latency or errors pass a threshold
+ * Runs the real Twilio client from a pool of threads against the built-in mock
+ * server (or another endpoint). Each step offers a fixed open-loop rate;
+ * latency is measured from each send's scheduled time, so queueing delay under
+ * overload is included. Reports throughput, latency, CPU and memory per step
+ * and the highest rate that was sustained.
+ * @param args Arguments after "benchmark"
+ * @return Process exit code
+ */
+int runBenchmarkCommand(const std::vector<std::string>& args) {
+    if (!args.empty() && args[0] == "set") return runSetBenchmark(std::vector<std::string>(args.begin() + 1, args.end()));
+    if (!args.empty() && args[0] == "sort") return runSortBenchmark(std::vector<std::string>(args.begin() + 1, args.end()));
+    if (!args.empty() && args[0] == "placement") {
+        return runPlacementBenchmark(std::vector<std::string>(args.begin() + 1, args.end()));
+    }
+    if (!args.empty() && args[0] == "queue") return runQueueBenchmark(std::vector<std::string>(args.begin() + 1, args.end()));
+    auto usage = [] {
+        std::cerr << "Usage: sms_sender benchmark [--concurrency N] [--start-mps N] [--step-factor F]\n"
+                  << "         [--step-seconds S] [--max-steps N] [--max-p99-ms M] [--max-error-rate R]\n"
+                  << "         [--target <url>] [--latency-ms M] [--latency-p99-ms M] [--error-rate R]\n"
+                  << "         [--server-error-rate R] [--throttle-mps N] [--seed S]\n";
+        return 2;
+    };
+
+    int concurrency = 32;
+    double rate = 20;
+    double step_factor = 1.5;
+    double step_seconds = 5;
+    int max_steps = 20;
+    double max_p99_ms = 1000;
+    double max_error_rate = 0.01;
+    std::string target;
+    uint64_t seed = 1;
+    SimulatedTransport::Model model;
+    model.latency_median_ms = 50;
+    model.latency_p99_ms = 200;
+    model.recipient_error_rate = 0;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i + 1 >= args.size()) return usage();
+        const std::string& option = args[i];
+        const std::string& value = args[++i];
+        try {
+            if (option == "--concurrency") concurrency = std::stoi(value);
+            else if (option == "--start-mps") rate = std::stod(value);
+            else if (option == "--step-factor") step_factor = std::stod(value);
+            else if (option == "--step-seconds") step_seconds = std::stod(value);
+            else if (option == "--max-steps") max_steps = std::stoi(value);
+            else if (option == "--max-p99-ms") max_p99_ms = std::stod(value);
+            else if (option == "--max-error-rate") max_error_rate = std::stod(value);
+            else if (option == "--target") target = value;
+            else if (option == "--latency-ms") model.latency_median_ms = std::stod(value);
+            else if (option == "--latency-p99-ms") model.latency_p99_ms = std::stod(value);
+            else if (option == "--error-rate") model.recipient_error_rate = std::stod(value);
+            else if (option == "--server-error-rate") model.transport_error_rate = std::stod(value);
+            else if (option == "--throttle-mps") model.throttle_mps = std::stod(value);
+            else if (option == "--seed") seed = std::stoull(value);
+            else return usage();
+        } catch (const std::logic_error&) {
+            return usage();
+        }
+    }
+    if (concurrency < 1 || rate <= 0 || step_factor <= 1 || step_seconds <= 0 || model.latency_median_ms <= 0) {
+        return usage();
+    }
+
+    std::unique_ptr<MockTwilioServer> mock;
+    if (target.empty()) {
+        mock.reset(new MockTwilioServer(model, seed));
+        mock->start();
+        target = "http://127.0.0.1:" + std::to_string(mock->port());
+    }
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    TwilioConfig config;
+    config.account_sid = "ACbenchmark";
+    config.auth_token = "benchmark";
+    config.phone_number = "+15005550006";
+    config.api_base_url = target;
+
+    std::cout << Color::CYAN << "Benchmarking " << target << " with " << concurrency << " connections, "
+              << step_seconds << " s per step" << Color::RESET << "\n\n";
+    std::cout << std::left << std::setw(10) << "offered" << std::setw(10) << "achieved" << std::setw(9) << "p50 ms"
+              << std::setw(9) << "p99 ms" << std::setw(8) << "errors" << std::setw(13) << "client cores"
+              << std::setw(12) << "msg/s/core" << std::setw(10) << "proc CPU" << "RSS MB" << std::right << "\n";
+
+    auto percent = [](double fraction, int decimals) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(decimals) << fraction * 100 << "%";
+        return text.str();
+    };
+
+    double best_rate = 0;
+    double best_per_core = 0;
+    double best_mean_ms = 0;
+    std::string stop_reason = "step limit reached";
+    for (int step = 0; step < max_steps; ++step, rate *= step_factor) {
+        uint64_t planned = std::max<uint64_t>(1, (uint64_t)(rate * step_seconds));
+        std::atomic<uint64_t> ticket{0};
+        std::vector<LatencyHistogram> histograms(concurrency);
+        std::vector<uint64_t> failures(concurrency, 0);
+        std::vector<double> cpu(concurrency, 0);
+
+        rusage usage_before;
+        getrusage(RUSAGE_SELF, &usage_before);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int w = 0; w < concurrency; ++w) {
+            workers.emplace_back([&, w] {
+                timespec cpu_start, cpu_end;
+                clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+                SMSSender client(config);
+                uint64_t i;
+                while ((i = ticket.fetch_add(1)) < planned) {
+                    auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(i / rate));
+                    std::this_thread::sleep_until(due);
+                    SendResult result = client.send(config.phone_number, "+12000000000", "benchmark");
+                    histograms[w].record(std::chrono::duration<double>(std::chrono::steady_clock::now() - due).count());
+                    ErrorClass outcome = classifyError(result);
+                    if (outcome != ErrorClass::NONE && outcome != ErrorClass::RECIPIENT) failures[w]++;
+                }
+                clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+                cpu[w] = (cpu_end.tv_sec - cpu_start.tv_sec) + (cpu_end.tv_nsec - cpu_start.tv_nsec) / 1e9;
+            });
+        }
+        for (auto& worker : workers) worker.join();
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        rusage usage_after;
+        getrusage(RUSAGE_SELF, &usage_after);
+
+        LatencyHistogram latency;
+        uint64_t failed = 0;
+        double client_cpu = 0;
+        for (int w = 0; w < concurrency; ++w) {
+            latency.merge(histograms[w]);
+            failed += failures[w];
+            client_cpu += cpu[w];
+        }
+        auto seconds = [](const timeval& t) { return t.tv_sec + t.tv_usec / 1e6; };
+        double process_cpu = seconds(usage_after.ru_utime) - seconds(usage_before.ru_utime) +
+                             seconds(usage_after.ru_stime) - seconds(usage_before.ru_stime);
+        long rss_pages = 0;
+        std::ifstream statm("/proc/self/statm");
+        statm >> rss_pages >> rss_pages;
+
+        double achieved = planned / wall;
+        double error_rate = (double)failed / planned;
+        double cores = client_cpu / wall;
+        double per_core = cores > 0 ? achieved / cores : 0;
+        std::cout << std::fixed << std::setprecision(1) << std::left
+                  << std::setw(10) << rate << std::setw(10) << achieved
+                  << std::setw(9) << latency.percentileMs(50) << std::setw(9) << latency.percentileMs(99)
+                  << std::setw(8) << percent(error_rate, 1)
+                  << std::setprecision(2) << std::setw(13) << cores << std::setprecision(0) << std::setw(12)
+                  << per_core << std::setw(10) << percent(process_cpu / wall, 0)
+                  << rss_pages * sysconf(_SC_PAGESIZE) / (1024 * 1024) << std::right << "\n";
+
+        if (latency.percentileMs(99) > max_p99_ms) {
+            stop_reason = "p99 latency above " + std::to_string((int)max_p99_ms) + " ms";
+            break;
+        }
+        if (error_rate > max_error_rate) {
+            stop_reason = "error rate above threshold";
+            break;
+        }
+        if (achieved < 0.9 * rate) {
+            stop_reason = "achieved rate fell below 90% of offered";
+            break;
+        }
+        best_rate = achieved;
+        best_per_core = per_core;
+        best_mean_ms = latency.meanMs();
+    }
+
+    std::cout << Color::CYAN << "\n=== Capacity ===" << Color::RESET << "\n";
+    if (best_rate == 0) {
+        std::cout << Color::RED << "No step was sustainable (" << stop_reason << ")" << Color::RESET << "\n";
+        return 1;
+    }
+    std::cout << "Max sustainable throughput: " << Color::GREEN << std::fixed << std::setprecision(1)
+              << best_rate << " msg/s" << Color::RESET << " (knee: " << stop_reason << " at the next step)\n";
+    std::cout << "Client efficiency at the knee: " << std::setprecision(0) << best_per_core << " msg/s per core\n";
+    // Little's law: requests in flight = throughput x mean latency
+    std::cout << "Connections in use at the knee: about " << std::setprecision(0)
+              << std::ceil(best_rate * best_mean_ms / 1000.0) << " of " << concurrency << "\n";
+    return 0;
+}
+
+/*
+ * @brief Long-running chaos test of the send pipeline
+ * Runs the mock server in a child process (so its ledger does not count
+ * towards this process's memory) and sends an open-loop stream of unique
+ * recipients through deliver() while cycling the mock through every fault
+ * mode between calm periods. Afterwards it checks that every recipient was
+ * delivered exactly once according to the mock's ledger, that throughput
+ * recovered after each fault, and that memory stayed flat.
+ * @param args Arguments after "soak"
+ * @return 0 if every check passed
+ */
+int runSoakCommand(const std::vector<std::string>& args) {
+    auto usage = [] {
+        std::cerr << "Usage: sms_sender soak [--minutes M] [--rate N] [--concurrency N] [--fault-seconds S]\n"
+                  << "         [--calm-seconds S] [--latency-ms M] [--list-lag-ms M] [--max-recovery-seconds S]\n"
+                  << "         [--seed S]\n";
+        return 2;
+    };
+
+    double minutes = 2;
+    double rate = 100;
+    int concurrency = 32;
+    double fault_seconds = 5;
+    double calm_seconds = 10;
+    double max_recovery = 0;
+    uint64_t seed = 1;
+    SimulatedTransport::Model model;
+    model.latency_median_ms = 30;
+    model.latency_p99_ms = 120;
+    model.recipient_error_rate = 0;
+    model.list_lag_ms = 300;    // Longer than one retry backoff: a single empty lookup would resend
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i + 1 >= args.size()) return usage();
+        const std::string& option = args[i];
+        const std::string& value = args[++i];
+        try {
+            if (option == "--minutes") minutes = std::stod(value);
+            else if (option == "--rate") rate = std::stod(value);
+            else if (option == "--concurrency") concurrency = std::stoi(value);
+            else if (option == "--fault-seconds") fault_seconds = std::stod(value);
+            else if (option == "--calm-seconds") calm_seconds = std::stod(value);
+            else if (option == "--latency-ms") model.latency_median_ms = std::stod(value);
+            else if (option == "--list-lag-ms") model.list_lag_ms = std::stod(value);
+            else if (option == "--max-recovery-seconds") max_recovery = std::stod(value);
+            else if (option == "--seed") seed = std::stoull(value);
+            else return usage();
+        } catch (const std::logic_error&) {
+            return usage();
+        }
+    }
+    if (minutes <= 0 || rate <= 0 || concurrency < 1 || fault_seconds <= 0 || calm_seconds <= 0 ||
+        model.list_lag_ms < 0) {
+        return usage();
+    }
+    if (max_recovery <= 0) max_recovery = calm_seconds;
+
+    // Soak settings: short timeouts so slow responses surface, and enough retries to outlast a fault
+    TwilioConfig config;
+    config.account_sid = "ACsoak";
+    config.auth_token = "soak";
+    config.phone_number = "+15005550006";
+    config.http_timeout_seconds = 2;
+    config.retry_attempts = 10;
+    config.retry_backoff_ms = 200;
+
+    // Start the mock in a child process and learn its port through a pipe
+    int port_pipe[2];
+    if (pipe(port_pipe) != 0) throw std::runtime_error("Error: cannot create pipe for the mock server");
+    pid_t parent = getpid();
+    pid_t child = fork();
+    if (child < 0) throw std::runtime_error("Error: cannot start the mock server process");
+    if (child == 0) {
+        ::close(port_pipe[0]);
+        MockTwilioServer mock(model, seed, config.http_timeout_seconds * 3.0);
+        mock.start();
+        int port = mock.port();
+        if (write(port_pipe[1], &port, sizeof(port)) != (ssize_t)sizeof(port)) _exit(1);
+        ::close(port_pipe[1]);
+        while (getppid() == parent) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        _exit(0);
+    }
+    ::close(port_pipe[1]);
+    int port = 0;
+    ssize_t received = read(port_pipe[0], &port, sizeof(port));
+    ::close(port_pipe[0]);
+    auto stop_mock = [&] {
+        kill(child, SIGTERM);
+        waitpid(child, nullptr, 0);
+    };
+    if (received != (ssize_t)sizeof(port)) {
+        stop_mock();
+        throw std::runtime_error("Error: the mock server did not start");
+    }
+    config.api_base_url = "http://127.0.0.1:" + std::to_string(port);
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    auto admin = [&](const std::string& path, const std::string& post) {
+        CURL* curl = curl_easy_init();
+        std::string body;
+        std::string url = config.api_base_url + path;
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        if (!post.empty()) curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION,
+                         +[](void* data, size_t size, size_t count, void* out) {
+                             ((std::string*)out)->append((char*)data, size * count);
+                             return size * count;
+                         });
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+        CURLcode res = curl_easy_perform(curl);
+        curl_easy_cleanup(curl);
+        if (res != CURLE_OK) throw std::runtime_error("Error: mock admin request failed: " + path);
+        return body;
+    };
+
+    // Schedule: calm, fault, calm, fault, ... cycling through every fault mode
+    const std::vector<std::string> faults = {"reset", "tls", "slow", "truncated", "5xx", "429"};
+    struct Phase {
+        std::string fault;
+        double start;
+        double end;
+    };
+    std::vector<Phase> phases;
+    double duration = minutes * 60;
+    double t = calm_seconds;
+    for (size_t f = 0; t + fault_seconds <= duration; f = (f + 1) % faults.size()) {
+        phases.push_back({faults[f], t, t + fault_seconds});
+        t += fault_seconds + calm_seconds;
+    }
+
+    // Open-loop workload of unique recipients
+    const double BUCKET = 0.1;
+    uint64_t total = (uint64_t)(rate * duration);
+    enum Outcome : uint8_t { PENDING, SENT, FAILED, UNCONFIRMED };
+    std::vector<uint8_t> outcomes(total, PENDING);
+    std::vector<std::atomic<uint32_t>> completions((size_t)((duration + 600) / BUCKET));
+    std::atomic<uint64_t> ticket{0};
+    std::atomic<uint64_t> retries{0};
+    auto recipient = [](uint64_t i) {
+        char number[24];
+        std::snprintf(number, sizeof(number), "+1%010llu", 2000000000ULL + (unsigned long long)i);
+        return std::string(number);
+    };
+
+    std::cout << Color::CYAN << "Soak test: " << total << " messages at " << rate << " msg/s for "
+              << formatDuration(duration) << ", " << phases.size() << " fault periods" << Color::RESET << "\n";
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    std::vector<std::thread> workers;
+    for (int w = 0; w < concurrency; ++w) {
+        workers.emplace_back([&] {
+            SMSSender client(config);
+            uint64_t i;
+            while ((i = ticket.fetch_add(1)) < total) {
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(i / rate)));
+                int attempts = 0;
+                SendResult result = deliver(client, systemClock(), config, config.phone_number, recipient(i),
+                                            "Soak message " + std::to_string(i), &attempts);
+                retries += attempts - 1;
+                outcomes[i] = result.success ? SENT : result.ambiguous ? UNCONFIRMED : FAILED;
+                if (result.success) completions[std::min(completions.size() - 1, (size_t)(elapsed() / BUCKET))]++;
+            }
+        });
+    }
+
+    // Drive the fault schedule and sample memory once a second
+    std::vector<long> rss;
+    auto sample_rss = [&] {
+        long pages = 0;
+        std::ifstream statm("/proc/self/statm");
+        statm >> pages >> pages;
+        rss.push_back(pages * sysconf(_SC_PAGESIZE) / 1024);
+    };
+    size_t next_phase = 0;
+    bool faulted = false;
+    while (elapsed() < duration) {
+        double now = elapsed();
+        if (!faulted && next_phase < phases.size() && now >= phases[next_phase].start) {
+            admin("/__fault", "fault=" + phases[next_phase].fault);
+            faulted = true;
+            std::cout << "\r" << formatDuration(now) << "  fault: " << std::left << std::setw(10)
+                      << phases[next_phase].fault << std::right << std::flush;
+        } else if (faulted && now >= phases[next_phase].end) {
+            admin("/__fault", "fault=none");
+            faulted = false;
+            next_phase++;
+            std::cout << "\r" << formatDuration(now) << "  fault: none      " << std::flush;
+        }
+        if (rss.size() < (size_t)now + 1) sample_rss();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    if (faulted) admin("/__fault", "fault=none");
+    for (auto& worker : workers) worker.join();
+    double finished = elapsed();
+    sample_rss();
+    std::cout << "\r" << std::string(60, ' ') << "\r";
+
+    // Audit against the mock's ledger
+    json ledger = json::parse(admin("/__ledger", ""));
+    stop_mock();
+    uint64_t sent = 0, failed = 0, unconfirmed = 0, pending = 0, duplicates = 0, unreported = 0, missing = 0;
+    for (uint64_t i = 0; i < total; ++i) {
+        auto found = ledger.find(recipient(i));
+        size_t accepted = found == ledger.end() ? 0 : found->get<size_t>();
+        if (accepted > 1) duplicates++;
+        switch (outcomes[i]) {
+            case SENT: sent++; if (accepted == 0) missing++; break;
+            case FAILED: failed++; if (accepted > 0) unreported++; break;
+            case UNCONFIRMED: unconfirmed++; break;
+            default: pending++; break;
+        }
+    }
+
+    // Recovery: time from the end of each fault until a full second of sends is back at 80% of the rate
+    auto window_rate = [&](double at) {
+        size_t first = (size_t)(at / BUCKET);
+        size_t count = (size_t)(1.0 / BUCKET);
+        uint64_t sum = 0;
+        for (size_t b = first; b < first + count && b < completions.size(); ++b) sum += completions[b];
+        return (double)sum;
+    };
+    std::cout << Color::CYAN << "\n=== Fault Recovery ===" << Color::RESET << "\n";
+    std::cout << std::left << std::setw(12) << "fault" << std::setw(10) << "at" << std::setw(18)
+              << "msg/s during" << "recovered after" << std::right << "\n";
+    bool recovered = true;
+    for (size_t p = 0; p < next_phase; ++p) {
+        const Phase& phase = phases[p];
+        double during = 0;
+        for (double at = phase.start; at < phase.end; at += BUCKET) {
+            during += completions[std::min(completions.size() - 1, (size_t)(at / BUCKET))];
+        }
+        double recovery = -1;
+        for (double at = phase.end; at < finished; at += BUCKET) {
+            if (window_rate(at) >= 0.8 * rate) {
+                recovery = at - phase.end;
+                break;
+            }
+        }
+        bool ok = recovery >= 0 && recovery <= max_recovery;
+        recovered = recovered && ok;
+        std::cout << std::left << std::setw(12) << phase.fault << std::setw(10) << formatDuration(phase.start)
+                  << std::fixed << std::setprecision(1) << std::setw(18) << during / (phase.end - phase.start)
+                  << (ok ? Color::GREEN : Color::RED);
+        if (recovery < 0) std::cout << "never";
+        else std::cout << recovery << " s";
+        std::cout << Color::RESET << std::right << "\n";
+    }
+
+    // Memory: the last third of the run against the first, after warm-up
+    size_t third = std::max<size_t>(1, rss.size() / 3);
+    long early = *std::max_element(rss.begin(), rss.begin() + third);
+    long late = *std::max_element(rss.end() - third, rss.end());
+    bool flat = late - early <= std::max(8L * 1024, early / 10);
+
+    bool exact = pending == 0 && duplicates == 0 && unreported == 0 && missing == 0 &&
+                 failed == 0 && unconfirmed == 0;
+    std::cout << Color::CYAN << "\n=== Soak Report ===" << Color::RESET << "\n";
+    std::cout << "Messages: " << total << " (sent " << sent << ", failed " << failed << ", unconfirmed "
+              << unconfirmed << ", never finished " << pending << ")\n";
+    std::cout << "Retries: " << retries << "\n";
+    std::cout << "Ledger: " << duplicates << " recipients sent twice, " << missing << " reported sent but never "
+              << "accepted, " << unreported << " accepted but reported failed\n";
+    std::cout << "Memory (RSS): " << early / 1024 << " MB early, " << late / 1024 << " MB late\n";
+    std::cout << (exact ? Color::GREEN + "✓" : Color::RED + "✗") << " Every recipient delivered exactly once"
+              << Color::RESET << "\n";
+    std::cout << (recovered ? Color::GREEN + "✓" : Color::RED + "✗") << " Throughput recovered within "
+              << max_recovery << " s of every fault" << Color::RESET << "\n";
+    std::cout << (flat ? Color::GREEN + "✓" : Color::RED + "✗") << " Memory stayed flat" << Color::RESET << "\n";
+    return exact && recovered && flat ? 0 : 1;
+}
+
+/*
+ * Durable job queue class
+ * Append-only ring of job records in a memory-mapped file. Appends are made
+ * durable by group commit: a background thread msyncs everything appended so
+ * far while new records keep arriving, and every appender waiting on that
+ * round is released at once. Completions only flip a state byte in place and
+ * advance the consumer offset (the ring's head) past the finished prefix;
+ * they are flushed with the next commit. When the ring fills up, compaction
+ * rewrites just the unfinished records into a fresh file (twice as large if
+ * they still need more than half of it). After a crash, every record that
+ * was not finished is read back. The last commit may have missed a few
+ * completions, so callers should treat recovered records as possibly sent.
+ */
+class JobQueue {
+public:
+    /*
+     * Structure to hold a record read back after a restart
+     */
+    struct Entry {
+        uint64_t seq;           // Handle for complete()
+        std::string to;
+        std::string body;
+        std::string from;       // Requested sender ("" = pick from the pool)
+        std::string sender;     // Sender chosen at dispatch, if it was dispatched
+        double submitted;       // Wall-clock submission time
+    };
+
+private:
+    /*
+     * Structure at the start of the file
+     */
+    struct Header {
+        char magic[8];          // "SMSQUE01"
+        uint64_t capacity;      // Bytes in the ring (multiple of 8)
+        uint64_t head;          // Logical offset of the oldest unfinished record
+        uint64_t tail;          // Logical offset where the next record goes
+        char padding[32];
+    };
+
+    /*
+     * Structure at the start of every record; to, from and body follow it
+     * A padding record (filling the end of the ring before a wrap) only uses
+     * size and state, so it fits in any gap of 8 bytes or more.
+     */
+    struct Record {
+        uint32_t size;          // Bytes including this header, padded to 8
+        uint8_t state;          // PENDING, DONE or PADDING
+        uint8_t reserved;
+        uint16_t to_length;
+        uint32_t checksum;      // FNV-1a of the lengths, time and payload
+        uint32_t body_length;
+        uint64_t submitted_ms;  // Wall-clock submission time
+        uint16_t from_length;
+        char sender[22];        // Sender chosen at dispatch (NUL-terminated)
+    };
+
+    enum : uint8_t { PENDING = 1, DONE = 2, PADDING = 3 };
+    static const uint64_t FINISHED = ~0ULL;
+
+    std::string path;
+    int fd = -1;
+    char* base = nullptr;
+    size_t mapped_size = 0;
+    Header* header = nullptr;
+    char* ring = nullptr;
+
+    std::mutex mutex;           // Guards everything below and the mapping's contents
+    std::mutex sync_mutex;      // Held while the mapping is msynced or replaced
+    std::condition_variable commit_needed;
+    std::condition_variable committed_ready;
+    std::deque<uint64_t> offsets;           // Logical offset per live record (FINISHED once done)
+    uint64_t first_seq = 0;     // Sequence number of offsets.front()
+    uint64_t committed_seq = 0; // Records with a lower sequence number are durable
+    uint64_t dirty_from = 0;    // Logical offset of the first byte changed since the last commit
+    bool stopping = false;
+    std::vector<Entry> recovered;
+    std::thread committer;
+
+    static uint32_t checksum(const Record* record) {
+        uint32_t hash = 2166136261u;
+        auto mix = [&](const void* data, size_t length) {
+            for (size_t i = 0; i < length; ++i) {
+                hash ^= ((const unsigned char*)data)[i];
+                hash *= 16777619u;
+            }
+        };
+        mix(&record->to_length, sizeof(record->to_length));
+        mix(&record->body_length, sizeof(record->body_length));
+        mix(&record->submitted_ms, sizeof(record->submitted_ms));
+        mix(&record->from_length, sizeof(record->from_length));
+        mix(record + 1, (size_t)record->to_length + record->from_length + record->body_length);
+        return hash;
+    }
+
+    Record* at(uint64_t offset) const { return (Record*)(ring + offset % header->capacity); }
+
+    /*
+     * @brief Maps a queue file, creating it with the given capacity if empty
+     */
+    void map(const std::string& file, uint64_t capacity) {
+        fd = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) throw std::runtime_error("Error: cannot open " + file + ": " + std::strerror(errno));
+        struct stat info{};
+        fstat(fd, &info);
+        bool fresh = info.st_size < (off_t)sizeof(Header);
+        mapped_size = fresh ? sizeof(Header) + capacity : (size_t)info.st_size;
+        if (fresh && ftruncate(fd, mapped_size) != 0) {
+            throw std::runtime_error("Error: cannot size " + file + ": " + std::strerror(errno));
+        }
+        void* memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (memory == MAP_FAILED) throw std::runtime_error("Error: cannot map " + file + ": " + std::strerror(errno));
+        base = (char*)memory;
+        header = (Header*)base;
+        ring = base + sizeof(Header);
+        if (fresh) {
+            std::memcpy(header->magic, "SMSQUE01", 8);
+            header->capacity = capacity;
+            header->head = header->tail = 0;
+        } else if (std::memcmp(header->magic, "SMSQUE01", 8) != 0 || header->capacity % 8 != 0 ||
+                   mapped_size < sizeof(Header) + header->capacity || header->tail < header->head ||
+                   header->tail - header->head > header->capacity) {
+            unmap();
+            throw std::runtime_error("Error: " + file + " is not a valid job queue");
+        }
+    }
+
+    void unmap() {
+        if (base) munmap(base, mapped_size);
+        if (fd >= 0) ::close(fd);
+        base = ring = nullptr;
+        header = nullptr;
+        fd = -1;
+    }
+
+    /*
+     * @brief Reads back the unfinished records, dropping a torn tail
+     */
+    void recover() {
+        uint64_t offset = header->head;
+        while (offset < header->tail) {
+            uint64_t physical = offset % header->capacity;
+            Record* record = at(offset);
+            if (record->state == PADDING) {
+                if (record->size != header->capacity - physical) break;
+                offset += record->size;
+                continue;
+            }
+            if (record->size < sizeof(Record) || record->size % 8 != 0 || record->size > header->tail - offset ||
+                physical + record->size > header->capacity ||
+                sizeof(Record) + (size_t)record->to_length + record->from_length + record->body_length >
+                    record->size ||
+                record->checksum != checksum(record)) {
+                break;  // Written but never committed
+            }
+            if (record->state == PENDING) {
+                const char* payload = (const char*)(record + 1);
+                recovered.push_back({first_seq + offsets.size(), std::string(payload, record->to_length),
+                                     std::string(payload + record->to_length + record->from_length,
+                                                 record->body_length),
+                                     std::string(payload + record->to_length, record->from_length),
+                                     std::string(record->sender, strnlen(record->sender, sizeof(record->sender))),
+                                     record->submitted_ms / 1000.0});
+                offsets.push_back(offset);
+            }
+            offset += record->size;
+        }
+        header->tail = offset;
+        header->head = offsets.empty() ? offset : offsets.front();
+        committed_seq = first_seq + offsets.size();
+        dirty_from = offset;
+    }
+
+    /*
+     * @brief Rewrites the unfinished records into a new file with room for needed more bytes
+     */
+    void compact(uint64_t needed) {
+        uint64_t live = 0;
+        for (uint64_t offset : offsets) {
+            if (offset != FINISHED) live += at(offset)->size;
+        }
+        uint64_t capacity = header->capacity;
+        while ((live + needed) * 2 > capacity) capacity *= 2;
+
+        std::string tmp = path + ".compact";
+        int tmp_fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (tmp_fd < 0 || ftruncate(tmp_fd, sizeof(Header) + capacity) != 0) {
+            if (tmp_fd >= 0) ::close(tmp_fd);
+            throw std::runtime_error("Error: cannot create " + tmp + ": " + std::strerror(errno));
+        }
+        size_t tmp_size = sizeof(Header) + capacity;
+        void* memory = mmap(nullptr, tmp_size, PROT_READ | PROT_WRITE, MAP_SHARED, tmp_fd, 0);
+        if (memory == MAP_FAILED) {
+            ::close(tmp_fd);
+            throw std::runtime_error("Error: cannot map " + tmp + ": " + std::strerror(errno));
+        }
+        Header* fresh = (Header*)memory;
+        std::memcpy(fresh->magic, "SMSQUE01", 8);
+        fresh->capacity = capacity;
+        uint64_t tail = 0;
+        for (uint64_t& offset : offsets) {
+            if (offset == FINISHED) continue;
+            Record* record = at(offset);
+            std::memcpy((char*)memory + sizeof(Header) + tail, record, record->size);
+            offset = tail;
+            tail += record->size;
+        }
+        fresh->head = 0;
+        fresh->tail = tail;
+        msync(memory, tmp_size, MS_SYNC);
+
+        std::lock_guard<std::mutex> sync(sync_mutex);
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            munmap(memory, tmp_size);
+            ::close(tmp_fd);
+            throw std::runtime_error("Error: cannot replace " + path + ": " + std::strerror(errno));
+        }
+        // Until the directory is synced a crash can bring back the old file, without the records appended next
+        syncDirectory(path);
+        unmap();
+        fd = tmp_fd;
+        base = (char*)memory;
+        mapped_size = tmp_size;
+        header = fresh;
+        ring = base + sizeof(Header);
+        header->head = offsets.empty() ? tail : offsets.front();
+
+        // The new file was synced as a whole, so everything appended so far is durable
+        committed_seq = first_seq + offsets.size();
+        dirty_from = tail;
+        committed_ready.notify_all();
+    }
+
+    /*
+     * @brief Flushes the header and the ring bytes between two logical offsets
+     * Must be called with sync_mutex held. After a compaction the range may
+     * be stale, which is harmless: the new file was synced as a whole.
+     */
+    void syncRange(uint64_t from, uint64_t to) {
+        static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        auto flush = [&](size_t begin, size_t end) {
+            begin = begin / page * page;
+            end = std::min(mapped_size, (end + page - 1) / page * page);
+            if (begin < end) msync(base + begin, end - begin, MS_SYNC);
+        };
+        flush(0, sizeof(Header));
+        uint64_t length = std::min(to - from, header->capacity);
+        if (length == 0) return;
+        size_t first = sizeof(Header) + from % header->capacity;
+        size_t wrap = sizeof(Header) + header->capacity;
+        if (first + length <= wrap) {
+            flush(first, first + length);
+        } else {
+            flush(first, wrap);
+            flush(sizeof(Header), sizeof(Header) + (first + length - wrap));
+        }
+    }
+
+    void commitLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            commit_needed.wait(lock, [&] { return stopping || committed_seq < first_seq + offsets.size(); });
+            uint64_t target = first_seq + offsets.size();
+            if (committed_seq >= target && stopping) return;
+            // Only what changed since the last round: new records, and completions behind them
+            uint64_t from = std::min(dirty_from, header->tail);
+            uint64_t to = header->tail;
+            dirty_from = to;
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> sync(sync_mutex);
+                syncRange(from, to);
+            }
+            lock.lock();
+            committed_seq = std::max(committed_seq, target);
+            committed_ready.notify_all();
+        }
+    }
+
+public:
+    // Constructor: opens (or creates) the queue and reads back unfinished records
+    JobQueue(const std::string& file, uint64_t initial_capacity = 16 << 20) : path(file) {
+        map(file, initial_capacity);
+        recover();
+        committer = std::thread(&JobQueue::commitLoop, this);
+    }
+
+    // Flushes completions and closes the file
+    ~JobQueue() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        commit_needed.notify_one();
+        committer.join();
+        msync(base, mapped_size, MS_SYNC);
+        unmap();
+    }
+
+    JobQueue(const JobQueue&) = delete;
+    JobQueue& operator=(const JobQueue&) = delete;
+
+    /*
+     * @brief Returns the unfinished records found when the queue was opened (once)
+     */
+    std::vector<Entry> takeRecovered() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::move(recovered);
+    }
+
+    /*
+     * @brief Appends a job; it is durable once commit() returns for its sequence number
+     * @param submitted Wall-clock submission time
+     * @return Sequence number of the record
+     * @throws std::runtime_error if the queue cannot grow
+     */
+    uint64_t append(const std::string& to, const std::string& body, const std::string& from, double submitted) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t size = (sizeof(Record) + to.size() + from.size() + body.size() + 7) & ~7ULL;
+        uint64_t gap = header->capacity - header->tail % header->capacity;
+        uint64_t padding = gap < size ? gap : 0;
+        if (header->tail + padding + size - header->head > header->capacity) {
+            compact(size);
+            gap = header->capacity - header->tail % header->capacity;
+            padding = gap < size ? gap : 0;
+        }
+        if (padding > 0) {
+            Record* filler = at(header->tail);
+            filler->size = (uint32_t)padding;
+            filler->state = PADDING;
+            header->tail += padding;
+        }
+
+        Record* record = at(header->tail);
+        std::memset(record, 0, sizeof(Record));
+        record->size = (uint32_t)size;
+        record->state = PENDING;
+        record->to_length = (uint16_t)to.size();
+        record->from_length = (uint16_t)from.size();
+        record->body_length = (uint32_t)body.size();
+        record->submitted_ms = (uint64_t)(submitted * 1000.0);
+        char* payload = (char*)(record + 1);
+        std::memcpy(payload, to.data(), to.size());
+        std::memcpy(payload + to.size(), from.data(), from.size());
+        std::memcpy(payload + to.size() + from.size(), body.data(), body.size());
+        record->checksum = checksum(record);
+
+        offsets.push_back(header->tail);
+        header->tail += size;
+        return first_seq + offsets.size() - 1;
+    }
+
+    /*
+     * @brief Waits until every record up to seq is on disk
+     */
+    void commit(uint64_t seq) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (committed_seq > seq) return;
+        commit_needed.notify_one();
+        committed_ready.wait(lock, [&] { return committed_seq > seq; });
+    }
+
+    /*
+     * @brief Records the sender chosen for a job, for reconciliation after a crash
+     */
+    void dispatched(uint64_t seq, const std::string& sender) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t offset = offsets[seq - first_seq];
+        if (offset == FINISHED) return;
+        std::snprintf(at(offset)->sender, sizeof(Record::sender), "%s", sender.c_str());
+        dirty_from = std::min(dirty_from, offset);
+    }
+
+    /*
+     * @brief Marks a job finished and moves the consumer offset past the finished prefix
+     */
+    void complete(uint64_t seq) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t& offset = offsets[seq - first_seq];
+        if (offset == FINISHED) return;
+        at(offset)->state = DONE;
+        dirty_from = std::min(dirty_from, offset);
+        offset = FINISHED;
+        while (!offsets.empty() && offsets.front() == FINISHED) {
+            offsets.pop_front();
+            first_seq++;
+        }
+        header->head = offsets.empty() ? header->tail : offsets.front();
+        committed_seq = std::max(committed_seq, first_seq);
+    }
+
+    /*
+     * @brief Number of unfinished records
+     */
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return (size_t)std::count_if(offsets.begin(), offsets.end(), [](uint64_t o) { return o != FINISHED; });
+    }
+};
+
+/*
+ * @brief Checks the durable job queue against a model, across crashes, and times group commit
+ * Three parts, all on a temporary queue file:
+ * - a model check: random appends and completions on a small ring, so it
+ *   wraps and compacts often, with periodic reopens; the unfinished records
+ *   must always match the model exactly
+ * - a crash check: a child process appends and completes batches and is
+ *   killed with SIGKILL at a random moment; every batch it had committed and
+ *   not finished must be read back intact, and nothing it never appended
+ * - submissions per second at several batch sizes, one commit per batch
+ * @param args Arguments after "benchmark queue"
+ * @return Process exit code
+ */
+int runQueueBenchmark(const std::vector<std::string>& args) {
+    auto usage = [] {
+        std::cerr << "Usage: sms_sender benchmark queue [--ops N] [--crashes N] [--seconds S] [--seed S]\n";
+        return 2;
+    };
+    long ops = 200000;
+    int crashes = 20;
+    double seconds = 1.0;
+    uint64_t seed = 1;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i + 1 >= args.size()) return usage();
+        const std::string& option = args[i];
+        const std::string& value = args[++i];
+        try {
+            if (option == "--ops") ops = std::stol(value);
+            else if (option == "--crashes") crashes = std::stoi(value);
+            else if (option == "--seconds") seconds = std::stod(value);
+            else if (option == "--seed") seed = std::stoull(value);
+            else return usage();
+        } catch (const std::logic_error&) {
+            return usage();
+        }
+    }
+    if (ops < 0 || crashes < 0 || seconds <= 0) return usage();
+
+    const char* tmpdir = std::getenv("TMPDIR");
+    std::string directory = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") + "/sms_queue.XXXXXX";
+    if (!mkdtemp(&directory[0])) throw std::runtime_error("Error: cannot create " + directory + ": " + std::strerror(errno));
+    std::string path = directory + "/queue.db";
+    auto reset = [&] {
+        std::remove(path.c_str());
+        std::remove((path + ".compact").c_str());
+    };
+    // Each record's body encodes its id, so a read-back record can be checked on its own
+    auto bodyOf = [](uint64_t id) { return "job " + std::to_string(id) + std::string(id % 97, '.'); };
+    auto idOf = [](const std::string& body, uint64_t& id) {
+        if (body.compare(0, 4, "job ") != 0) return false;
+        id = std::strtoull(body.c_str() + 4, nullptr, 10);
+        return true;
+    };
+    std::mt19937_64 rng(seed);
+    std::cout << Color::CYAN << "=== Job Queue Check ===" << Color::RESET << "\n";
+
+    // Model check: seq handles of the live queue, and the ids the model expects to read back
+    bool model_ok = true;
+    long reopens = 0;
+    {
+        reset();
+        std::unique_ptr<JobQueue> queue(new JobQueue(path, 4096));
+        std::map<uint64_t, uint64_t> live;      // seq -> id
+        uint64_t next_id = 0;
+        for (long op = 0; op < ops && model_ok; ++op) {
+            uint64_t roll = rng() % 1000;
+            if (roll < 550) {
+                uint64_t id = next_id++;
+                live[queue->append("+15550000000", bodyOf(id), id % 3 ? "" : "+15551111111", 1.0)] = id;
+                if (rng() % 8 == 0) queue->commit(live.rbegin()->first);
+            } else if (roll < 998) {
+                if (live.empty()) continue;
+                auto it = live.lower_bound(rng() % (live.rbegin()->first + 1));
+                if (it == live.end()) it = live.begin();
+                queue->complete(it->first);
+                live.erase(it);
+            } else {
+                // A clean close flushes completions, so the read-back must equal the model
+                queue.reset();
+                queue.reset(new JobQueue(path, 4096));
+                reopens++;
+                std::unordered_set<uint64_t> expected;
+                for (const auto& entry : live) expected.insert(entry.second);
+                live.clear();
+                for (const auto& entry : queue->takeRecovered()) {
+                    uint64_t id = 0;
+                    model_ok = model_ok && idOf(entry.body, id) && entry.body == bodyOf(id) && expected.erase(id) == 1;
+                    live[entry.seq] = id;
+                }
+                model_ok = model_ok && expected.empty();
+            }
+            if (op % 1024 == 0) model_ok = model_ok && queue->pending() == live.size();
+        }
+    }
+    std::cout << (model_ok ? Color::GREEN + "✓" : Color::RED + "✗") << " Model check: " << ops << " operations, "
+              << reopens << " reopens" << Color::RESET << "\n";
+
+    // Crash check: the child reports each committed id, and each id it finishes with the top bit set
+    bool crash_ok = true;
+    long acknowledged = 0, recovered_total = 0;
+    reset();
+    for (int round = 0; round < crashes && crash_ok; ++round) {
+        int fds[2];
+        if (pipe(fds) != 0) throw std::runtime_error(std::string("Error: pipe: ") + std::strerror(errno));
+        uint64_t first_id = (uint64_t)round << 32;
+        pid_t child = fork();
+        if (child == 0) {
+            ::close(fds[0]);
+            JobQueue queue(path, 1 << 16);
+            std::deque<std::pair<uint64_t, uint64_t>> open;     // seq, id
+            std::mt19937_64 child_rng(seed + round);
+            for (uint64_t id = first_id;;) {
+                uint64_t last = 0;
+                size_t batch = 1 + child_rng() % 64;
+                for (size_t k = 0; k < batch; ++k, ++id) {
+                    last = queue.append("+15550000000", bodyOf(id), "", 1.0);
+                    open.emplace_back(last, id);
+                }
+                queue.commit(last);
+                for (size_t k = open.size() - batch; k < open.size(); ++k) {
+                    if (write(fds[1], &open[k].second, sizeof(uint64_t)) != sizeof(uint64_t)) _exit(1);
+                }
+                while (open.size() > 256 || (!open.empty() && child_rng() % 2)) {
+                    // Reported before it is finished: a kill in between may leave it either way
+                    uint64_t done = open.front().second | (1ULL << 63);
+                    if (write(fds[1], &done, sizeof(done)) != sizeof(done)) _exit(1);
+                    queue.complete(open.front().first);
+                    open.pop_front();
+                }
+            }
+        }
+        ::close(fds[1]);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20 + rng() % 200));
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+
+        std::unordered_set<uint64_t> must;
+        uint64_t word;
+        while (read(fds[0], &word, sizeof(word)) == sizeof(word)) {
+            if (word >> 63) must.erase(word & ~(1ULL << 63));
+            else must.insert(word), acknowledged++;
+        }
+        ::close(fds[0]);
+
+        // Finished records may come back (completions are flushed lazily); committed open ones must
+        JobQueue queue(path, 1 << 16);
+        for (const auto& entry : queue.takeRecovered()) {
+            uint64_t id = 0;
+            crash_ok = crash_ok && idOf(entry.body, id) && entry.body == bodyOf(id) && (id >> 32) <= (uint64_t)round;
+            must.erase(id);
+            queue.complete(entry.seq);
+            recovered_total++;
+        }
+        crash_ok = crash_ok && must.empty();
+    }
+    std::cout << (crash_ok ? Color::GREEN + "✓" : Color::RED + "✗") << " Crash check: " << crashes
+              << " kills, " << acknowledged << " committed records, " << recovered_total << " read back"
+              << Color::RESET << "\n";
+
+    // Group commit: one writer, one commit per batch
+    std::cout << "\n" << std::left << std::setw(8) << "Batch" << std::setw(16) << "submissions/s" << "syncs/s\n";
+    for (size_t batch : {1, 10, 100, 1000}) {
+        reset();
+        JobQueue queue(path);
+        std::string body = bodyOf(1);
+        long submitted = 0, commits = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        while (elapsed < seconds) {
+            uint64_t last = 0;
+            for (size_t k = 0; k < batch; ++k) last = queue.append("+15550000000", body, "", 1.0);
+            queue.commit(last);
+            for (uint64_t seq = last + 1 - batch; seq <= last; ++seq) queue.complete(seq);
+            submitted += (long)batch;
+            commits++;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::cout << std::left << std::setw(8) << batch << std::fixed << std::setprecision(0) << std::setw(16)
+                  << submitted / elapsed << commits / elapsed << "\n";
+    }
+    reset();
+    rmdir(directory.c_str());
+    return model_ok && crash_ok ? 0 : 1;
+}
+
+/*
+ * Send engine class
+ * The sending core behind the library interface (sms_sender.h) and the stream
+ * command: a long-lived pool of worker threads, each with its own SMSSender
+ * whose connection is opened at startup and refreshed while idle, fed from
+ * one queue. A message reaching an idle worker goes straight to the wire; it
+ * only waits when its sender is already at its rate. Messages are validated, checked
+ * against the suppression list, assigned a sender within its quotas, paced at
+ * that sender's rate and sent with retries and reconciliation, exactly like
+ * a campaign; each completion is reported through the batch's callback.
+ */
+class SendEngine {
+private:
+    /*
+     * Structure to hold a queued message
+     */
+    struct Job {
+        std::string to;         // Normalized recipient, or the input if invalid
+        std::string body;
+        std::string from;       // Requested sender ("" = pick from the pool)
+        NumberRejection rejection;
+        void* user_data;
+        sms_callback callback;
+        void* context;
+        double submitted;       // Steady-clock seconds
+        uint64_t record = NO_RECORD;        // Sequence number in the durable queue
+        double submitted_wall = 0;          // Wall-clock submission time, for reconciliation
+        std::string sender;     // Sender recorded before a crash ("" if unknown)
+        bool recovered = false; // Read back from the durable queue after a restart
+    };
+
+    static const uint64_t NO_RECORD = ~0ULL;
+
+    TwilioConfig config;
+    QuotaManager quotas;
+    SuppressionList suppression;
+    std::unique_ptr<JobQueue> durable;      // Survives restarts when QUEUE_FILE is set
+    std::unique_ptr<ResultArchive::Writer> archive;     // Set when ARCHIVE_FILE is set
+    std::unique_ptr<StatusBoard> status;    // Set when STATUS_FILE is set
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable idle;
+    ThreadPlacement placement;
+    std::vector<std::deque<Job>> queues;    // One per NUMA node when placement is on
+    size_t queued = 0;          // Jobs in all queues
+    size_t in_flight = 0;
+    bool stopping = false;
+    size_t next_sender = 0;     // Round-robin start for pickSender
+    std::vector<double> next_free;          // Earliest start of each sender's next send
+    unsigned long long submitted = 0;
+    unsigned long long sent = 0;
+    unsigned long long failed = 0;
+    LatencyHistogram latency;
+    LatencyHistogram wire_latency;
+    std::vector<std::thread> workers;
+
+    static double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
     }
 
     /*
-     * @brief Normalizes phone numbers to a standard format
-     * @param number Phone number to normalize
-     * @return Normalized phone number string
+     * @brief Picks a sender, reserves its next send slot and counts the message
+     * The message is counted against the sender's quotas here, under the lock,
+     * so concurrent workers cannot all pass a cap with one message left; a send
+     * that fails gives the unit back.
+     * @param job Message to send
+     * @param start Set to the time the send may start
+     * @return Index into config.senders, -1 if none is eligible, or -2 for a
+     *         requested sender outside the pool
      */
-    std::string normalizePhoneNumber(const std::string& number) {
-        std::string cleaned = "";
-        // Remove all non-digit characters
-        for (char c : number) {
-            if (isdigit(c)) {
-                cleaned += c;
+    int reserve(const Job& job, double& start) {
+        std::lock_guard<std::mutex> lock(mutex);
+        start = now();
+        int sender = -2;
+        if (job.from.empty()) {
+            sender = quotas.pickSender(job.to, next_sender++ % config.senders.size());
+        } else {
+            for (size_t i = 0; i < config.senders.size(); ++i) {
+                if (config.senders[i].number == job.from) sender = (int)i;
             }
+            // A requested sender is held to the same countries and quotas as a picked one
+            if (sender >= 0 && (!senderServes(config.senders[sender], job.to) ||
+                                quotas.remainingFor(config.senders[sender]) == 0)) sender = -1;
         }
-        
-        // Add international prefix if not present
-        if (!cleaned.empty()) {
-            return "+" + cleaned;
+        if (sender < 0) return sender;
+        try {
+            quotas.record(config.senders[sender]);
+        } catch (const std::exception&) {
+            // The count stays in memory and is saved with the next one
         }
-        return "";
+        start = std::max(start, next_free[sender]);
+        next_free[sender] = start + countSegments(job.body) / config.senders[sender].mps;
+        return sender;
     }
 
-    /*
-     * @brief Validates phone number format
-     * @param number Phone number to validate
-     * @return bool indicating if number is valid
-     */
-    bool validatePhoneNumber(const std::string& number) {
-        std::string normalized = normalizePhoneNumber(number);
-        
-        // Enhanced validation rules
-        if (normalized.empty()) return false;
-        if (normalized.length() < 10 || normalized.length() > 15) return false;
-        if (normalized.substr(1, 1) == "0") return false;  // Invalid country code
-        
-        return true;
+    void complete(const Job& job, sms_result& result, const std::string& error) {
+        if (job.record != NO_RECORD) durable->complete(job.record);
+        result.to = job.to.c_str();
+        result.error = error.c_str();
+        result.user_data = job.user_data;
+        double elapsed = now() - job.submitted;
+        result.latency_ms = elapsed * 1000.0;
+        bool skipped = job.rejection != NumberRejection::NONE || std::strcmp(result.error_class, "opted out") == 0;
+        if (archive) {
+            ArchiveStatus outcome = result.success ? ArchiveStatus::SENT
+                                  : result.ambiguous ? ArchiveStatus::UNCONFIRMED
+                                  : skipped ? ArchiveStatus::SKIPPED : ArchiveStatus::FAILED;
+            archive->add(std::time(nullptr), job.to, outcome, result.error_code, elapsed, result.sid);
+        }
+        if (status) {
+            if (result.success) status->sent(now());
+            else if (skipped) status->skipped(now());
+            else status->failed(now());
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            latency.record(elapsed);
+            if (result.wire_ms >= 0) wire_latency.record(result.wire_ms / 1000.0);
+            if (result.success) sent++;
+            else failed++;
+        }
+        if (job.callback) job.callback(&result, job.context);
     }
 
-    /*
-     * @brief URL encodes a string for HTTP transmission
-     * @param value String to encode
-     * @return URL encoded string
-     */
-    std::string urlEncode(const std::string& value) {
-        std::ostringstream escaped;
-        escaped.fill('0');
-        escaped << std::hex;
+    void process(SMSSender& client, const Job& job) {
+        sms_result result{};
+        result.from = result.sid = "";
+        result.wire_ms = -1;
+        if (job.rejection != NumberRejection::NONE) {
+            result.error_class = "invalid number";
+            complete(job, result, std::string("Invalid number: ") + rejectionName(job.rejection));
+            return;
+        }
+        if (suppression.contains(packPhoneNumber(job.to))) {
+            result.error_class = "opted out";
+            complete(job, result, "Recipient opted out");
+            return;
+        }
 
-        for (char c : value) {
-            if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-                escaped << c;
-            } else {
-                escaped << '%' << std::setw(2) << int((unsigned char)c);
+        double start;
+        int sender = reserve(job, start);
+        if (sender == -2) {
+            // Sending from it would bypass pacing and quotas: the caller must add it to the pool
+            result.error_class = errorClassName(ErrorClass::SENDER);
+            complete(job, result, "Sender " + job.from + " is not in the configured pool");
+            return;
+        }
+        if (sender == -1) {
+            result.error_class = errorClassName(ErrorClass::SENDER);
+            complete(job, result, job.from.empty()
+                ? "No sender may deliver to this number (country not served or quota reached)"
+                : "Sender " + job.from + " may not deliver to this number (country not served or quota reached)");
+            return;
+        }
+        std::string from = config.senders[sender].number;
+        if (job.record != NO_RECORD) durable->dispatched(job.record, from);
+
+        // A job read back after a crash may have been sent just before it: check first
+        if (job.recovered) {
+            std::vector<std::string> candidates;
+            if (!job.sender.empty()) candidates.push_back(job.sender);
+            if (!job.from.empty()) candidates.push_back(job.from);
+            for (const auto& pool : config.senders) candidates.push_back(pool.number);
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+            std::string sid;
+            for (const auto& candidate : candidates) {
+                int found = client.reconcile(candidate, job.to, job.body, job.submitted_wall, sid);
+                if (found == 0) continue;
+                std::string sender_used = candidate;
+                result.from = sender_used.c_str();
+                if (found == 1) {
+                    result.sid = sid.c_str();
+                    result.success = 1;
+                    result.error_class = errorClassName(ErrorClass::NONE);
+                    complete(job, result, "");
+                } else {
+                    result.ambiguous = 1;
+                    result.error_class = errorClassName(ErrorClass::UNCONFIRMED);
+                    complete(job, result, "Could not check whether this message was sent before the restart");
+                }
+                return;
             }
         }
 
-        return escaped.str();
+        double wait = start - now();
+        if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+
+        int attempts = 0;
+        double dispatched = now();
+        SendResult outcome = deliver(client, systemClock(), config, from, job.to, job.body, &attempts);
+        if (attempts == 1) {
+            result.wire_ms = (dispatched - job.submitted + client.lastWireDelay()) * 1000.0;
+            result.reused = client.lastReused();
+        }
+        if (!outcome.success && !outcome.ambiguous) {
+            // Definitely not sent; an unconfirmed send keeps its unit, since caps are hard limits
+            std::lock_guard<std::mutex> lock(mutex);
+            quotas.release(config.senders[sender]);
+        }
+        result.from = from.c_str();
+        result.sid = outcome.sid.c_str();
+        result.error_class = errorClassName(classifyError(outcome));
+        result.success = outcome.success;
+        result.ambiguous = outcome.ambiguous;
+        result.http_status = (int)outcome.http_status;
+        result.error_code = outcome.error_code;
+        result.attempts = attempts;
+        complete(job, result, outcome.success ? std::string() : outcome.message);
     }
 
     /*
-     * @brief Formats phone number for display
-     * @param number Phone number to format
-     * @return Formatted phone number string
+     * @brief Finishes the durable records of a batch that was not accepted
+     * The caller was told the batch failed and may submit it again, so
+     * replay() must not send these records a second time.
      */
-    std::string formatPhoneNumber(const std::string& number) {
-        if (number.length() >= 12) {
-            return number.substr(0, 3) + " " + number.substr(3, 2) + " " + 
-                   number.substr(5, 4) + " " + number.substr(9);
+    void discard(const std::vector<Job>& jobs) {
+        for (const auto& job : jobs) {
+            if (job.record != NO_RECORD) durable->complete(job.record);
         }
-        return number;
     }
 
-public:
-    // Constructor
-    SMSSender(const TwilioConfig& cfg) : config(cfg) {}
-
     /*
-     * Structure to hold SMS sending result
+     * @brief Spreads a batch over the node queues in contiguous slices
      */
-    struct SendResult {
-        bool success;           // Indicates if send was successful
-        std::string message;    // Result message or error description
-        std::string sid;        // Twilio message SID
-    };
+    void enqueue(std::vector<Job>& jobs) {
+        for (size_t node = 0; node < queues.size(); ++node) {
+            size_t first = jobs.size() * node / queues.size();
+            size_t last = jobs.size() * (node + 1) / queues.size();
+            for (size_t i = first; i < last; ++i) queues[node].push_back(std::move(jobs[i]));
+        }
+        queued += jobs.size();
+    }
+
+    void workerLoop(size_t index, size_t count) {
+        // Pinned before the client exists, so its buffers and connection state are node-local
+        size_t home = placement.pin(index, count) % queues.size();
+        SMSSender client(config);
+        client.warm();
+        auto keepalive = std::chrono::seconds(config.keepalive_seconds > 0 ? config.keepalive_seconds : 1 << 30);
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (!work_ready.wait_for(lock, keepalive, [&] { return stopping || queued > 0; })) {
+                    // Idle for a while: refresh the connection before the server drops it
+                    lock.unlock();
+                    client.warm();
+                    continue;
+                }
+                if (queued == 0) return;
+                // Own node first; an idle worker takes from the other nodes rather than wait
+                size_t node = home;
+                while (queues[node].empty()) node = (node + 1) % queues.size();
+                job = std::move(queues[node].front());
+                queues[node].pop_front();
+                queued--;
+            }
+            process(client, job);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--in_flight == 0) {
+                    if (status) status->setStage(StatusBoard::Stage::IDLE);
+                    idle.notify_all();
+                }
+            }
+        }
+    }
+
+public:
+    // Constructor: loads the quota counters and starts the workers
+    SendEngine(const TwilioConfig& cfg)
+        : config(cfg), quotas(config), suppression(config.suppression_file),
+          placement(config.thread_placement),
+          queues(placement.placement() == ThreadPlacement::Mode::NONE ? 1 : placement.nodeCount()),
+          next_free(config.senders.size(), 0.0) {
+        quotas.load();
+        if (!config.queue_file.empty()) durable.reset(new JobQueue(config.queue_file));
+        if (!config.archive_file.empty()) archive.reset(new ResultArchive::Writer(config.archive_file));
+        if (!config.status_file.empty()) {
+            status.reset(new StatusBoard(config.status_file, StatusBoard::Mode::ENGINE));
+            status->setStage(StatusBoard::Stage::IDLE);
+        }
+        for (int i = 0; i < config.engine_workers; ++i) {
+            workers.emplace_back(&SendEngine::workerLoop, this, (size_t)i, (size_t)config.engine_workers);
+        }
+    }
+
+    // Sends everything still queued, then stops the workers
+    ~SendEngine() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        if (status) status->setStage(StatusBoard::Stage::DRAINING);
+        work_ready.notify_all();
+        for (auto& worker : workers) worker.join();
+        if (status) status->setStage(StatusBoard::Stage::FINISHED);
+    }
 
     /*
-     * @brief Loads phone numbers from file
-     * @return Vector of validated phone numbers
-     * @throws std::runtime_error if numbers file is missing
+     * @brief Validates and queues a batch; see sms_submit_batch
+     * @return false if the engine is stopping
      */
-    std::vector<std::string> loadPhoneNumbers() {
-        std::vector<std::string> numbers;
-        std::vector<std::string> invalid_numbers;
-        std::ifstream file("numbers.txt");
-        std::string line;
-
-        if (!file.is_open()) {
-            throw std::runtime_error(
-                Color::RED + "Error: numbers.txt not found!\n" + Color::RESET +
-                "Please create numbers.txt with one phone number per line.\n"
-                "Format: [country_code][number] (Example: 5511999999999)"
-            );
+    bool submit(const sms_message* messages, size_t count, sms_callback callback, void* context) {
+        std::vector<Job> jobs;
+        jobs.reserve(count);
+        double submitted_at = now();
+        double wall = systemClock().now();
+        for (size_t i = 0; i < count; ++i) {
+            std::string input = messages[i].to ? messages[i].to : "";
+            std::string normalized = normalizePhoneNumber(input);
+            NumberRejection rejection = checkPhoneNumber(input, normalized);
+            jobs.push_back({rejection == NumberRejection::NONE ? normalized : input,
+                            messages[i].body ? messages[i].body : "", messages[i].from ? messages[i].from : "",
+                            rejection, messages[i].user_data, callback, context, submitted_at, NO_RECORD, wall,
+                            "", false});
         }
 
-        std::cout << Color::CYAN << "\nReading phone numbers from numbers.txt...\n" << Color::RESET;
-        int line_number = 0;
-        
-        // Process each line in the file
-        while (std::getline(file, line)) {
-            line_number++;
-            line.erase(remove_if(line.begin(), line.end(), isspace), line.end());
-            
-            if (!line.empty()) {
-                std::string normalizedNumber = normalizePhoneNumber(line);
-                if (validatePhoneNumber(normalizedNumber)) {
-                    numbers.push_back(normalizedNumber);
-                    std::cout << Color::GREEN << "✓ " << Color::RESET << 
-                             "Valid number: " << formatPhoneNumber(normalizedNumber) << std::endl;
-                } else {
-                    invalid_numbers.push_back(line);
-                    std::cout << Color::RED << "✗ " << Color::RESET << 
-                             "Invalid number on line " << line_number << ": " << line << std::endl;
+        // Durable before accepted: one group commit covers the whole batch
+        if (durable) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) return false;
+            }
+            uint64_t last = NO_RECORD;
+            try {
+                for (auto& job : jobs) {
+                    if (job.rejection != NumberRejection::NONE) continue;
+                    job.record = last = durable->append(job.to, job.body, job.from, wall);
                 }
+            } catch (const std::exception&) {
+                discard(jobs);
+                throw;
             }
+            if (last != NO_RECORD) durable->commit(last);
         }
 
-        // Report invalid numbers if any
-        if (!invalid_numbers.empty()) {
-            std::cout << Color::YELLOW << "\nWarning: Found " << invalid_numbers.size() 
-                     << " invalid numbers!\n" << Color::RESET;
-            std::cout << "Numbers should include country code (e.g., +5511999999999)\n\n";
+        bool accepted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            accepted = !stopping;
+            if (accepted) {
+                enqueue(jobs);
+                in_flight += count;
+                submitted += count;
+                if (status) {
+                    status->queued(count);
+                    status->setStage(StatusBoard::Stage::SENDING);
+                }
+            }
+        }
+        if (!accepted) {
+            discard(jobs);
+            return false;
         }
+        work_ready.notify_all();
+        return true;
+    }
 
-        return numbers;
+    /*
+     * @brief Queues the jobs that were not finished when the engine last stopped
+     * Each is checked against the API's message list before it is sent, since
+     * it may have gone out just before the crash.
+     * @return Number of jobs queued
+     */
+    size_t replay(sms_callback callback, void* context) {
+        if (!durable) return 0;
+        std::vector<JobQueue::Entry> entries = durable->takeRecovered();
+        if (entries.empty()) return 0;
+        double submitted_at = now();
+        std::vector<Job> jobs;
+        jobs.reserve(entries.size());
+        for (auto& entry : entries) {
+            jobs.push_back({entry.to, entry.body, entry.from, NumberRejection::NONE, nullptr, callback,
+                            context, submitted_at, entry.seq, entry.submitted, entry.sender, true});
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            enqueue(jobs);
+            in_flight += entries.size();
+            submitted += entries.size();
+            if (status) {
+                status->queued(entries.size());
+                status->setStage(StatusBoard::Stage::SENDING);
+            }
+        }
+        work_ready.notify_all();
+        return entries.size();
     }
 
     /*
-     * @brief Sends an SMS message using Twilio API
-     * @param recipient Recipient phone number
-     * @param message Message content
-     * @return SendResult structure containing the result
+     * @brief Waits until every submitted message has completed
      */
-    SendResult sendSMS(const std::string& recipient, const std::string& message) {
-        CURL* curl = curl_easy_init();
-        SendResult result{false, "", ""};
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [&] { return in_flight == 0; });
+    }
 
-        if (curl) {
-            std::string readBuffer;
-            std::string url = "https://api.twilio.com/2010-04-01/Accounts/" + 
-                            config.account_sid + "/Messages.json";
+    void stats(sms_stats& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.submitted = submitted;
+        out.sent = sent;
+        out.failed = failed;
+        out.pending = in_flight;
+        out.latency_p50_ms = latency.percentileMs(50);
+        out.latency_p99_ms = latency.percentileMs(99);
+        out.wire_p50_ms = wire_latency.percentileMs(50);
+        out.wire_p99_ms = wire_latency.percentileMs(99);
+    }
+};
 
-            // Prepare POST data
-            std::string postData = "From=" + urlEncode(config.phone_number) +
-                                 "&To=" + urlEncode(recipient) +
-                                 "&Body=" + urlEncode(message);
+// Library interface (see sms_sender.h)
+struct sms_engine {
+    SendEngine engine;
+};
 
-            // Configure CURL options
-            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
-            curl_easy_setopt(curl, CURLOPT_USERNAME, config.account_sid.c_str());
-            curl_easy_setopt(curl, CURLOPT_PASSWORD, config.auth_token.c_str());
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+extern "C" {
 
-            // Perform the request
-            CURLcode res = curl_easy_perform(curl);
+sms_engine* sms_engine_create(const char* config_path, char* error, size_t error_size) {
+    try {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        TwilioConfig config = readConfig(config_path ? config_path : "twilio_config.txt");
+        return new sms_engine{SendEngine(config)};
+    } catch (const std::exception& e) {
+        if (error && error_size > 0) std::snprintf(error, error_size, "%s", e.what());
+        return nullptr;
+    }
+}
 
-            if (res == CURLE_OK) {
-                try {
-                    json response = json::parse(readBuffer);
-                    if (response.contains("sid")) {
-                        result.success = true;
-                        result.sid = response["sid"].get<std::string>();
-                        result.message = "Message sent successfully";
-                    } else if (response.contains("error_message")) {
-                        result.message = "Twilio Error: " + response["error_message"].get<std::string>();
+int sms_submit_batch(sms_engine* engine, const sms_message* messages, size_t count,
+                     sms_callback callback, void* context) {
+    try {
+        return engine->engine.submit(messages, count, callback, context) ? 0 : -1;
+    } catch (const std::exception&) {
+        return -1;  // The durable queue could not take the batch
+    }
+}
+
+int sms_engine_replay(sms_engine* engine, sms_callback callback, void* context) {
+    return (int)engine->engine.replay(callback, context);
+}
+
+void sms_engine_drain(sms_engine* engine) { engine->engine.drain(); }
+
+void sms_engine_stats(sms_engine* engine, sms_stats* stats) { engine->engine.stats(*stats); }
+
+void sms_engine_destroy(sms_engine* engine) { delete engine; }
+
+const char* sms_validate_number(const char* input, char* normalized, size_t size) {
+    std::string number = normalizePhoneNumber(input ? input : "");
+    NumberRejection rejection = checkPhoneNumber(input ? input : "", number);
+    if (normalized && size > 0) std::snprintf(normalized, size, "%s", number.c_str());
+    return rejection == NumberRejection::NONE ? nullptr : rejectionName(rejection);
+}
+
+}  // extern "C"
+
+/*
+ * @brief Sends messages as records arrive on standard input or a named pipe
+ * Each line is "recipient<TAB>message" ("\n" in the message is a line break).
+ * A record is submitted to the engine as soon as it is read, without waiting
+ * for more input; the records of one read are submitted together. Each goes
+ * out on one of the engine's pre-warmed connections. A
+ * named pipe is reopened when its writer closes it, so the command keeps
+ * serving until interrupted. Ends with a latency summary, including the time
+ * from reading a record until its request was on the wire.
+ * @param args Arguments after "stream"
+ * @return Process exit code
+ */
+int runStreamCommand(const std::vector<std::string>& args) {
+    std::string input = "-";
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--input" && i + 1 < args.size()) {
+            input = args[++i];
+        } else {
+            std::cerr << "Usage: sms_sender stream [--input <file or named pipe>]\n"
+                      << "Records: one per line, recipient<TAB>message\n";
+            return 2;
+        }
+    }
+
+    TwilioConfig config = readConfig();
+    logger().configure(config);
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    // Stop reading on Ctrl-C or SIGTERM, then finish what was submitted
+    static volatile sig_atomic_t interrupted = 0;
+    struct sigaction action{};
+    action.sa_handler = [](int) { interrupted = 1; };
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    /*
+     * Structure to hold the results gathered by the completion callback
+     */
+    struct Results {
+        std::mutex mutex;
+        LatencyHistogram wire;
+        LatencyHistogram total;
+        long sent = 0;
+        long failed = 0;
+        long reused = 0;
+    } results;
+
+    sms_callback report = [](const sms_result* result, void* context) {
+        Results& r = *(Results*)context;
+        std::lock_guard<std::mutex> lock(r.mutex);
+        char wire[32] = "";
+        if (result->wire_ms >= 0) {
+            std::snprintf(wire, sizeof(wire), "%.0f", result->wire_ms * 1000.0);
+            r.wire.record(result->wire_ms / 1000.0);
+            r.reused += result->reused;
+        }
+        r.total.record(result->latency_ms / 1000.0);
+        if (result->success) {
+            r.sent++;
+            std::string timing = result->wire_ms < 0 ? " (after " + std::to_string(result->attempts) + " attempts)"
+                                                     : std::string(" (on the wire after ") + wire + " us" +
+                                                       (result->reused ? ", warm)" : ", cold)");
+            logger().info("sent", {{"to", result->to}, {"sid", result->sid}, {"wire_us", wire},
+                                   {"attempts", std::to_string(result->attempts)}},
+                          Color::GREEN + "✓ " + Color::RESET + result->to + " " + result->sid + timing);
+        } else {
+            r.failed++;
+            logger().warn("failed", {{"to", result->to}, {"class", result->error_class}, {"error", result->error}},
+                          Color::RED + "✗ " + Color::RESET + result->to + ": " + result->error);
+        }
+    };
+
+    SendEngine engine(config);
+    size_t replayed = engine.replay(report, &results);
+    if (replayed > 0) {
+        std::cout << Color::YELLOW << "Resuming " << replayed << " unsent messages from " << config.queue_file
+                  << Color::RESET << std::endl;
+    }
+    std::cout << Color::CYAN << "Streaming from " << (input == "-" ? "standard input" : input) << " with "
+              << config.engine_workers << " warm connections" << Color::RESET << std::endl;
+
+    struct stat info{};
+    bool pipe = input != "-" && stat(input.c_str(), &info) == 0 && S_ISFIFO(info.st_mode);
+    long records = 0;
+    long malformed = 0;
+    std::string buffer;
+    char chunk[65536];
+    while (!interrupted) {
+        int fd = input == "-" ? STDIN_FILENO : open(input.c_str(), O_RDONLY);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Error: cannot open " + input + ": " + std::strerror(errno));
+        }
+        while (!interrupted) {
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            buffer.append(chunk, (size_t)n);
+
+            // Submit every complete record right away, all of one read as one batch: with a queue file
+            // the batch shares one group commit instead of paying a sync per record
+            std::vector<std::pair<std::string, std::string>> batch;
+            size_t start = 0;
+            size_t end;
+            while ((end = buffer.find('\n', start)) != std::string::npos) {
+                std::string line = buffer.substr(start, end - start);
+                start = end + 1;
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.empty()) continue;
+                size_t tab = line.find('\t');
+                if (tab == std::string::npos) {
+                    malformed++;
+                    logger().warn("malformed_record", {{"record", line}},
+                                  Color::YELLOW + "Skipped record without a TAB: " + Color::RESET + line);
+                    continue;
+                }
+                std::string to = line.substr(0, tab);
+                std::string body;
+                for (size_t i = tab + 1; i < line.size(); ++i) {
+                    if (line[i] == '\\' && i + 1 < line.size() && line[i + 1] == 'n') {
+                        body += '\n';
+                        ++i;
                     } else {
-                        result.message = "Unknown response: " + readBuffer;
+                        body += line[i];
                     }
-                } catch (const std::exception& e) {
-                    result.message = "Error parsing response: " + std::string(e.what());
                 }
-            } else {
-                result.message = "Connection failed: " + std::string(curl_easy_strerror(res));
+                batch.emplace_back(std::move(to), std::move(body));
+            }
+            buffer.erase(0, start);
+            if (!batch.empty()) {
+                std::vector<sms_message> messages;
+                messages.reserve(batch.size());
+                for (const auto& record : batch) {
+                    messages.push_back({record.first.c_str(), record.second.c_str(), nullptr, nullptr});
+                }
+                engine.submit(messages.data(), messages.size(), report, &results);
+                records += (long)messages.size();
             }
-
-            curl_easy_cleanup(curl);
         }
+        if (fd != STDIN_FILENO) ::close(fd);
+        if (!pipe) break;
+    }
 
-        return result;
+    engine.drain();
+    logger().flush();
+    std::lock_guard<std::mutex> lock(results.mutex);
+    std::cout << Color::CYAN << "\n=== Stream Report ===" << Color::RESET << "\n";
+    std::cout << "Records: " << records << " (sent " << results.sent << ", failed " << results.failed;
+    if (malformed > 0) std::cout << ", malformed " << malformed;
+    std::cout << ")\n";
+    if (results.total.count() > 0) {
+        std::cout << std::fixed << std::setprecision(2)
+                  << "Read to wire: p50 " << results.wire.percentileMs(50) << " ms, p99 "
+                  << results.wire.percentileMs(99) << " ms, max " << results.wire.maxMs() << " ms\n"
+                  << "Read to reply: p50 " << results.total.percentileMs(50) << " ms, p99 "
+                  << results.total.percentileMs(99) << " ms\n";
+        if (results.wire.count() > 0) {
+            std::cout << "Warm connections: " << std::setprecision(1)
+                      << 100.0 * results.reused / results.wire.count() << "% of first attempts\n";
+        }
     }
+    return results.failed == 0 ? 0 : 1;
+}
+
+/*
+ * Structure to hold command-line options of the interactive sender
+ */
+struct Options {
+    std::string exclude_sent;   // Journal or list of numbers already reached
+    std::string record;         // File to record send timings and outcomes to
+    bool profile = false;       // Collect per-stage hardware counters
 };
 
+/*
+ * @brief Parses the command-line options of the interactive sender
+ * @param args Arguments after the program name
+ * @return Options structure
+ * @throws std::runtime_error on unknown or incomplete options
+ */
+Options parseOptions(const std::vector<std::string>& args) {
+    Options options;
+    for (size_t i = 0; i < args.size(); ++i) {
+        auto value = [&]() -> const std::string& {
+            if (i + 1 >= args.size()) throw std::runtime_error("Missing value for " + args[i]);
+            return args[++i];
+        };
+        if (args[i] == "--exclude-sent") {
+            options.exclude_sent = value();
+        } else if (args[i] == "--record") {
+            options.record = value();
+        } else if (args[i] == "--profile") {
+            options.profile = true;
+        } else {
+            throw std::runtime_error(
+                "Unknown option: " + args[i] + "\n"
+                "Usage: sms_sender [--exclude-sent <journal>] [--record <recording>] [--profile]\n"
+                "       sms_sender list ...\n"
+                "       sms_sender simulate ...\n"
+                "       sms_sender benchmark ...\n"
+                "       sms_sender soak ...\n"
+                "       sms_sender stream ...\n"
+                "       sms_sender query ...\n"
+                "       sms_sender token ...\n"
+                "       sms_sender status ...");
+        }
+    }
+    return options;
+}
+
+#ifndef SMS_SENDER_LIBRARY
 /*
  * Main function
  * Handles the program flow and user interaction
  */
-int main() {
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    // Non-interactive subcommands
+    static const struct {
+        const char* name;
+        int (*run)(const std::vector<std::string>& args);
+    } subcommands[] = {
+        {"list", runListCommand},
+        {"benchmark", runBenchmarkCommand},
+        {"soak", runSoakCommand},
+        {"stream", runStreamCommand},
+        {"query", runQueryCommand},
+        {"token", runTokenCommand},
+        {"status", runStatusCommand},
+        {"simulate", runSimulateCommand},
+    };
+    for (const auto& subcommand : subcommands) {
+        if (args.empty() || args[0] != subcommand.name) continue;
+        try {
+            return subcommand.run(std::vector<std::string>(args.begin() + 1, args.end()));
+        } catch (const std::exception& e) {
+            std::cerr << Color::RED << e.what() << Color::RESET << std::endl;
+            return 1;
+        }
+    }
+
+    Options options;
+    try {
+        options = parseOptions(args);
+    } catch (const std::exception& e) {
+        std::cerr << Color::RED << e.what() << Color::RESET << std::endl;
+        return 2;
+    }
+
     std::string message;
     displayBanner();
 
+    // Per-stage hardware counters for this (the campaign) thread
+    std::unique_ptr<StageProfiler> stage_profiler;
+    if (options.profile) {
+        stage_profiler.reset(new StageProfiler());
+        profiler() = stage_profiler.get();
+    }
+
     try {
         std::cout << Color::CYAN << "Initializing SMS sender..." << Color::RESET << std::endl;
         auto config = readConfig();
+        logger().configure(config);
         std::cout << Color::GREEN << "✓ " << Color::RESET << "Configuration loaded successfully\n";
 
-        // Initialize SMS sender and load phone numbers
+        // Load persistent quota counters
+        QuotaManager quotas(config);
+        quotas.load();
+
+        // Initialize SMS sender and select the fastest API edge
         SMSSender sender(config);
+        EdgeSelector edges(config);
+        if (edges.edges().size() > 1) {
+            std::cout << Color::CYAN << "Probing API edges..." << Color::RESET << std::endl;
+            sender.setApiBase(edges.probe());
+            for (size_t i = 0; i < edges.edges().size(); ++i) {
+                std::cout << (edges.edges()[i] == edges.current() ? Color::GREEN + "✓ " + Color::RESET : "  ")
+                          << edges.edges()[i] << ": ";
+                if (edges.latency(i) < 0) std::cout << "unreachable\n";
+                else std::cout << std::fixed << std::setprecision(0) << edges.latency(i) << " ms\n";
+            }
+        }
+
+        // Load phone numbers
         auto numbers = sender.loadPhoneNumbers();
 
         // Check if any valid numbers were found
@@ -353,6 +8871,91 @@ int main() {
             return 1;
         }
 
+        // Drop recipients who opted out, and listen for new opt-outs during the campaign
+        SuppressionList suppression(config.suppression_file);
+        std::unique_ptr<InboundWebhook> inbound;
+        if (suppression.size() > 0) {
+            size_t before = numbers.size();
+            numbers.erase(std::remove_if(numbers.begin(), numbers.end(), [&](const std::string& n) {
+                return suppression.contains(packPhoneNumber(n));
+            }), numbers.end());
+            if (numbers.size() < before) {
+                std::cout << Color::YELLOW << "Suppression list: " << before - numbers.size()
+                          << " opted-out recipients removed\n" << Color::RESET;
+            }
+        }
+        if (config.inbound_port > 0) {
+            inbound.reset(new InboundWebhook(suppression, config));
+            inbound->start(config.inbound_bind, config.inbound_port);
+            std::cout << Color::GREEN << "✓ " << Color::RESET << "Listening for opt-outs on "
+                      << config.inbound_bind << ":" << inbound->port() << "\n";
+            if (!inbound->verifying()) {
+                std::cout << Color::YELLOW << "Warning: INBOUND_URL is not set, webhook signatures are not verified\n"
+                          << Color::RESET;
+            }
+        }
+
+        // Incremental campaigns: skip everyone a previous run already reached
+        if (!options.exclude_sent.empty()) {
+            PackedList sent(options.exclude_sent);
+            size_t removed = removeListed(numbers, sent);
+            std::cout << Color::YELLOW << "Excluded " << removed << " recipients already in "
+                      << options.exclude_sent << "\n" << Color::RESET;
+            if (numbers.empty()) {
+                std::cout << Color::GREEN << "\nNothing to send: every recipient was already reached.\n" << Color::RESET;
+                std::cout << "\nPress Enter to exit...";
+                std::cin.get();
+                return 0;
+            }
+        }
+
+        // Drop recipients who already reached the frequency cap in earlier campaigns
+        std::unique_ptr<FrequencyStore> frequency;
+        if (config.frequency_cap > 0) {
+            frequency.reset(new FrequencyStore(config));
+            std::vector<uint64_t> packed(numbers.size());
+            std::vector<uint8_t> allowed(numbers.size());
+            for (size_t i = 0; i < numbers.size(); ++i) packed[i] = packPhoneNumber(numbers[i]);
+            size_t kept = frequency->filterBatch(packed.data(), packed.size(), allowed.data());
+            if (kept < numbers.size()) {
+                size_t next = 0;
+                for (size_t i = 0; i < numbers.size(); ++i) {
+                    if (allowed[i]) numbers[next++] = std::move(numbers[i]);
+                }
+                numbers.resize(next);
+                std::cout << Color::YELLOW << "Frequency cap: " << packed.size() - kept
+                          << " recipients skipped (already messaged " << config.frequency_cap
+                          << " times in " << config.frequency_window_days << " days)\n" << Color::RESET;
+            }
+            if (numbers.empty()) {
+                std::cout << Color::RED << "\nError: Every recipient has reached the frequency cap\n" << Color::RESET;
+                std::cout << "\nPress Enter to exit...";
+                std::cin.get();
+                return 1;
+            }
+        }
+
+        // Drop landlines and dead numbers before they cost money and rate capacity
+        if (config.lookup_enabled) {
+            std::cout << Color::CYAN << "\nLooking up line types..." << Color::RESET << std::endl;
+            NumberLookup lookup(config);
+            NumberLookup::Stats stats = lookup.filter(numbers);
+            std::cout << Color::GREEN << "✓ " << Color::RESET << "Lookup: " << stats.cached << " cached, "
+                      << stats.queried << " queried";
+            if (stats.errors > 0) std::cout << ", " << Color::YELLOW << stats.errors << " failed (kept)" << Color::RESET;
+            std::cout << "\n";
+            if (stats.invalid + stats.landline > 0) {
+                std::cout << Color::YELLOW << "Dropped " << stats.invalid << " invalid numbers and "
+                          << stats.landline << " landlines\n" << Color::RESET;
+            }
+            if (numbers.empty()) {
+                std::cout << Color::RED << "\nError: No deliverable phone numbers left after lookup\n" << Color::RESET;
+                std::cout << "\nPress Enter to exit...";
+                std::cin.get();
+                return 1;
+            }
+        }
+
         // Get message from user
         std::cout << Color::CYAN << "\n=== Message Configuration ===" << Color::RESET << "\n";
         std::cout << "Enter the SMS message to send (max 1600 characters):\n"
@@ -369,10 +8972,58 @@ int main() {
         // Show confirmation details
         std::cout << Color::CYAN << "\n=== Confirmation ===" << Color::RESET << "\n";
         std::cout << "Ready to send messages:\n";
-        std::cout << "- From: " << Color::YELLOW << config.phone_number << Color::RESET << "\n";
+        std::cout << "- From: " << Color::YELLOW << config.phone_number << Color::RESET;
+        if (config.senders.size() > 1) {
+            std::cout << " (+" << config.senders.size() - 1 << " more senders)";
+        }
+        std::cout << "\n";
         std::cout << "- Recipients: " << Color::YELLOW << numbers.size() << Color::RESET << "\n";
-        std::cout << "- Message length: " << Color::YELLOW << message.length() << "/1600" << Color::RESET << " characters\n";
-        std::cout << "- Message preview: " << Color::YELLOW << message << Color::RESET << "\n\n";
+
+        // Warn when quotas will push part of the campaign into later days
+        long capacity = quotas.capacityToday();
+        if (capacity >= 0 && capacity < (long)numbers.size()) {
+            std::cout << "- Quota remaining today: " << Color::YELLOW << capacity << Color::RESET
+                      << " (the rest will be sent automatically after the daily reset)\n";
+        }
+        // {{token}} slots are filled with a tracking token per recipient
+        std::unique_ptr<TrackingTokens> tokens;
+        if (TrackingTokens::uses(message)) tokens.reset(new TrackingTokens(message, config));
+        const std::string& rendered = tokens ? tokens->preview() : message;
+
+        std::cout << "- Message length: " << Color::YELLOW << rendered.length() << "/1600" << Color::RESET << " characters\n";
+        std::cout << "- Message preview: " << Color::YELLOW << message << Color::RESET << "\n";
+
+        // Plan the campaign across senders and predict when it will finish
+        int segments = countSegments(rendered);
+        CampaignPlan plan = planCampaign(numbers, config, quotas, segments, expectedSendSeconds(edges));
+        std::time_t completion = windowedCompletion(std::time(nullptr), plan.makespan, config.send_window);
+        std::tm completion_local{};
+        localtime_r(&completion, &completion_local);
+        std::cout << "- Segments per message: " << Color::YELLOW << segments << Color::RESET << "\n";
+        if (config.senders.size() > 1) {
+            for (size_t s = 0; s < config.senders.size(); ++s) {
+                std::cout << "  " << config.senders[s].number << ": " << plan.per_sender[s]
+                          << " recipients\n";
+            }
+        }
+        if (!plan.unservable.empty()) {
+            std::cout << "- No eligible sender: " << Color::RED << plan.unservable.size()
+                      << Color::RESET << " recipients will be skipped\n";
+        }
+        std::cout << "- Predicted completion: " << Color::YELLOW
+                  << std::put_time(&completion_local, "%Y-%m-%d %H:%M") << Color::RESET;
+        if (plan.deferred > 0) {
+            std::cout << " (plus " << plan.deferred << " messages after the daily quota reset)";
+        }
+        std::cout << "\n";
+        // Campaigns send one request at a time: say so when that, not the senders, sets the pace
+        if (plan.makespan > 0 && plan.pacing_makespan > 0 && plan.makespan > 1.2 * plan.pacing_makespan) {
+            size_t planned = plan.entries.size();
+            std::cout << std::fixed << std::setprecision(1) << "- Rate: " << Color::YELLOW
+                      << planned / plan.makespan << " msg/s" << Color::RESET << ", one request at a time (the senders "
+                      << "could take " << planned / plan.pacing_makespan << " msg/s; `stream` sends concurrently)\n";
+        }
+        std::cout << "\n";
         
         // Get user confirmation
         std::cout << "Send messages? (y/n): ";
@@ -390,49 +9041,57 @@ int main() {
 
         // Start sending messages
         std::cout << Color::CYAN << "\n=== Sending Messages ===" << Color::RESET << "\n";
-        int success_count = 0;
-        int fail_count = 0;
-        int total = numbers.size();
-        int current = 0;
 
-        // Process each number in the list
-        for (const auto& number : numbers) {
-            current++;
-            displayProgress(current, total);
-            auto result = sender.sendSMS(number, message);
+        // Successful sends are journaled so later runs can use --exclude-sent
+        std::ofstream journal(config.sent_journal, std::ios::app);
+        if (!journal.is_open()) {
+            throw std::runtime_error("Error: cannot open sent journal " + config.sent_journal);
+        }
 
-            // Clear progress bar line
-            std::cout << "\r" << std::string(80, ' ') << "\r";  
-            std::cout << "[" << current << "/" << total << "] Sending to " << number << "... ";
-            
-            // Display result
-            if (result.success) {
-                std::cout << Color::GREEN << "✓ SUCCESS" << Color::RESET << 
-                         " (SID: " << result.sid << ")" << std::endl;
-                success_count++;
-            } else {
-                std::cout << Color::RED << "✗ FAILED: " << Color::RESET << 
-                         result.message << std::endl;
-                fail_count++;
-            }
-            
-            // Implement rate limiting with visual feedback
-            for (int i = 0; i < 11; ++i) {
-                std::cout << "\rWaiting for rate limit... " << 
-                         std::string(11 - i, '.') << std::flush;
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
-            std::cout << "\r" << std::string(80, ' ') << "\r";
+        // Every outcome goes to the result archive for later audits (sms_sender query)
+        std::unique_ptr<ResultArchive::Writer> archive;
+        if (!config.archive_file.empty()) archive.reset(new ResultArchive::Writer(config.archive_file));
+
+        // Index the tokens before the first send so every click can be attributed
+        if (tokens) {
+            tokens->writeIndex(numbers, config.token_index);
+            std::cout << "Tracking tokens for " << numbers.size() << " recipients indexed in "
+                      << config.token_index << "\n";
         }
 
+        // Optionally record the traffic for later replay in simulation mode
+        std::unique_ptr<RecordingTransport> recorder;
+        if (!options.record.empty()) {
+            recorder.reset(new RecordingTransport(sender, systemClock(), options.record));
+        }
+
+        CampaignRunner runner(config, systemClock(), recorder ? static_cast<Transport&>(*recorder) : sender, quotas);
+        runner.setSuppression(&suppression);
+        runner.setFrequencyStore(frequency.get());
+        runner.setJournal(&journal);
+        runner.setArchive(archive.get());
+        runner.setTokens(tokens.get());
+        runner.setEdges(&edges, &sender);
+
+        // Progress is published for `sms_sender status` in other terminals
+        std::unique_ptr<StatusBoard> status;
+        if (!config.status_file.empty()) status.reset(new StatusBoard(config.status_file, StatusBoard::Mode::CAMPAIGN));
+        runner.setStatus(status.get());
+        CampaignReport report = runner.run(numbers, message, plan, segments);
+
         // Display final report with statistics
-        std::cout << Color::CYAN << "\n=== Final Report ===" << Color::RESET << "\n";
-        std::cout << "Total messages: " << Color::YELLOW << total << Color::RESET << "\n";
-        std::cout << Color::GREEN << "✓ Successful: " << success_count << Color::RESET << "\n";
-        std::cout << Color::RED << "✗ Failed: " << fail_count << Color::RESET << "\n";
+        printReport(report);
+        if (stage_profiler) stage_profiler->print();
+        if (inbound && inbound->optOuts() > 0) {
+            std::cout << Color::YELLOW << "- Opt-outs received: " << inbound->optOuts() << Color::RESET << "\n";
+        }
+        if (inbound && inbound->rejectedCallbacks() > 0) {
+            std::cout << Color::RED << "- Webhook callbacks with invalid signatures: "
+                      << inbound->rejectedCallbacks() << Color::RESET << "\n";
+        }
         
         // Show troubleshooting information if there were failures
-        if (fail_count > 0) {
+        if (report.failed > 0) {
             std::cout << Color::YELLOW << "\nPossible reasons for failures:" << Color::RESET << "\n";
             std::cout << "- Invalid Twilio credentials\n";
             std::cout << "- Phone number not properly configured\n";
@@ -456,4 +9115,6 @@ int main() {
     std::cin.get();
     std::cin.get();
     return 0;
-}
\ No newline at end of file
+}
+
+#endif  // SMS_SENDER_LIBRARY
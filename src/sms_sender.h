@@ -0,0 +1,215 @@
+/*
+ * Title:       SMS Sender Pro - library interface
+ * Version:     1.0.0
+ * Author:      Paulo Muniz
+ * GitHub:      https://github.com/paulomunizdev/sms-sender-pro
+ * Description: In-process interface to the sending engine, for services that
+ *             send through one shared, long-lived engine instead of running the
+ *             sms_sender binary per job. The C functions are the stable ABI; the
+ *             C++ wrapper at the end of this file is header-only on top of them.
+ *
+ * Build the library from the same source as the binary:
+ *   g++ -O2 -fPIC -shared -DSMS_SENDER_LIBRARY main.cpp -o libsmssender.so -lcurl -lzstd -pthread
+ */
+
+#ifndef SMS_SENDER_H
+#define SMS_SENDER_H
+
+#include <stddef.h>     /* For size_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Opaque handle of a sending engine
+ */
+typedef struct sms_engine sms_engine;
+
+/*
+ * Structure to hold one message to submit
+ */
+typedef struct sms_message {
+    const char* to;         /* Recipient number; normalized and validated by the engine */
+    const char* body;       /* Message content */
+    const char* from;       /* Sender from the configured pool, or NULL to pick one */
+    void* user_data;        /* Returned untouched in the message's result */
+} sms_message;
+
+/*
+ * Structure to hold the outcome of one message
+ * The strings are only valid during the callback.
+ */
+typedef struct sms_result {
+    const char* to;         /* Normalized recipient (the input as given if it was invalid) */
+    const char* from;       /* Sender used, "" if none */
+    const char* sid;        /* Message SID, "" unless sent */
+    const char* error;      /* Error description, "" if sent */
+    const char* error_class;    /* "ok", "invalid number", "opted out", "recipient", "throttled", ... */
+    int success;            /* 1 if the API accepted the message */
+    int ambiguous;          /* 1 if the message may have been sent: do not resend it blindly */
+    int http_status;        /* Last HTTP status, 0 if no reply */
+    int error_code;         /* Twilio error code, 0 if none */
+    int attempts;           /* Requests made, including retries */
+    double latency_ms;      /* From submission to completion */
+    void* user_data;        /* The message's user_data */
+    double wire_ms;         /* From submission until the request was on the wire (-1 if retried) */
+    int reused;             /* 1 if the request went out on an already open connection */
+} sms_result;
+
+/*
+ * Structure to hold the counters of an engine since it was created
+ */
+typedef struct sms_stats {
+    unsigned long long submitted;   /* Messages accepted by sms_submit_batch */
+    unsigned long long sent;        /* Messages the API accepted */
+    unsigned long long failed;      /* Messages that completed without being sent */
+    unsigned long long pending;     /* Messages queued or in flight */
+    double latency_p50_ms;          /* Submission-to-completion latency of completed messages */
+    double latency_p99_ms;
+    double wire_p50_ms;             /* Submission-to-wire latency of first attempts */
+    double wire_p99_ms;
+} sms_stats;
+
+/*
+ * Completion callback, called once per message on one of the engine's threads
+ * It must not block for long: it delays the next send of that thread.
+ */
+typedef void (*sms_callback)(const sms_result* result, void* context);
+
+/*
+ * @brief Creates an engine and starts its sending threads
+ * @param config_path Configuration file (same format as twilio_config.txt), or NULL for twilio_config.txt
+ * @param error Buffer for the error message on failure (may be NULL)
+ * @param error_size Size of the error buffer
+ * @return Engine handle, or NULL on failure
+ */
+sms_engine* sms_engine_create(const char* config_path, char* error, size_t error_size);
+
+/*
+ * @brief Queues messages for sending and returns without waiting
+ * Every queued message gets exactly one callback, invalid or opted-out
+ * recipients included.
+ * @param engine Engine handle
+ * @param messages Messages to send; copied before the call returns
+ * @param count Number of messages
+ * @param callback Completion callback (may be NULL)
+ * @param context Passed to every callback of this batch
+ * With QUEUE_FILE set, the batch is on disk when this returns.
+ * @return 0 if the whole batch was queued, -1 if the engine is shutting down or
+ *         the durable queue cannot take it (no callbacks)
+ */
+int sms_submit_batch(sms_engine* engine, const sms_message* messages, size_t count,
+                     sms_callback callback, void* context);
+
+/*
+ * @brief Queues the messages left unfinished when the engine last stopped
+ * Only with QUEUE_FILE set. Each one is first looked up in the API's message
+ * list, in case it went out just before the crash, and is only sent if absent.
+ * @param engine Engine handle
+ * @param callback Completion callback for these messages (user_data is NULL)
+ * @param context Passed to every callback
+ * @return Number of messages queued
+ */
+int sms_engine_replay(sms_engine* engine, sms_callback callback, void* context);
+
+/*
+ * @brief Waits until every submitted message has completed
+ */
+void sms_engine_drain(sms_engine* engine);
+
+/*
+ * @brief Reads the engine's counters
+ */
+void sms_engine_stats(sms_engine* engine, sms_stats* stats);
+
+/*
+ * @brief Completes the queued messages, stops the engine and frees it
+ */
+void sms_engine_destroy(sms_engine* engine);
+
+/*
+ * @brief Normalizes and validates a phone number without sending anything
+ * @param input Number as entered
+ * @param normalized Buffer for the normalized number (may be NULL)
+ * @param size Size of the buffer
+ * @return NULL if the number is valid, otherwise the rejection reason ("too short", ...)
+ */
+const char* sms_validate_number(const char* input, char* normalized, size_t size);
+
+#ifdef __cplusplus
+}
+
+#include <atomic>       // For counting a batch's outstanding callbacks
+#include <functional>   // For completion callbacks
+#include <stdexcept>    // For engine creation errors
+#include <string>       // For string operations
+#include <vector>       // For batches
+
+namespace sms {
+
+using Message = sms_message;
+using Result = sms_result;
+using Stats = sms_stats;
+
+/*
+ * Engine class
+ * Owns an sms_engine. Callbacks may be any callable; each batch keeps its
+ * callback alive until the batch's last message has completed.
+ */
+class Engine {
+private:
+    sms_engine* engine;
+
+    struct Batch {
+        std::function<void(const Result&)> callback;
+        std::atomic<size_t> remaining;
+    };
+
+    static void complete(const sms_result* result, void* context) {
+        Batch* batch = static_cast<Batch*>(context);
+        if (batch->callback) batch->callback(*result);
+        if (--batch->remaining == 0) delete batch;
+    }
+
+public:
+    // Constructor: throws std::runtime_error if the configuration cannot be loaded
+    explicit Engine(const std::string& config_path = "twilio_config.txt") {
+        char error[512] = "";
+        engine = sms_engine_create(config_path.c_str(), error, sizeof(error));
+        if (!engine) throw std::runtime_error(error);
+    }
+
+    ~Engine() { sms_engine_destroy(engine); }
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    /*
+     * @brief Queues messages; see sms_submit_batch
+     * @return false if the engine is shutting down
+     */
+    bool submitBatch(const std::vector<Message>& messages, std::function<void(const Result&)> callback) {
+        if (messages.empty()) return true;
+        Batch* batch = new Batch{std::move(callback), {messages.size()}};
+        if (sms_submit_batch(engine, messages.data(), messages.size(), complete, batch) != 0) {
+            delete batch;
+            return false;
+        }
+        return true;
+    }
+
+    void drain() { sms_engine_drain(engine); }
+
+    Stats stats() {
+        Stats result;
+        sms_engine_stats(engine, &result);
+        return result;
+    }
+};
+
+}  // namespace sms
+
+#endif  /* __cplusplus */
+
+#endif  /* SMS_SENDER_H */